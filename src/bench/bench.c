@@ -0,0 +1,633 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "corpus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "E:\THE_LANGUAGE\src\lexer\lexer.h"
+#include "E:\THE_LANGUAGE\src\parser\flat_ast.h"
+#include "E:\THE_LANGUAGE\src\parser\incremental.h"
+#include "E:\THE_LANGUAGE\src\parser\parser.h"
+#include "E:\THE_LANGUAGE\src\utils\source.h"
+#include "E:\THE_LANGUAGE\src\vm\compiler.h"
+#include "E:\THE_LANGUAGE\src\vm\vm.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Front-end benchmark. For each corpus shape it times three phases over the
+// same generated source, keeping the best of --iterations runs:
+//
+//   tokenize  create_lexer() + tokenize() on the in-memory corpus
+//   parse     parse() over the already materialized token array
+//   eval      what `nuuk <file>` does: source_open() on a file, then the
+//             fused lexer/parser, minus printing the AST
+//
+// Corpora that compile (the program shape) also get four execution phases:
+//
+//   compile      compile_unit() with superinstructions
+//   run          --runs=<n> vm_run()s of that script, interpreted
+//   run_unfused  the same for the script compiled without superinstructions
+//   run_jit      the same runs with the JIT on, so they include compiling the
+//                script to machine code once it is hot (see jit.h)
+//
+// Running a script several times in a row keeps its code in the caches, so
+// the run phases measure dispatch rather than first-touch memory traffic.
+//
+// Every corpus also gets a reparse phase on its first BENCH_REPARSE_LINES
+// lines: --edits=<n> random edits, each followed by the edit that undoes
+// it, go through relex(), apply_token_splice() and reparse(). After every
+// one the tokens and the tree are checked against a fresh tokenize() and
+// parse_editable() of the same text, diagnostics included; any mismatch
+// makes the bench fail. The phase reports the mean time of all reparses,
+// the part of it spent in relex() and apply_token_splice(), and the worst
+// case. Reparses that had to parse every top-level statement again are also
+// counted and timed on their own.
+//
+// Which dispatch the VM uses is fixed at build time, so comparing it takes
+// two builds, e.g. make bench BENCH_CFLAGS+=-DNUUK_SWITCH_DISPATCH.
+//
+// Results go to stdout as one JSON object, progress to stderr.
+
+#define BENCH_CORPUS_PATH "nuuk-bench-corpus.tx"
+#define BENCH_REPARSE_LINES 50000
+
+typedef struct Phase {
+    double seconds;
+    size_t peak_rss_kb;
+} Phase;
+
+typedef struct ReparseStats {
+    size_t lines;
+    size_t edits;
+    size_t full;
+    size_t mismatches;
+    double seconds;
+    double splice_seconds;
+    double full_seconds;
+    double max_seconds;
+} ReparseStats;
+
+typedef struct Measurement {
+    CorpusShape shape;
+    size_t bytes;
+    size_t tokens;
+    size_t nodes;
+    Phase tokenize;
+    Phase parse;
+    Phase eval;
+
+    bool runs;
+    size_t instructions;
+    size_t unfused_instructions;
+    Phase compile;
+    Phase run;
+    Phase run_unfused;
+    Phase run_jit;
+    ReparseStats reparse;
+} Measurement;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Linux lets a process reset its RSS high-water mark, which makes the peak
+// per phase rather than per process. Elsewhere peaks only ever grow.
+static void reset_peak_rss() {
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file) {
+        fputs("5", file);
+        fclose(file);
+    }
+#endif
+}
+
+static size_t peak_rss_kb() {
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file) {
+        char line[256];
+        size_t kb = 0;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "VmHWM: %zu kB", &kb) == 1) break;
+        }
+        fclose(file);
+        if (kb) return kb;
+    }
+#endif
+#ifndef _WIN32
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return (size_t)usage.ru_maxrss / 1024;
+#else
+    return (size_t)usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static size_t count_expr(Expr* expr);
+
+static size_t count_stmt(Stmt* stmt) {
+    if (!stmt) return 0;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION: return 1 + count_expr(((Expression*)stmt)->expr);
+        case STMT_RETURN: return 1 + count_expr(((Return*)stmt)->value);
+        case STMT_IMPORT: return 1 + count_expr(((Import*)stmt)->value);
+        case STMT_EXPAND: return 1 + count_expr(((Expand*)stmt)->value);
+        case STMT_USE: return 1 + count_expr(((Use*)stmt)->value);
+        case STMT_VAR: return 1 + count_expr(((VariableDecl*)stmt)->value);
+        case STMT_BLOCK: {
+            StmtArray* body = ((Block*)stmt)->body;
+            size_t count = 1;
+            for (int i = 0; i < body->size; i++) count += count_stmt(body->elements[i]);
+            return count;
+        }
+    }
+    return 1;
+}
+
+static size_t count_expr(Expr* expr) {
+    if (!expr) return 0;
+
+    switch (expr->type) {
+        case EXPR_BINARY: return 1 + count_expr(((Binary*)expr)->lhs) + count_expr(((Binary*)expr)->rhs);
+        case EXPR_LOGICAL: return 1 + count_expr(((Logical*)expr)->lhs) + count_expr(((Logical*)expr)->rhs);
+        case EXPR_GROUPING: return 1 + count_expr(((Grouping*)expr)->expr);
+        case EXPR_UNARY: return 1 + count_expr(((Unary*)expr)->rhs);
+        case EXPR_ASSIGN: return 1 + count_expr(((Assign*)expr)->value);
+        case EXPR_GET: return 1 + count_expr(((Get*)expr)->expr);
+        case EXPR_CALL: {
+            Call* call = (Call*)expr;
+            size_t count = 1 + count_expr(call->callee);
+            for (int i = 0; i < call->args.size; i++) count += count_expr(call->args.elements[i]);
+            return count;
+        }
+        case EXPR_LITERAL:
+        case EXPR_VARIABLE:
+            return 1;
+    }
+    return 1;
+}
+
+static size_t count_nodes(StmtArray* stmts) {
+    size_t count = 0;
+    for (int i = 0; i < stmts->size; i++) count += count_stmt(stmts->elements[i]);
+    return count;
+}
+
+static void keep_best(Phase* best, double seconds, size_t peak_rss_kb) {
+    if (best->seconds == 0 || seconds < best->seconds) best->seconds = seconds;
+    if (peak_rss_kb > best->peak_rss_kb) best->peak_rss_kb = peak_rss_kb;
+}
+
+// Compiles and runs `unit`, timing both into `compile` and `run`. Returns
+// false if the unit does not compile or fails at run time.
+static bool measure_run(const CompilationUnit* unit, bool superinstructions, bool jit, int runs, Phase* compile, Phase* run, size_t* instructions) {
+    Diagnostics diagnostics = create_diagnostics();
+    reset_peak_rss();
+    double start = now();
+    Function* script = compile_unit(unit, &diagnostics, superinstructions);
+    if (compile) keep_best(compile, now() - start, peak_rss_kb());
+    free_diagnostics(&diagnostics);
+    if (!script) return false;
+    *instructions = script->size * (size_t)runs;
+
+    VM* vm = create_vm();
+    vm->jit = vm->jit && jit;
+    reset_peak_rss();
+    start = now();
+    bool ok = true;
+    for (int i = 0; i < runs && ok; i++) ok = vm_run(vm, script, NULL);
+    keep_best(run, now() - start, peak_rss_kb());
+
+    free_vm(vm);
+    free_function(script);
+    return ok;
+}
+
+// splitmix64, as in corpus.c.
+static uint64_t bench_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static size_t bench_below(uint64_t* state, size_t bound) {
+    return (size_t)(bench_random(state) % bound);
+}
+
+static bool same_tokens(const TokenArray* a, const TokenArray* b) {
+    if (a->size != b->size || a->lines.size != b->lines.size) return false;
+    for (size_t i = 0; i < a->size; i++) {
+        if (token_array_kind(a, i) != token_array_kind(b, i) ||
+            token_array_offset(a, i) != token_array_offset(b, i) ||
+            a->values[token_array_slot(a, i)] != b->values[token_array_slot(b, i)]) return false;
+    }
+    for (size_t i = 0; i < a->lines.size; i++) {
+        if (line_table_start(&a->lines, i) != line_table_start(&b->lines, i)) return false;
+    }
+    return true;
+}
+
+// Statements and their token ranges, recursively through blocks.
+static bool same_ranges(const StmtArray* a, const StmtArray* b) {
+    if (a->size != b->size) return false;
+    for (int i = 0; i < a->size; i++) {
+        const Stmt* x = a->elements[i];
+        const Stmt* y = b->elements[i];
+        if (x->type != y->type || x->range.first != y->range.first || x->range.count != y->range.count) return false;
+        if (x->type == STMT_BLOCK && !same_ranges(((const Block*)x)->body, ((const Block*)y)->body)) return false;
+    }
+    return true;
+}
+
+static int compare_diagnostics(const void* a, const void* b) {
+    const Diagnostic* lhs = (const Diagnostic*)a;
+    const Diagnostic* rhs = (const Diagnostic*)b;
+    if (lhs->offset != rhs->offset) return lhs->offset < rhs->offset ? -1 : 1;
+    return strcmp(lhs->message, rhs->message);
+}
+
+// The same errors at the same offsets, in any order.
+static bool same_diagnostics(const Diagnostics* a, const Diagnostics* b) {
+    if (a->size != b->size) return false;
+    if (a->size == 0) return true;
+
+    Diagnostic* x = (Diagnostic*)malloc(a->size * sizeof(Diagnostic));
+    Diagnostic* y = (Diagnostic*)malloc(b->size * sizeof(Diagnostic));
+    memcpy(x, a->items, a->size * sizeof(Diagnostic));
+    memcpy(y, b->items, b->size * sizeof(Diagnostic));
+    qsort(x, a->size, sizeof(Diagnostic), compare_diagnostics);
+    qsort(y, b->size, sizeof(Diagnostic), compare_diagnostics);
+
+    bool same = true;
+    for (size_t i = 0; i < a->size && same; i++) same = compare_diagnostics(&x[i], &y[i]) == 0;
+    free(x);
+    free(y);
+    return same;
+}
+
+// The node spans are not compared: tokens in kept nodes carry the offsets
+// of the parse that made them (see reparse()).
+static bool same_tree(const CompilationUnit* a, const CompilationUnit* b) {
+    if (!same_diagnostics(&a->diagnostics, &b->diagnostics) || !same_ranges(&a->stmts, &b->stmts)) return false;
+
+    FlatAst x = flatten_ast(a);
+    FlatAst y = flatten_ast(b);
+    bool same = x.size == y.size && x.strings_size == y.strings_size &&
+        memcmp(x.tags, y.tags, x.size * sizeof(uint8_t)) == 0 &&
+        memcmp(x.ops, y.ops, x.size * sizeof(uint8_t)) == 0 &&
+        memcmp(x.data, y.data, x.size * sizeof(uint32_t)) == 0 &&
+        memcmp(x.ends, y.ends, x.size * sizeof(NodeIndex)) == 0 &&
+        (x.strings_size == 0 || memcmp(x.strings, y.strings, x.strings_size) == 0);
+    free_flat_ast(&x);
+    free_flat_ast(&y);
+    return same;
+}
+
+// An edit replaces bytes [start, start + removed) with `inserted`.
+typedef struct Edit {
+    size_t start;
+    size_t removed;
+    char* inserted;
+    size_t inserted_length;
+} Edit;
+
+// One of: a copy of a random line inserted before another, a line deleted,
+// or a few bytes replaced by a few from elsewhere, which often breaks the
+// syntax and sometimes a token.
+static Edit random_edit(uint64_t* state, const char* text, size_t length, const LineTable* lines) {
+    Edit edit;
+    size_t from = 0, count = 0;
+    size_t line = bench_below(state, lines->size);
+    size_t line_end = line + 1 < lines->size ? line_table_start(lines, line + 1) : length;
+
+    switch (bench_below(state, 3)) {
+        case 0: {
+            size_t copied = bench_below(state, lines->size);
+            edit.start = line_table_start(lines, line);
+            edit.removed = 0;
+            from = line_table_start(lines, copied);
+            count = (copied + 1 < lines->size ? line_table_start(lines, copied + 1) : length) - from;
+            break;
+        }
+        case 1:
+            edit.start = line_table_start(lines, line);
+            edit.removed = line_end - edit.start;
+            break;
+        default:
+            edit.start = bench_below(state, length + 1);
+            edit.removed = bench_below(state, 9);
+            if (edit.removed > length - edit.start) edit.removed = length - edit.start;
+            count = bench_below(state, 9);
+            from = bench_below(state, length + 1);
+            if (count > length - from) count = length - from;
+            break;
+    }
+
+    edit.inserted = (char*)malloc(count + 1);
+    memcpy(edit.inserted, text + from, count);
+    edit.inserted_length = count;
+    return edit;
+}
+
+// Applies `edit` to `*text` through relex() and reparse(), and checks the
+// result against lexing and parsing the new text from scratch. Returns the
+// edit that undoes it.
+static Edit reparse_edit(char** text, size_t* length, TokenArray* tokens, CompilationUnit* unit,
+                         const Edit* edit, ReparseStats* stats) {
+    size_t new_length = *length - edit->removed + edit->inserted_length;
+    char* source = (char*)malloc(new_length + 1);
+    memcpy(source, *text, edit->start);
+    memcpy(source + edit->start, edit->inserted, edit->inserted_length);
+    memcpy(source + edit->start + edit->inserted_length, *text + edit->start + edit->removed,
+           *length - edit->start - edit->removed);
+    source[new_length] = '\0';
+
+    Edit undo;
+    undo.start = edit->start;
+    undo.removed = edit->inserted_length;
+    undo.inserted_length = edit->removed;
+    undo.inserted = (char*)malloc(edit->removed + 1);
+    memcpy(undo.inserted, *text + edit->start, edit->removed);
+
+    double start = now();
+    TokenSplice splice = relex(tokens, source, new_length, edit->start, edit->start + edit->removed,
+                               edit->start + edit->inserted_length);
+    apply_token_splice(tokens, &splice, source);
+    double spliced = now();
+    Reparse result = reparse(unit, tokens, &splice);
+    double seconds = now() - start;
+
+    stats->edits++;
+    stats->seconds += seconds;
+    stats->splice_seconds += spliced - start;
+    if (seconds > stats->max_seconds) stats->max_seconds = seconds;
+    if (result.full) {
+        stats->full++;
+        stats->full_seconds += seconds;
+    }
+    free_token_splice(&splice);
+
+    // Edits may break a token, which both lexers turn into an ILLEGAL token.
+    Lexer* lexer = create_lexer(source, new_length);
+    TokenArray* fresh = tokenize(lexer);
+    CompilationUnit expected = parse_editable(fresh);
+    if (!same_tokens(tokens, fresh) || !same_tree(unit, &expected)) {
+        fprintf(stderr, "bench: reparse mismatch after replacing %zu bytes at %zu with %zu bytes\n",
+                edit->removed, edit->start, edit->inserted_length);
+        stats->mismatches++;
+    }
+    free_compilation_unit(&expected);
+    free_lexer(lexer);
+
+    // Tokens in kept nodes still point into the old text, but nothing here
+    // reads their spelling again.
+    free(*text);
+    *text = source;
+    *length = new_length;
+    return undo;
+}
+
+// The length of the top-level statements that end within the first
+// BENCH_REPARSE_LINES lines, so that the edited text starts out without
+// syntax errors.
+static size_t reparse_prefix(const char* corpus, size_t bytes) {
+    Lexer* lexer = create_lexer(corpus, bytes);
+    TokenArray* tokens = tokenize(lexer);
+    Parser* parser = create_parser(tokens);
+    CompilationUnit unit = parse(parser);
+
+    size_t limit = tokens->lines.size > BENCH_REPARSE_LINES ? line_table_start(&tokens->lines, BENCH_REPARSE_LINES) : bytes;
+    size_t length = 0;
+    for (int i = 0; i < unit.stmts.size; i++) {
+        const Stmt* stmt = unit.stmts.elements[i];
+        size_t end = token_array_offset(tokens, stmt->range.first + stmt->range.count);
+        if (end > limit) break;
+        length = end;
+    }
+
+    free_compilation_unit(&unit);
+    free_parser(parser);
+    free_lexer(lexer);
+    return length;
+}
+
+static ReparseStats measure_reparse(const char* corpus, size_t bytes, uint64_t seed, int edits) {
+    ReparseStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    size_t length = reparse_prefix(corpus, bytes);
+    for (size_t i = 0; i < length; i++) {
+        if (corpus[i] == '\n') stats.lines++;
+    }
+    char* text = (char*)malloc(length + 1);
+    memcpy(text, corpus, length);
+    text[length] = '\0';
+
+    Lexer* lexer = create_lexer(text, length);
+    TokenArray* tokens = tokenize(lexer);
+    CompilationUnit unit = parse_editable(tokens);
+
+    uint64_t state = seed;
+    for (int i = 0; i < edits; i++) {
+        Edit edit = random_edit(&state, text, length, &tokens->lines);
+        Edit undo = reparse_edit(&text, &length, tokens, &unit, &edit, &stats);
+        free(edit.inserted);
+        Edit redo = reparse_edit(&text, &length, tokens, &unit, &undo, &stats);
+        free(undo.inserted);
+        free(redo.inserted);
+    }
+    if (stats.edits > 0) {
+        stats.seconds /= (double)stats.edits;
+        stats.splice_seconds /= (double)stats.edits;
+    }
+    if (stats.full > 0) stats.full_seconds /= (double)stats.full;
+
+    free_compilation_unit(&unit);
+    free_lexer(lexer);
+    free(text);
+    return stats;
+}
+
+static Measurement measure(const CorpusOptions* options, int iterations, int runs, int edits) {
+    Measurement m;
+    memset(&m, 0, sizeof(m));
+    m.shape = options->shape;
+
+    char* corpus = generate_corpus(options, &m.bytes);
+
+    FILE* file = fopen(BENCH_CORPUS_PATH, "wb");
+    if (!file || fwrite(corpus, 1, m.bytes, file) != m.bytes) {
+        fprintf(stderr, "ERROR: Failed to write %s.\n", BENCH_CORPUS_PATH);
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+
+    for (int i = 0; i < iterations; i++) {
+        reset_peak_rss();
+        double start = now();
+        Lexer* lexer = create_lexer(corpus, m.bytes);
+        TokenArray* tokens = tokenize(lexer);
+        keep_best(&m.tokenize, now() - start, peak_rss_kb());
+        m.tokens = tokens->size;
+
+        reset_peak_rss();
+        start = now();
+        Parser* parser = create_parser(tokens);
+        CompilationUnit unit = parse(parser);
+        keep_best(&m.parse, now() - start, peak_rss_kb());
+        m.nodes = count_nodes(&unit.stmts);
+
+        m.runs = unit.diagnostics.size == 0 &&
+            measure_run(&unit, true, false, runs, &m.compile, &m.run, &m.instructions) &&
+            measure_run(&unit, false, false, runs, NULL, &m.run_unfused, &m.unfused_instructions) &&
+            measure_run(&unit, true, true, runs, NULL, &m.run_jit, &m.instructions);
+
+        free_compilation_unit(&unit);
+        free_parser(parser);
+        free_lexer(lexer);
+
+        reset_peak_rss();
+        start = now();
+        Source* source = source_open(BENCH_CORPUS_PATH);
+        if (!source) {
+            fprintf(stderr, "ERROR: Failed to open %s.\n", BENCH_CORPUS_PATH);
+            exit(EXIT_FAILURE);
+        }
+        lexer = create_lexer(source->data, source->length);
+        parser = create_streaming_parser(lexer);
+        unit = parse(parser);
+        free_compilation_unit(&unit);
+        free_parser(parser);
+        free_lexer(lexer);
+        source_close(source);
+        keep_best(&m.eval, now() - start, peak_rss_kb());
+    }
+
+    remove(BENCH_CORPUS_PATH);
+    m.reparse = measure_reparse(corpus, m.bytes, options->seed, edits);
+    free(corpus);
+    return m;
+}
+
+static void print_phase(const char* name, const Phase* phase, const Measurement* m, bool nodes, bool last) {
+    printf("      \"%s\": {\"seconds\": %.6f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f", name, phase->seconds,
+           m->bytes / 1e6 / phase->seconds, m->tokens / phase->seconds);
+    if (nodes) printf(", \"nodes_per_s\": %.0f", m->nodes / phase->seconds);
+    printf(", \"peak_rss_kb\": %zu}%s\n", phase->peak_rss_kb, last ? "" : ",");
+}
+
+// The corpora are straight-line code, so every instruction of a script runs
+// exactly once per run.
+static void print_run_phase(const char* name, const Phase* phase, size_t instructions, bool last) {
+    printf("      \"%s\": {\"seconds\": %.6f, \"instructions\": %zu, \"instructions_per_s\": %.0f, \"peak_rss_kb\": %zu}%s\n",
+           name, phase->seconds, instructions, instructions / phase->seconds, phase->peak_rss_kb, last ? "" : ",");
+}
+
+static void print_reparse_phase(const ReparseStats* stats) {
+    printf("      \"reparse\": {\"lines\": %zu, \"edits\": %zu, \"full\": %zu, \"mismatches\": %zu, "
+           "\"seconds\": %.6f, \"splice_seconds\": %.6f, \"full_seconds\": %.6f, \"max_seconds\": %.6f}\n",
+           stats->lines, stats->edits, stats->full, stats->mismatches, stats->seconds, stats->splice_seconds,
+           stats->full_seconds, stats->max_seconds);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "Usage: nuuk-bench [--size=<MB>] [--shape=<all|mixed|deep|declarations|imports|strings|program>]\n"
+            "                  [--seed=<n>] [--iterations=<n>] [--depth=<n>] [--string-length=<n>]\n"
+            "                  [--runs=<n>] [--edits=<n>] [--emit=<path>]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    CorpusOptions options;
+    options.shape = CORPUS_MIXED;
+    options.size = 8 * 1024 * 1024;
+    options.seed = 1;
+    options.depth = 24;
+    options.string_length = 4096;
+
+    bool all = true;
+    int iterations = 3;
+    int runs = 20;
+    int edits = 50;
+    const char* emit = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--size=", 7) == 0) options.size = (size_t)(atof(arg + 7) * 1024 * 1024);
+        else if (strncmp(arg, "--seed=", 7) == 0) options.seed = strtoull(arg + 7, NULL, 10);
+        else if (strncmp(arg, "--iterations=", 13) == 0) iterations = atoi(arg + 13);
+        else if (strncmp(arg, "--runs=", 7) == 0) runs = atoi(arg + 7);
+        else if (strncmp(arg, "--edits=", 8) == 0) edits = atoi(arg + 8);
+        else if (strncmp(arg, "--depth=", 8) == 0) options.depth = atoi(arg + 8);
+        else if (strncmp(arg, "--string-length=", 16) == 0) options.string_length = (size_t)atol(arg + 16);
+        else if (strncmp(arg, "--emit=", 7) == 0) emit = arg + 7;
+        else if (strncmp(arg, "--shape=", 8) == 0) {
+            all = strcmp(arg + 8, "all") == 0;
+            if (!all && !corpus_shape_from_name(arg + 8, &options.shape)) usage();
+        }
+        else usage();
+    }
+    if (iterations < 1 || runs < 1 || edits < 0 || options.depth < 1) usage();
+
+    // --emit writes a single corpus for use with `nuuk` and stops.
+    if (emit) {
+        size_t length;
+        char* corpus = generate_corpus(&options, &length);
+        FILE* file = fopen(emit, "wb");
+        if (!file || fwrite(corpus, 1, length, file) != length) {
+            fprintf(stderr, "ERROR: Failed to write %s.\n", emit);
+            return 1;
+        }
+        fclose(file);
+        free(corpus);
+        return 0;
+    }
+
+    int first = all ? 0 : options.shape;
+    int last = all ? CORPUS_SHAPE_COUNT - 1 : options.shape;
+    size_t mismatches = 0;
+
+    printf("{\n  \"scanner\": \"%s\",\n  \"dispatch\": \"%s\",\n  \"jit\": %s,\n  \"seed\": %llu,\n  \"iterations\": %d,\n  \"corpora\": [\n",
+           scan_ops()->name, vm_dispatch_name(), jit_available() ? "true" : "false", (unsigned long long)options.seed, iterations);
+    for (int shape = first; shape <= last; shape++) {
+        options.shape = (CorpusShape)shape;
+        fprintf(stderr, "bench: %s...\n", corpus_shape_name(options.shape));
+        Measurement m = measure(&options, iterations, runs, edits);
+        mismatches += m.reparse.mismatches;
+
+        printf("    {\n      \"shape\": \"%s\", \"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu,\n",
+               corpus_shape_name(m.shape), m.bytes, m.tokens, m.nodes);
+        print_phase("tokenize", &m.tokenize, &m, false, false);
+        print_phase("parse", &m.parse, &m, true, false);
+        print_phase("eval", &m.eval, &m, true, false);
+        if (m.runs) {
+            print_phase("compile", &m.compile, &m, true, false);
+            print_run_phase("run", &m.run, m.instructions, false);
+            print_run_phase("run_unfused", &m.run_unfused, m.unfused_instructions, false);
+            print_run_phase("run_jit", &m.run_jit, m.instructions, false);
+        }
+        print_reparse_phase(&m.reparse);
+        printf("    }%s\n", shape == last ? "" : ",");
+        fflush(stdout);
+    }
+    printf("  ]\n}\n");
+
+    return mismatches ? 1 : 0;
+}
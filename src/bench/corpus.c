@@ -0,0 +1,300 @@
+#include "corpus.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct Corpus {
+    char* data;
+    size_t length;
+    size_t capacity;
+    uint64_t state;
+    const CorpusOptions* options;
+} Corpus;
+
+static const char* const shape_names[CORPUS_SHAPE_COUNT] = {
+    [CORPUS_MIXED] = "mixed",
+    [CORPUS_DEEP_EXPRESSIONS] = "deep",
+    [CORPUS_DECLARATIONS] = "declarations",
+    [CORPUS_IMPORTS] = "imports",
+    [CORPUS_STRINGS] = "strings",
+    [CORPUS_PROGRAM] = "program",
+};
+
+static const char* const types[] = { "int", "float", "double", "bool", "char", "usize", "isize", "uint" };
+static const char* const modules[] = { "std", "io", "math", "net", "fs", "collections", "strings", "time", "os", "sync" };
+static const char* const binary_ops[] = { " + ", " - ", " * ", " / ", " < ", " >= ", " == ", " != ", " and ", " or " };
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// splitmix64: tiny, fast and identical on every platform.
+static uint64_t corpus_random(Corpus* self) {
+    uint64_t z = (self->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static size_t corpus_below(Corpus* self, size_t bound) {
+    return (size_t)(corpus_random(self) % bound);
+}
+
+static void corpus_append(Corpus* self, const char* text, size_t length) {
+    if (self->length + length + 1 > self->capacity) {
+        while (self->length + length + 1 > self->capacity) self->capacity *= 2;
+        self->data = (char*)realloc(self->data, self->capacity);
+        if (!self->data) {
+            fprintf(stderr, "FATAL ERROR: Failed to grow corpus.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(self->data + self->length, text, length);
+    self->length += length;
+}
+
+static void corpus_puts(Corpus* self, const char* text) {
+    corpus_append(self, text, strlen(text));
+}
+
+static void corpus_printf(Corpus* self, const char* format, size_t value) {
+    char buffer[64];
+    int length = snprintf(buffer, sizeof(buffer), format, value);
+    corpus_append(self, buffer, (size_t)length);
+}
+
+// Identifiers come from a bounded pool so they repeat the way names in real
+// code do.
+static void corpus_identifier(Corpus* self) {
+    static const char* const stems[] = { "value", "count", "index", "node", "buffer", "left", "right", "result", "x", "i" };
+    corpus_puts(self, stems[corpus_below(self, COUNT(stems))]);
+    corpus_printf(self, "%zu", corpus_below(self, 64));
+}
+
+static void corpus_operand(Corpus* self) {
+    switch (corpus_below(self, 5)) {
+        case 0: corpus_printf(self, "%zu", corpus_below(self, 100000)); break;
+        case 1: corpus_printf(self, "%zu.5", corpus_below(self, 1000)); break;
+        case 2: corpus_identifier(self); corpus_puts(self, "("); corpus_identifier(self); corpus_puts(self, ")"); break;
+        case 3: corpus_identifier(self); corpus_puts(self, "."); corpus_identifier(self); break;
+        default: corpus_identifier(self);
+    }
+}
+
+static void corpus_expression(Corpus* self, int depth) {
+    if (depth <= 0) {
+        corpus_operand(self);
+        return;
+    }
+
+    if (corpus_below(self, 4) == 0) corpus_puts(self, "-");
+    corpus_puts(self, "(");
+    corpus_expression(self, depth - 1);
+    corpus_puts(self, binary_ops[corpus_below(self, COUNT(binary_ops))]);
+    corpus_operand(self);
+    corpus_puts(self, ")");
+}
+
+static void corpus_deep_expression(Corpus* self) {
+    corpus_puts(self, "int ");
+    corpus_identifier(self);
+    corpus_puts(self, " = ");
+    corpus_expression(self, 1 + (int)corpus_below(self, (size_t)self->options->depth));
+    corpus_puts(self, ";\n");
+}
+
+static void corpus_declarations(Corpus* self) {
+    size_t count = 8 + corpus_below(self, 24);
+    for (size_t i = 0; i < count; i++) {
+        if (corpus_below(self, 3) == 0) corpus_puts(self, "const ");
+        corpus_puts(self, types[corpus_below(self, COUNT(types))]);
+        if (corpus_below(self, 6) == 0) corpus_puts(self, "*");
+        corpus_puts(self, " ");
+        corpus_identifier(self);
+
+        if (corpus_below(self, 5) == 0) {
+            corpus_puts(self, ";\n");
+            continue;
+        }
+        corpus_puts(self, " = ");
+        corpus_expression(self, (int)corpus_below(self, 3));
+        corpus_puts(self, ";\n");
+    }
+}
+
+static void corpus_imports(Corpus* self) {
+    static const char* const keywords[] = { "import ", "use ", "expand " };
+    size_t count = 4 + corpus_below(self, 12);
+    for (size_t i = 0; i < count; i++) {
+        corpus_puts(self, keywords[corpus_below(self, COUNT(keywords))]);
+        corpus_puts(self, modules[corpus_below(self, COUNT(modules))]);
+
+        size_t path = 1 + corpus_below(self, 4);
+        for (size_t j = 0; j < path; j++) {
+            corpus_puts(self, ".");
+            corpus_puts(self, modules[corpus_below(self, COUNT(modules))]);
+        }
+        corpus_puts(self, ";\n");
+    }
+}
+
+static void corpus_string(Corpus* self) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.,:;!?-_";
+    size_t length = self->options->string_length / 2 + corpus_below(self, self->options->string_length / 2 + 1);
+
+    corpus_identifier(self);
+    corpus_puts(self, "(\"");
+    for (size_t i = 0; i < length; i++) {
+        char c = alphabet[corpus_below(self, sizeof(alphabet) - 1)];
+        corpus_append(self, &c, 1);
+    }
+    corpus_puts(self, "\");\n");
+}
+
+static void corpus_block(Corpus* self) {
+    corpus_puts(self, "{\n");
+    size_t count = 1 + corpus_below(self, 6);
+    for (size_t i = 0; i < count; i++) {
+        corpus_puts(self, "    ");
+        corpus_identifier(self);
+        corpus_puts(self, corpus_below(self, 2) ? " += " : " = ");
+        corpus_expression(self, (int)corpus_below(self, 4));
+        corpus_puts(self, ";\n");
+    }
+    corpus_puts(self, "    return ");
+    corpus_identifier(self);
+    corpus_puts(self, ";\n}\n");
+}
+
+// Locals of a program block: ints v0.. and floats f0.. that are declared
+// before any statement uses them.
+static void corpus_program_int(Corpus* self, size_t ints) {
+    corpus_printf(self, "v%zu", corpus_below(self, ints));
+}
+
+static void corpus_program_float(Corpus* self, size_t floats) {
+    corpus_printf(self, "f%zu", corpus_below(self, floats));
+}
+
+// A block of straight-line code over declared variables that runs without
+// errors: ints stay below 1000003 in magnitude and floats are damped, so
+// nothing overflows, and no divisor can be zero.
+static void corpus_program(Corpus* self) {
+    size_t ints = 2 + corpus_below(self, 4);
+    size_t floats = 1 + corpus_below(self, 3);
+
+    corpus_puts(self, "{\n");
+    for (size_t i = 0; i < ints; i++) {
+        corpus_printf(self, "    int v%zu = ", i);
+        corpus_printf(self, "%zu;\n", corpus_below(self, 1000));
+    }
+    for (size_t i = 0; i < floats; i++) {
+        corpus_printf(self, "    float f%zu = ", i);
+        corpus_printf(self, "%zu.5;\n", corpus_below(self, 100));
+    }
+
+    size_t count = 4 + corpus_below(self, 12);
+    for (size_t i = 0; i < count; i++) {
+        corpus_puts(self, "    ");
+        switch (corpus_below(self, 6)) {
+            case 0:
+                corpus_program_int(self, ints);
+                corpus_puts(self, " = (");
+                corpus_program_int(self, ints);
+                corpus_printf(self, " * %zu + ", 2 + corpus_below(self, 40));
+                corpus_program_int(self, ints);
+                corpus_puts(self, ") % 1000003;\n");
+                break;
+            case 1:
+                corpus_program_int(self, ints);
+                corpus_puts(self, " -= abs(");
+                corpus_program_int(self, ints);
+                corpus_printf(self, ") %% %zu;\n", 1 + corpus_below(self, 1000));
+                break;
+            case 2:
+                corpus_program_float(self, floats);
+                corpus_puts(self, " = ");
+                corpus_program_float(self, floats);
+                corpus_puts(self, " * 0.5 + ");
+                corpus_program_int(self, ints);
+                corpus_puts(self, ";\n");
+                break;
+            case 3:
+                corpus_puts(self, "flag = ");
+                corpus_program_int(self, ints);
+                corpus_puts(self, " < ");
+                corpus_program_int(self, ints);
+                corpus_puts(self, " and ");
+                corpus_program_float(self, floats);
+                corpus_printf(self, " > %zu.5;\n", corpus_below(self, 100));
+                break;
+            case 4:
+                corpus_program_int(self, ints);
+                corpus_puts(self, " = max(");
+                corpus_program_int(self, ints);
+                corpus_puts(self, ", ");
+                corpus_program_int(self, ints);
+                corpus_printf(self, ") - %zu;\n", corpus_below(self, 1000));
+                break;
+            default:
+                corpus_puts(self, "total = (total + ");
+                corpus_program_int(self, ints);
+                corpus_puts(self, ") % 1000003;\n");
+                break;
+        }
+    }
+    corpus_puts(self, "}\n");
+}
+
+static void corpus_section(Corpus* self, CorpusShape shape) {
+    switch (shape) {
+        case CORPUS_DEEP_EXPRESSIONS: corpus_deep_expression(self); break;
+        case CORPUS_DECLARATIONS: corpus_declarations(self); break;
+        case CORPUS_IMPORTS: corpus_imports(self); break;
+        case CORPUS_STRINGS: corpus_string(self); break;
+        case CORPUS_PROGRAM: corpus_program(self); break;
+        default:
+            switch (corpus_below(self, 5)) {
+                case 0: corpus_deep_expression(self); break;
+                case 1: corpus_declarations(self); break;
+                case 2: corpus_imports(self); break;
+                case 3: corpus_string(self); break;
+                default: corpus_block(self);
+            }
+    }
+}
+
+char* generate_corpus(const CorpusOptions* options, size_t* length) {
+    Corpus corpus;
+    corpus.capacity = options->size + 4096;
+    corpus.data = (char*)malloc(corpus.capacity);
+    corpus.length = 0;
+    corpus.state = options->seed;
+    corpus.options = options;
+    if (!corpus.data) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate corpus.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The globals every program block uses.
+    if (options->shape == CORPUS_PROGRAM) corpus_puts(&corpus, "int total = 0;\nbool flag = false;\n");
+
+    while (corpus.length < options->size) corpus_section(&corpus, options->shape);
+
+    corpus.data[corpus.length] = '\0';
+    *length = corpus.length;
+    return corpus.data;
+}
+
+const char* corpus_shape_name(CorpusShape shape) {
+    return shape_names[shape];
+}
+
+bool corpus_shape_from_name(const char* name, CorpusShape* shape) {
+    for (int i = 0; i < CORPUS_SHAPE_COUNT; i++) {
+        if (strcmp(name, shape_names[i]) == 0) {
+            *shape = (CorpusShape)i;
+            return true;
+        }
+    }
+    return false;
+}
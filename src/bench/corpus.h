@@ -0,0 +1,36 @@
+#ifndef NUUK_CORPUS_H
+#define NUUK_CORPUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Shapes of synthetic Nuuk source. Every shape is valid input for the
+// current parser; CORPUS_PROGRAM also compiles and runs without errors.
+typedef enum CorpusShape {
+    CORPUS_MIXED,
+    CORPUS_DEEP_EXPRESSIONS,
+    CORPUS_DECLARATIONS,
+    CORPUS_IMPORTS,
+    CORPUS_STRINGS,
+    CORPUS_PROGRAM,
+    CORPUS_SHAPE_COUNT
+} CorpusShape;
+
+typedef struct CorpusOptions {
+    CorpusShape shape;
+    size_t size;            // Target size in bytes; output stops at the first line past it.
+    uint64_t seed;
+    int depth;              // Parenthesis nesting of CORPUS_DEEP_EXPRESSIONS.
+    size_t string_length;   // Literal length of CORPUS_STRINGS.
+} CorpusOptions;
+
+// The same options always produce the same bytes. The result is
+// NUL-terminated, its length is stored in *length and it is owned by the
+// caller.
+char* generate_corpus(const CorpusOptions* options, size_t* length);
+
+const char* corpus_shape_name(CorpusShape shape);
+bool corpus_shape_from_name(const char* name, CorpusShape* shape);
+
+#endif
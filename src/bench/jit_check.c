@@ -0,0 +1,507 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "E:\THE_LANGUAGE\src\lexer\lexer.h"
+#include "E:\THE_LANGUAGE\src\parser\fold.h"
+#include "E:\THE_LANGUAGE\src\parser\parser.h"
+#include "E:\THE_LANGUAGE\src\vm\compiler.h"
+#include "E:\THE_LANGUAGE\src\vm\vm.h"
+
+// Differential check of the JIT against the interpreter. Each random
+// program is compiled twice: one copy runs once with the JIT off, the other
+// --runs times with it on, so that it gets hot (JIT_HOT_RUNS), runs as
+// machine code and, when it keeps deoptimizing, goes back to the
+// interpreter (JIT_MAX_DEOPTS). After every run the outcome, the returned
+// value, every global slot (bit for bit) and the runtime error, if any,
+// must match the interpreter's.
+//
+// The programs have int, float and bool globals and block locals, all the
+// arithmetic operators, division and modulo by constants, comparisons,
+// 'and'/'or', the numeric natives and ints near the 48-bit limits, so both
+// the guarded paths and the deoptimizations on overflow, division by zero
+// and the occasional bool or char among numbers get exercised. Programs
+// whose constants do not fold (e.g. a literal division by zero) fail to
+// compile and are only counted.
+
+#define CHECK_MAX_NAMES 512
+#define CHECK_MAX_DEPTH 3
+
+typedef enum Kind {
+    KIND_INT,
+    KIND_FLOAT,
+    KIND_BOOL,
+} Kind;
+
+// A variable of a generated program. Ints only ever get int expressions, so
+// the kind stays true at run time until an error stops the program.
+typedef struct Name {
+    char spelling[8];
+    Kind kind;
+} Name;
+
+typedef struct Program {
+    char* data;
+    size_t length;
+    size_t capacity;
+    uint64_t state;
+    Name names[CHECK_MAX_NAMES];
+    size_t name_count;
+    size_t global_count;
+    size_t local_count;
+} Program;
+
+static const char* const small_ints[] = { "1", "2", "3", "7", "10", "255", "65535", "65536", "99991", "1000003" };
+static const char* const large_ints[] = { "70368744177664", "140737488355327", "4294967296" };
+static const char* const floats[] = { "0.5", "1.5", "2.5", "0.1", "1000000.0" };
+static const char* const arithmetic_ops[] = { " + ", " - ", " + ", " - ", " * ", " / ", " % " };
+static const char* const compare_ops[] = { " < ", " <= ", " > ", " >= ", " == ", " != " };
+static const char* const assign_ops[] = { " = ", " += ", " -= ", " *= ", " /= ", " = ", " += ", " = ", " -= " };
+static const char* const divisors[] = { "1", "2", "3", "7", "10", "16", "1000" };
+
+#define COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// splitmix64, as in corpus.c.
+static uint64_t check_random(Program* self) {
+    uint64_t z = (self->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static size_t check_below(Program* self, size_t bound) {
+    return (size_t)(check_random(self) % bound);
+}
+
+#define PICK(self, array) ((array)[check_below(self, COUNT(array))])
+
+static void program_puts(Program* self, const char* text) {
+    size_t length = strlen(text);
+    if (self->length + length + 1 > self->capacity) {
+        while (self->length + length + 1 > self->capacity) self->capacity *= 2;
+        self->data = (char*)realloc(self->data, self->capacity);
+        if (!self->data) {
+            fprintf(stderr, "FATAL ERROR: Failed to grow program.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    memcpy(self->data + self->length, text, length + 1);
+    self->length += length;
+}
+
+// A random variable in scope of `kind`, or NULL if there is none. Unless
+// `exact`, an int also does where a float is expected.
+static const Name* find_variable(Program* self, Kind kind, bool exact) {
+    if (self->name_count == 0) return NULL;
+    size_t start = check_below(self, self->name_count);
+    for (size_t i = 0; i < self->name_count; i++) {
+        const Name* name = &self->names[(start + i) % self->name_count];
+        if (name->kind == kind || (!exact && kind == KIND_FLOAT && name->kind == KIND_INT)) return name;
+    }
+    return NULL;
+}
+
+// About one leaf in four hundred is a zero, a bool or a char, and one in
+// fifty one of the large ints. Those are what make the machine code
+// deoptimize on division by zero, wrong operand types and overflow.
+static void program_leaf(Program* self, Kind kind) {
+    const Name* name = check_below(self, 3) < 2 ? find_variable(self, kind, false) : NULL;
+    if (name) {
+        program_puts(self, name->spelling);
+        return;
+    }
+
+    size_t pick = check_below(self, 400);
+    if (kind == KIND_BOOL) program_puts(self, pick < 200 ? "true" : "false");
+    else if (pick == 0) program_puts(self, "0");
+    else if (pick == 1) program_puts(self, check_below(self, 2) ? "true" : "'a'");
+    else if (pick < 10) program_puts(self, PICK(self, large_ints));
+    else if (kind == KIND_FLOAT && pick < 240) program_puts(self, PICK(self, floats));
+    else program_puts(self, PICK(self, small_ints));
+}
+
+static void program_number(Program* self, Kind kind, int depth);
+
+// The right operand of '/', '%' or '/='. Int division makes zeros often
+// enough that most divisors are kept away from zero.
+static void program_divisor(Program* self, Kind kind, int depth) {
+    if (check_below(self, 50) == 0) {
+        program_number(self, kind, depth);
+        return;
+    }
+    program_puts(self, "(abs(");
+    program_number(self, kind, depth);
+    program_puts(self, ") + 1)");
+}
+
+// The right operand of '*' or '*='. Most int factors are kept small, or
+// products would overflow long before the end of most programs.
+static void program_factor(Program* self, Kind kind, int depth) {
+    if (kind != KIND_INT || check_below(self, 10) == 0) {
+        program_number(self, kind, depth);
+        return;
+    }
+    program_puts(self, "(");
+    program_number(self, kind, depth);
+    program_puts(self, " % 1000)");
+}
+
+// The right operand of `op`.
+static void program_operand(Program* self, const char* op, Kind kind, int depth) {
+    if (op[1] == '/' || op[1] == '%') program_divisor(self, kind, depth);
+    else if (op[1] == '*') program_factor(self, kind, depth);
+    else program_number(self, kind, depth);
+}
+
+// A number: ints stay ints through +, -, *, / and %, and floats take ints
+// among their operands but not '%', which only ints have.
+static void program_number(Program* self, Kind kind, int depth) {
+    if (depth >= 4 || check_below(self, 10) < 3) {
+        program_leaf(self, kind);
+        return;
+    }
+
+    switch (check_below(self, 10)) {
+        case 0: case 1: case 2: case 3: {
+            const char* op = PICK(self, arithmetic_ops);
+            if (kind == KIND_FLOAT && op[1] == '%') op = " * ";
+            program_puts(self, "(");
+            program_number(self, kind, depth + 1);
+            program_puts(self, op);
+            program_operand(self, op, kind, depth + 1);
+            program_puts(self, ")");
+            break;
+        }
+        case 4: case 5:
+            program_puts(self, "(");
+            program_number(self, kind, depth + 1);
+            program_puts(self, kind == KIND_INT && check_below(self, 2) ? " % " : " / ");
+            if (check_below(self, 4) == 0) program_puts(self, "-");
+            program_puts(self, PICK(self, divisors));
+            program_puts(self, ")");
+            break;
+        case 6:
+            program_puts(self, "-");
+            program_number(self, kind, depth + 1);
+            break;
+        case 7:
+            if (check_below(self, 3) == 0) {
+                program_puts(self, "abs(");
+            } else {
+                program_puts(self, check_below(self, 2) ? "min(" : "max(");
+                program_number(self, kind, depth + 1);
+                program_puts(self, ", ");
+            }
+            program_number(self, kind, depth + 1);
+            program_puts(self, ")");
+            break;
+        case 8: {
+            // An assignment in the middle of an expression.
+            const Name* name = find_variable(self, kind, true);
+            if (!name) {
+                program_leaf(self, kind);
+                break;
+            }
+            const char* op = PICK(self, assign_ops);
+            program_puts(self, "(");
+            program_puts(self, name->spelling);
+            program_puts(self, op);
+            program_operand(self, op, kind, depth + 1);
+            program_puts(self, ")");
+            break;
+        }
+        default:
+            program_puts(self, "(");
+            program_number(self, kind, depth + 1);
+            program_puts(self, check_below(self, 2) ? " and " : " or ");
+            program_number(self, kind, depth + 1);
+            program_puts(self, ")");
+            break;
+    }
+}
+
+static void program_condition(Program* self, int depth) {
+    if (depth >= 4 || check_below(self, 10) < 2) {
+        program_leaf(self, KIND_BOOL);
+        return;
+    }
+
+    switch (check_below(self, 6)) {
+        case 0: case 1: case 2: {
+            Kind operands = check_below(self, 3) ? KIND_INT : KIND_FLOAT;
+            program_puts(self, "(");
+            program_number(self, operands, depth + 1);
+            program_puts(self, PICK(self, compare_ops));
+            program_number(self, operands, depth + 1);
+            program_puts(self, ")");
+            break;
+        }
+        case 3: case 4:
+            program_puts(self, "(");
+            program_condition(self, depth + 1);
+            program_puts(self, check_below(self, 2) ? " and " : " or ");
+            program_condition(self, depth + 1);
+            program_puts(self, ")");
+            break;
+        default:
+            program_puts(self, "!");
+            program_condition(self, depth + 1);
+            break;
+    }
+}
+
+static void program_expr(Program* self, Kind kind) {
+    if (kind == KIND_BOOL) program_condition(self, 0);
+    else program_number(self, kind, 0);
+}
+
+// Declares a global g<n> or, inside a block, a local l<n>.
+static void program_declaration(Program* self, int depth) {
+    if (self->name_count == CHECK_MAX_NAMES) return;
+
+    Name* name = &self->names[self->name_count];
+    if (depth == 0) snprintf(name->spelling, sizeof(name->spelling), "g%zu", self->global_count++);
+    else snprintf(name->spelling, sizeof(name->spelling), "l%zu", self->local_count++);
+    size_t pick = check_below(self, 10);
+    name->kind = pick < 6 ? KIND_INT : pick < 8 ? KIND_FLOAT : KIND_BOOL;
+
+    static const char* const types[] = { [KIND_INT] = "int ", [KIND_FLOAT] = "float ", [KIND_BOOL] = "bool " };
+    program_puts(self, types[name->kind]);
+    program_puts(self, name->spelling);
+    program_puts(self, " = ");
+    program_expr(self, name->kind);
+    program_puts(self, ";\n");
+    self->name_count++;
+}
+
+static void program_assignment(Program* self) {
+    const Name* name = &self->names[check_below(self, self->name_count)];
+    const char* op = name->kind == KIND_BOOL ? " = " : PICK(self, assign_ops);
+    program_puts(self, name->spelling);
+    program_puts(self, op);
+    if (name->kind == KIND_BOOL) program_condition(self, 0);
+    else program_operand(self, op, name->kind, 0);
+    program_puts(self, ";\n");
+}
+
+static void program_block(Program* self, int depth, size_t statements) {
+    size_t scope = self->name_count;
+    for (size_t i = 0; i < statements; i++) {
+        size_t pick = check_below(self, 20);
+        if (pick < 6 || self->name_count == 0) {
+            program_declaration(self, depth);
+        } else if (pick < 13) {
+            program_assignment(self);
+        } else if (pick < 15) {
+            program_expr(self, check_below(self, 2) ? KIND_INT : KIND_FLOAT);
+            program_puts(self, ";\n");
+        } else if (depth < CHECK_MAX_DEPTH) {
+            program_puts(self, "{\n");
+            program_block(self, depth + 1, 1 + check_below(self, 8));
+            program_puts(self, "}\n");
+        }
+    }
+
+    // Locals are gone after the block, so one of them is handed to a global
+    // of the same kind to keep its value observable.
+    if (depth > 0 && self->name_count > scope) {
+        const Name* local = &self->names[scope + check_below(self, self->name_count - scope)];
+        for (size_t i = 0; i < scope; i++) {
+            const Name* global = &self->names[i];
+            if (global->spelling[0] != 'g' || global->kind != local->kind) continue;
+            program_puts(self, global->spelling);
+            program_puts(self, " = ");
+            program_puts(self, local->spelling);
+            program_puts(self, ";\n");
+            break;
+        }
+    }
+    self->name_count = scope;
+}
+
+static char* generate_program(uint64_t seed) {
+    Program program;
+    memset(&program, 0, sizeof(program));
+    program.capacity = 1024;
+    program.data = (char*)malloc(program.capacity);
+    program.state = seed;
+    if (!program.data) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate program.\n");
+        exit(EXIT_FAILURE);
+    }
+    program.data[0] = '\0';
+
+    program_block(&program, 0, 5 + check_below(&program, 30));
+    if (check_below(&program, 2)) {
+        program_puts(&program, "return ");
+        program_expr(&program, KIND_INT);
+        program_puts(&program, ";\n");
+    }
+    return program.data;
+}
+
+// What one run left behind.
+typedef struct Outcome {
+    bool ok;
+    Value result;
+    Value* globals;
+    uint32_t global_count;
+    uint32_t error_offset;
+    char* error;
+} Outcome;
+
+static Outcome run_once(VM* vm, Function* script) {
+    Outcome outcome;
+    outcome.result = NIL_VAL;
+    outcome.ok = vm_run(vm, script, &outcome.result);
+    outcome.global_count = script->global_count;
+    outcome.globals = (Value*)malloc((script->global_count + 1) * sizeof(Value));
+    if (!outcome.globals) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate globals.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(outcome.globals, vm->globals, script->global_count * sizeof(Value));
+
+    outcome.error_offset = 0;
+    outcome.error = NULL;
+    if (vm->errors.size > 0) {
+        outcome.error_offset = vm->errors.items[0].offset;
+        outcome.error = strdup(vm->errors.items[0].message);
+    }
+    free_diagnostics(&vm->errors);
+    vm->errors = create_diagnostics();
+    return outcome;
+}
+
+static void free_outcome(Outcome* outcome) {
+    free(outcome->globals);
+    free(outcome->error);
+}
+
+static void print_outcome(const char* name, const Outcome* outcome) {
+    fprintf(stderr, "  %s: %s, result ", name, outcome->ok ? "ok" : "failed");
+    print_value(stderr, outcome->result);
+    if (outcome->error) fprintf(stderr, ", error at %u: %s", outcome->error_offset, outcome->error);
+    fprintf(stderr, "\n   ");
+    for (uint32_t i = 0; i < outcome->global_count; i++) {
+        fprintf(stderr, " ");
+        print_value(stderr, outcome->globals[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+static bool same_outcome(const Outcome* a, const Outcome* b) {
+    if (a->ok != b->ok || a->global_count != b->global_count) return false;
+    if (a->ok && a->result != b->result) return false;
+    if (memcmp(a->globals, b->globals, a->global_count * sizeof(Value)) != 0) return false;
+    if (!a->error || !b->error) return a->error == b->error;
+    return a->error_offset == b->error_offset && strcmp(a->error, b->error) == 0;
+}
+
+typedef struct CheckStats {
+    size_t programs;
+    size_t skipped;
+    size_t compiled;
+    size_t deoptimized;
+    size_t failed;
+    size_t mismatches;
+} CheckStats;
+
+static Function* compile_program(const CompilationUnit* unit) {
+    Diagnostics diagnostics = create_diagnostics();
+    Function* script = compile_unit(unit, &diagnostics, true);
+    free_diagnostics(&diagnostics);
+    return script;
+}
+
+static void check_program(uint64_t seed, int runs, CheckStats* stats) {
+    char* source = generate_program(seed);
+    Lexer* lexer = create_lexer(source, strlen(source));
+    Parser* parser = create_streaming_parser(lexer);
+    CompilationUnit unit = parse(parser);
+    fold_constants(&unit);
+    stats->programs++;
+
+    Function* interpreted = unit.diagnostics.size == 0 ? compile_program(&unit) : NULL;
+    Function* jitted = interpreted ? compile_program(&unit) : NULL;
+    if (!jitted) {
+        stats->skipped++;
+        if (interpreted) free_function(interpreted);
+        free_compilation_unit(&unit);
+        free_parser(parser);
+        free_lexer(lexer);
+        free(source);
+        return;
+    }
+
+    VM* vm = create_vm();
+    vm->jit = false;
+    Outcome expected = run_once(vm, interpreted);
+    free_vm(vm);
+    if (!expected.ok) stats->failed++;
+
+    vm = create_vm();
+    for (int run = 0; run < runs; run++) {
+        Outcome actual = run_once(vm, jitted);
+        bool same = same_outcome(&expected, &actual);
+        if (!same) {
+            stats->mismatches++;
+            fprintf(stderr, "MISMATCH: program %llu, run %d of %d:\n%s",
+                    (unsigned long long)seed, run + 1, runs, source);
+            print_outcome("interpreter", &expected);
+            print_outcome("jit", &actual);
+        }
+        free_outcome(&actual);
+        if (!same) break;
+    }
+    if (jitted->jit || jitted->deopts > 0) stats->compiled++;
+    if (jitted->deopts > 0) stats->deoptimized++;
+    free_vm(vm);
+
+    free_outcome(&expected);
+    free_function(interpreted);
+    free_function(jitted);
+    free_compilation_unit(&unit);
+    free_parser(parser);
+    free_lexer(lexer);
+    free(source);
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: nuuk-jit-check [--programs=<n>] [--seed=<n>] [--runs=<n>]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    size_t programs = 1200;
+    uint64_t seed = 1;
+    int runs = JIT_HOT_RUNS + JIT_MAX_DEOPTS;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--programs=", 11) == 0) programs = (size_t)strtoull(arg + 11, NULL, 10);
+        else if (strncmp(arg, "--seed=", 7) == 0) seed = strtoull(arg + 7, NULL, 10);
+        else if (strncmp(arg, "--runs=", 7) == 0) runs = atoi(arg + 7);
+        else usage();
+    }
+    if (runs < 1) usage();
+
+    if (!jit_available()) {
+        printf("nuuk-jit-check: the JIT is not available on this platform; nothing to check.\n");
+        return 0;
+    }
+
+    CheckStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (size_t i = 0; i < programs; i++) check_program(seed + i, runs, &stats);
+
+    printf("nuuk-jit-check: %zu programs (seeds %llu..%llu), %zu did not compile, %zu ran into a runtime error, "
+           "%zu ran as machine code, %zu of them deoptimized; %zu mismatches\n",
+           stats.programs, (unsigned long long)seed, (unsigned long long)(seed + programs - 1), stats.skipped,
+           stats.failed, stats.compiled, stats.deoptimized, stats.mismatches);
+    return stats.mismatches ? 1 : 0;
+}
@@ -1,22 +1,145 @@
-
 #include "lexer.h"
 
-Lexer* create_lexer(const char* source) {
+static Lexer* alloc_lexer() {
     Lexer* lexer = (Lexer*)malloc(sizeof(Lexer));
-    lexer->source = strdup(source);
+    if (!lexer) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate lexer.\n");
+        exit(EXIT_FAILURE);
+    }
     lexer->tokens = create_token_array(2);
     lexer->start = 0;
     lexer->current = 0;
-    lexer->length = strlen(source);
-    lexer->ln = 1;
-    lexer->col = 0;
-    lexer->keywords = map_keywords();
+    lexer->scan = scan_ops();
+    lexer->has_token = false;
+    lexer->stream = NULL;
+    lexer->base = 0;
+    lexer->buffer = NULL;
+    lexer->capacity = 0;
+    lexer->stream_done = true;
+    lexer->lexemes = NULL;
+    lexer->speculative = false;
+    lexer->failed = false;
+    memset(lexer->atoms, 0, sizeof(lexer->atoms));
+    line_table_add(&lexer->tokens.lines, 0);
+
+    return lexer;
+}
+
+// The lexer borrows source[0, length), which need not be NUL-terminated (it
+// is usually a Source mapping). Every token span points into it, so the
+// buffer must outlive the token array and any AST built from it.
+Lexer* create_lexer(const char* source, size_t length) {
+    if (length > LEXER_MAX_SOURCE) {
+        fprintf(stderr, "ERROR: source is too large (%zu bytes, max %zu).\n", length, LEXER_MAX_SOURCE);
+        exit(EXIT_FAILURE);
+    }
+
+    Lexer* lexer = alloc_lexer();
+    lexer->source = source;
+    lexer->tokens.source = source;
+    lexer->length = length;
+
+    return lexer;
+}
+
+// Reads `stream` lazily, LEXER_CHUNK_SIZE bytes at a time. The stream is not
+// closed by the lexer.
+Lexer* create_stream_lexer(FILE* stream) {
+    Lexer* lexer = alloc_lexer();
+    lexer->stream = stream;
+    lexer->stream_done = false;
+    lexer->capacity = LEXER_CHUNK_SIZE;
+    lexer->buffer = (char*)malloc(lexer->capacity);
+    if (!lexer->buffer) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate lexer buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+    lexer->source = lexer->buffer;
+    lexer->length = 0;
+    lexer->lexemes = create_arena(0);
 
     return lexer;
 }
 
+// Releases the lexer, its token array and, in streaming mode, the copied
+// lexemes. Tokens and AST nodes built from this lexer must not be used after.
+void free_lexer(Lexer* self) {
+    free_token_array(&self->tokens);
+    free(self->buffer);
+    free_arena(self->lexemes);
+    free(self);
+}
+
+// Slides the window so it starts at the current token and appends the next
+// chunk of the stream. Returns false once the stream is exhausted.
+bool lexer_fill(Lexer* self) {
+    if (self->stream_done) return false;
+
+    size_t keep = self->length - self->start;
+    memmove(self->buffer, self->buffer + self->start, keep);
+    self->base += self->start;
+    self->current -= self->start;
+    self->start = 0;
+    self->length = keep;
+
+    if (self->capacity - self->length < LEXER_CHUNK_SIZE) {
+        self->capacity = self->length + LEXER_CHUNK_SIZE;
+        self->buffer = (char*)realloc(self->buffer, self->capacity);
+        if (!self->buffer) {
+            fprintf(stderr, "FATAL ERROR: Failed to grow lexer buffer.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    self->source = self->buffer;
+
+    size_t read = fread(self->buffer + self->length, 1, self->capacity - self->length, self->stream);
+    if (read == 0) {
+        self->stream_done = true;
+        return false;
+    }
+    self->length += read;
+    if (self->base + self->length > LEXER_MAX_SOURCE) {
+        fprintf(stderr, "ERROR: stream is too large (max %zu bytes).\n", LEXER_MAX_SOURCE);
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+// Turns the current token, up to the end of its line, into an ILLEGAL token.
+// The parser reports it (see lexer_error_message) and carries on, so one bad
+// literal does not hide the errors after it. A speculative lexer (see
+// parallel.c) instead records the failure and jumps to the end of its input,
+// since its start position may have been wrong in the first place. The
+// skipped lines are still recorded so the line table stays complete.
+void lexer_error(Lexer* self) {
+    if (self->speculative) {
+        self->failed = true;
+        lexer_add_lines(self, self->current, self->length);
+        self->current = self->length;
+        return;
+    }
+    while (!lexer_eof(self) && lexer_current(self) != '\n') self->current++;
+    lexer_add_span(self, ILLEGAL, self->start, self->current);
+}
+
+// The error an ILLEGAL token stands for.
+const char* lexer_error_message(const Token* token) {
+    return token_lexeme(token)[0] == '\'' ? "Unterminated char literal." : "Unterminated string.";
+}
+
+// Records the start of every line that begins after a newline in
+// source[from, to).
+void lexer_add_lines(Lexer* self, size_t from, size_t to) {
+    const char* p = self->source + from;
+    const char* end = self->source + to;
+    while ((p = (const char*)memchr(p, '\n', end - p))) {
+        p++;
+        line_table_add(&self->tokens.lines, (uint32_t)(self->base + (p - self->source)));
+    }
+}
+
 char lexer_eof(Lexer* self) {
-    return (self->current >= self->length);
+    return (self->current >= self->length) && !lexer_fill(self);
 }
 
 char lexer_current(Lexer* self) {
@@ -25,96 +148,149 @@ char lexer_current(Lexer* self) {
 
 char lexer_next(Lexer* self) {
     if (lexer_eof(self)) {
-        fprintf(stderr, "[%zu:%zu] ERROR: attempted to read past EOF.\n", self->ln, self->col);
+        fprintf(stderr, "ERROR: attempted to read past EOF.\n");
         return '\0';
     }
     char c = lexer_current(self);
     self->current++;
-    self->col++;
     return c;
 }
 
 char lexer_peek(Lexer* self, size_t offset) {
-    if (self->current + offset >= self->length) return '\0';
+    while (self->current + offset >= self->length) {
+        if (!lexer_fill(self)) return '\0';
+    }
     return self->source[self->current + offset];
 }
 
-void lexer_add(Lexer* self, TokenType id, const char* value) {
-    token_array_add(&self->tokens, create_token(id, value, self->ln, self->col));
+// Skips `count` bytes of the current line in one step. Callers guarantee that
+// the bytes exist and contain no newline.
+void lexer_advance(Lexer* self, size_t count) {
+    self->current += count;
+}
+
+// Advances over the longest run accepted by `run`, refilling the window in
+// streaming mode when the run reaches its end.
+static void lexer_advance_run(Lexer* self, size_t (*run)(const char* p, size_t n)) {
+    do {
+        lexer_advance(self, run(self->source + self->current, self->length - self->current));
+    } while (self->current >= self->length && lexer_fill(self));
+}
+
+static void lexer_emit(Lexer* self, Token token) {
+    token.offset = (uint32_t)(self->base + self->start);
+    self->token = token;
+    self->has_token = true;
+}
+
+void lexer_add(Lexer* self, TokenType id) {
+    lexer_emit(self, create_token(id, NULL, 0));
     lexer_next(self);
 }
 
-void lexer_add_db(Lexer* self, TokenType id, const char* value) {
-    token_array_add(&self->tokens, create_token(id, value, self->ln, self->col));
+void lexer_add_db(Lexer* self, TokenType id) {
+    lexer_emit(self, create_token(id, NULL, 0));
     lexer_next(self);
     lexer_next(self);
 }
 
-TokenArray* tokenize(Lexer* self) {
+// Adds a token spanning source[start, end).
+void lexer_add_span(Lexer* self, TokenType id, size_t start, size_t end) {
+    const char* lexeme = self->source + start;
+    if (self->lexemes) lexeme = arena_strndup(self->lexemes, lexeme, end - start);
+    lexer_emit(self, create_token(id, lexeme, end - start));
+}
+
+// Scans and returns the next token. Once the input is exhausted every call
+// returns END_OF_FILE.
+Token lexer_next_token(Lexer* self) {
     while (!lexer_eof(self)) {
         self->start = self->current;
+        self->has_token = false;
         lexer_scan_token(self);
+        if (self->has_token) return self->token;
+    }
+
+    Token eof = create_token(END_OF_FILE, NULL, 0);
+    eof.offset = (uint32_t)(self->base + self->length);
+    return eof;
+}
+
+// Lexes the whole source into the lexer's token array. Stored tokens refer
+// back to the source by offset, so this needs an in-memory source; streams
+// are only parsed token by token (see create_streaming_parser).
+TokenArray* tokenize(Lexer* self) {
+    if (self->stream) {
+        fprintf(stderr, "FATAL ERROR: Cannot materialize the tokens of a stream.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (;;) {
+        Token token = lexer_next_token(self);
+        token_array_add(&self->tokens, token);
+        if (token.type == END_OF_FILE) break;
     }
 
-    token_array_add(&self->tokens, create_token(END_OF_FILE, "END_OF_FILE", self->ln, self->col));
     return &self->tokens;
 }
 
 void lexer_scan_token(Lexer* self) {
     char current = lexer_current(self);
-    printf("scanning current: %c\n", current);
 
     switch (current) {
-        case '(': lexer_add(self, LPAREN, "("); break;
-        case ')': lexer_add(self, RPAREN, ")"); break;
-        case '{': lexer_add(self, LBRACE, "{"); break;
-        case '}': lexer_add(self, RBRACE, "}"); break;
-        case '[': lexer_add(self, LSQUARE, "["); break;
-        case ']': lexer_add(self, RSQUARE, "]"); break;
-        case ',': lexer_add(self, COMMA, ","); break;
-        case '.': lexer_add(self, DOT, "."); break;
-        case ';': lexer_add(self, SEMICOLON, ";"); break;
-        case '%': lexer_add(self, MOD, "%"); break;
-        case '@': lexer_add(self, AT, "@"); break;
-        case '&': lexer_add(self, AMPERSAND, "&"); break;    
+        case '(': lexer_add(self, LPAREN); break;
+        case ')': lexer_add(self, RPAREN); break;
+        case '{': lexer_add(self, LBRACE); break;
+        case '}': lexer_add(self, RBRACE); break;
+        case '[': lexer_add(self, LSQUARE); break;
+        case ']': lexer_add(self, RSQUARE); break;
+        case ',': lexer_add(self, COMMA); break;
+        case '.': lexer_add(self, DOT); break;
+        case ';': lexer_add(self, SEMICOLON); break;
+        case '%': lexer_add(self, MOD); break;
+        case '@': lexer_add(self, AT); break;
+        case '&': lexer_add(self, AMPERSAND); break;    
         case ':': switch (lexer_peek(self, 1) == ':') {
-            case true: lexer_add_db(self, COLON_COLON, "::"); break;
-            case false: lexer_add(self, COLON, ":"); break;
+            case true: lexer_add_db(self, COLON_COLON); break;
+            case false: lexer_add(self, COLON); break;
         }; break;
         case '-': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, MINUS_EQ, "-="); break;
-            case false: lexer_add(self, MINUS, "-"); break;
+            case true: lexer_add_db(self, MINUS_EQ); break;
+            case false: lexer_add(self, MINUS); break;
         }; break;
         case '+': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, PLUS_EQ, "+="); break;
-            case false: lexer_add(self, PLUS, "+"); break;
+            case true: lexer_add_db(self, PLUS_EQ); break;
+            case false: lexer_add(self, PLUS); break;
         }; break;
         case '*': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, STAR_EQ, "*="); break;
-            case false: lexer_add(self, STAR, "*"); break;
+            case true: lexer_add_db(self, STAR_EQ); break;
+            case false: lexer_add(self, STAR); break;
         }; break;
         case '/': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, SLASH_EQ, "/="); break;
-            case false: lexer_add(self, SLASH, "/"); break;
+            case true: lexer_add_db(self, SLASH_EQ); break;
+            case false: lexer_add(self, SLASH); break;
         }; break;
         case '!': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, NEQ, "!="); break;
-            case false: lexer_add(self, BANG, "!"); break;
+            case true: lexer_add_db(self, NEQ); break;
+            case false: lexer_add(self, BANG); break;
         } break;
         case '=': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, EQ, "=="); break;
-            case false: lexer_add(self, ASSIGN, "="); break;
+            case true: lexer_add_db(self, EQ); break;
+            case false: lexer_add(self, ASSIGN); break;
         } break;
         case '<': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, LTE, "<="); break;
-            case false: lexer_add(self, LT, "<"); break;
+            case true: lexer_add_db(self, LTE); break;
+            case false: lexer_add(self, LT); break;
         }; break;
         case '>': switch (lexer_peek(self, 1) == '=') {
-            case true: lexer_add_db(self, GTE, ">="); break;
-            case false: lexer_add(self, GT, ">"); break;
+            case true: lexer_add_db(self, GTE); break;
+            case false: lexer_add(self, GT); break;
         }; break;
         case '"': lexer_scan_string(self); break;
         case '\'': lexer_scan_char(self); break;
+        case ' ': case '\t': case '\r': case '\n':
+            lexer_skip_whitespace(self);
+            break;
         default:
             if (is_numeric(current)) lexer_scan_number(self);
             else if (is_alpha(current)) lexer_scan_ident(self);
@@ -122,89 +298,163 @@ void lexer_scan_token(Lexer* self) {
     }
 }
 
+void lexer_skip_whitespace(Lexer* self) {
+    do {
+        size_t lines, last_newline = 0;
+        size_t count = self->scan->whitespace(self->source + self->current, self->length - self->current, &lines, &last_newline);
+
+        if (lines == 1) {
+            line_table_add(&self->tokens.lines, (uint32_t)(self->base + self->current + last_newline + 1));
+        } else if (lines) {
+            lexer_add_lines(self, self->current, self->current + count);
+        }
+        self->current += count;
+        self->start = self->current;
+    } while (self->current >= self->length && lexer_fill(self));
+}
+
 void lexer_scan_string(Lexer* self) {
     lexer_next(self);
-    while (lexer_current(self) != '"' && !lexer_eof(self) && lexer_current(self) != '\n') {
-        lexer_next(self);
-    }
+    lexer_advance_run(self, self->scan->string);
 
-    if (lexer_eof(self)) {
-        fprintf(stderr, "[%zu:%zu] ERROR: unterminated string.\n", self->ln, self->col);
-        exit(EXIT_FAILURE);
+    if (lexer_eof(self) || lexer_current(self) != '"') {
+        lexer_error(self);
+        return;
     }
 
     lexer_next(self);
-
-    char* value = concat(self->source, self->start, self->current);
-    if (!value) {
-        fprintf(stderr, "[%zu:%zu] ERROR: failed to allocate string.\n", self->ln, self->col);
-        exit(EXIT_FAILURE);
-    }
-
-    lexer_add(self, STRING, value);
+    lexer_add_span(self, STRING, self->start, self->current);
 }
 
 void lexer_scan_number(Lexer* self) {
-    while (is_numeric(lexer_peek(self, 1))) lexer_next(self);
-    lexer_next(self);
-    
-    char* value = concat(self->source, self->start, self->current);
-    if (!value) {
-        fprintf(stderr, "[%zu:%zu] ERROR: failed to allocate number.\n", self->ln, self->col);
-        exit(EXIT_FAILURE);
-    }
-
-    lexer_add(self, NUMBER, value);
-
-    if (!is_numeric(lexer_current(self))) self->current--;
+    lexer_advance_run(self, self->scan->number);
+    lexer_add_span(self, NUMBER, self->start, self->current);
 }
 
 void lexer_scan_char(Lexer* self) {
     lexer_next(self);
-    char c = lexer_current(self);
-
-    char* str = (char*)malloc(2);
-    if (!str) {
-        fprintf(stderr, "[%zu:%zu] ERROR: failed to allocate memory for char.\n", self->ln, self->col);
-        exit(EXIT_FAILURE);
+    if (lexer_eof(self) || lexer_current(self) == '\n' || lexer_peek(self, 1) != '\'') {
+        lexer_error(self);
+        return;
     }
 
-    str[0] = c;
-    str[1] = '\0';
-
-    lexer_add(self, CHAR, str);
-    free(str);
+    lexer_next(self);
+    lexer_next(self);
+    lexer_add_span(self, CHAR, self->start + 1, self->start + 2);
 }
 
 void lexer_scan_ident(Lexer* self) {
-    while (is_alphanumeric(lexer_peek(self, 1)) && !lexer_eof(self)) lexer_next(self);
-    lexer_next(self);
+    lexer_advance_run(self, self->scan->ident);
 
     size_t length = self->current - self->start;
-    if (length == 0) {
-        fprintf(stderr, "[%zu:%zu] ERROR: Empty identifier!\n", self->ln, self->col);
+    TokenType keyword = lookup_keyword(self->source + self->start, length);
+
+    if (keyword != IDENTIFIER) {
+        lexer_emit(self, create_token(keyword, NULL, 0));
         return;
     }
 
-    char* value = concat(self->source, self->start, self->current);
-    if (!value) {
-        fprintf(stderr, "[%zu:%zu] ERROR: concat() returned NULL!\n", self->ln, self->col);
-        exit(1);
-    }
+    const char* name = self->source + self->start;
+    Atom atom = lexer_intern(self, name, length);
 
-    int found;
-    TokenType keyword = hash_get(self->keywords, value, &found);
-    
-    if (found) {
-        lexer_add(self, keyword, value);
-        return;
-    }
-    lexer_add(self, IDENTIFIER, value);
+    // The interned spelling is as good as a copy, so streaming lexers do not
+    // need to put identifiers into their lexeme arena.
+    Token token = create_token(IDENTIFIER, self->lexemes ? atom_name(atom) : name, length);
+    token.atom = atom;
+    lexer_emit(self, token);
+}
 
-    if (!is_alphanumeric(lexer_current(self))) self->current--;
+// Interns an identifier through a small direct-mapped cache of recent atoms,
+// so repeated identifiers usually skip the interner's lock.
+Atom lexer_intern(Lexer* self, const char* name, size_t length) {
+    uint32_t hash = atom_hash(name, length);
+    Atom* cached = &self->atoms[hash & (LEXER_ATOM_CACHE - 1)];
+
+    if (*cached != NO_ATOM && atom_length(*cached) == length && memcmp(atom_name(*cached), name, length) == 0) {
+        return *cached;
+    }
+    *cached = intern_hashed(name, length, hash);
+    return *cached;
 }
 
 
+// Keywords are recognized with a perfect hash over (first char, second char,
+// last char, length). The slot of every entry is computed at compile time by
+// KEYWORD_SLOT, so a collision shows up as an -Woverride-init warning rather
+// than a silent miss. Every keyword is 2..8 characters long.
+#define KEYWORD_TABLE_SIZE 128
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 8
+#define KEYWORD_SLOT(c0, c1, cn, length) \
+    (((c0) * 11u + (c1) + (cn) * 44u + (length) * 5u) & (KEYWORD_TABLE_SIZE - 1))
+#define KEYWORD(name, c0, c1, cn, type) \
+    [KEYWORD_SLOT(c0, c1, cn, sizeof(name) - 1)] = { name, sizeof(name) - 1, type }
+
+typedef struct Keyword {
+    const char* name;
+    size_t length;
+    TokenType type;
+} Keyword;
+
+static const Keyword keywords[KEYWORD_TABLE_SIZE] = {
+    KEYWORD("if", 'i', 'f', 'f', IF),
+    KEYWORD("move", 'm', 'o', 'e', MOVE),
+    KEYWORD("else", 'e', 'l', 'e', ELSE),
+    KEYWORD("try", 't', 'r', 'y', TRY),
+    KEYWORD("while", 'w', 'h', 'e', WHILE),
+    KEYWORD("for", 'f', 'o', 'r', FOR),
+    KEYWORD("break", 'b', 'r', 'k', BREAK),
+    KEYWORD("continue", 'c', 'o', 'e', CONTINUE),
+    KEYWORD("switch", 's', 'w', 'h', SWITCH),
+    KEYWORD("case", 'c', 'a', 'e', CASE),
+    KEYWORD("begin", 'b', 'e', 'n', BEGIN),
+    KEYWORD("end", 'e', 'n', 'd', END),
+    KEYWORD("space", 's', 'p', 'e', SPACE),
+    KEYWORD("static", 's', 't', 'c', STATIC),
+    KEYWORD("struct", 's', 't', 't', STRUCT),
+    KEYWORD("union", 'u', 'n', 'n', UNION),
+    KEYWORD("enum", 'e', 'n', 'm', ENUM),
+    KEYWORD("tagged", 't', 'a', 'd', TAGGED),
+    KEYWORD("const", 'c', 'o', 't', CONST),
+    KEYWORD("use", 'u', 's', 'e', USE),
+    KEYWORD("def", 'd', 'e', 'f', DEF),
+    KEYWORD("new", 'n', 'e', 'w', NEW),
+    KEYWORD("return", 'r', 'e', 'n', RETURN),
+    KEYWORD("foreach", 'f', 'o', 'h', FOREACH),
+    KEYWORD("in", 'i', 'n', 'n', IN),
+    KEYWORD("default", 'd', 'e', 't', DEFAULT),
+    KEYWORD("extern", 'e', 'x', 'n', EXTERN),
+    KEYWORD("macro", 'm', 'a', 'o', MACRO),
+    KEYWORD("final", 'f', 'i', 'l', FINAL),
+    KEYWORD("import", 'i', 'm', 't', IMPORT),
+    KEYWORD("nameof", 'n', 'a', 'f', NAMEOF),
+    KEYWORD("sizeof", 's', 'i', 'f', SIZEOF),
+    KEYWORD("typeof", 't', 'y', 'f', TYPEOF),
+    KEYWORD("fall", 'f', 'a', 'l', FALL),
+    KEYWORD("varargs", 'v', 'a', 's', VARARGS),
+    KEYWORD("vararg", 'v', 'a', 'g', VARARG),
+    KEYWORD("finally", 'f', 'i', 'y', FINALLY),
+    KEYWORD("expand", 'e', 'x', 'd', EXPAND),
+    KEYWORD("and", 'a', 'n', 'd', AND),
+    KEYWORD("or", 'o', 'r', 'r', OR),
+    KEYWORD("unique", 'u', 'n', 'e', UNIQUE),
+    KEYWORD("shared", 's', 'h', 'd', SHARED),
+    KEYWORD("true", 't', 'r', 'e', TRUE),
+    KEYWORD("false", 'f', 'a', 'e', FALSE),
+};
+
+// Returns the keyword type spelled by source[0, length), or IDENTIFIER.
+TokenType lookup_keyword(const char* start, size_t length) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return IDENTIFIER;
+
+    const unsigned char* s = (const unsigned char*)start;
+    const Keyword* keyword = &keywords[KEYWORD_SLOT(s[0], s[1], s[length - 1], length)];
+    if (keyword->length == length && memcmp(keyword->name, start, length) == 0) {
+        return keyword->type;
+    }
+    return IDENTIFIER;
+}
+
 bool is_numeric(char c) {
     return (c >= '0' && c <= '9') || c == '.';
 }
@@ -214,5 +464,5 @@ bool is_alpha(char c) {
 }
 
 bool is_alphanumeric(char c) {
-    return is_alpha(c) || is_numeric(c);
+    return is_alpha(c) || (c >= '0' && c <= '9');
 }
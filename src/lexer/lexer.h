@@ -2,32 +2,71 @@
 #define NUUK_LEXER_H
 
 #include "E:\THE_LANGUAGE\src\utils\utils.h"
+#include "E:\THE_LANGUAGE\src\utils\arena.h"
+#include "E:\THE_LANGUAGE\src\utils\intern.h"
+#include "scan.h"
 #include <stdbool.h>
 
+#define LEXER_CHUNK_SIZE (64 * 1024)
+// Token offsets are 32-bit.
+#define LEXER_MAX_SOURCE ((size_t)UINT32_MAX)
+#define LEXER_ATOM_CACHE 256
+
+// A lexer either borrows a complete in-memory source or pulls it in chunks
+// from a stream. In streaming mode `source` is a sliding window that only
+// keeps the bytes of the token being scanned, starting at stream offset
+// `base`; spans of emitted tokens are copied into `lexemes` so they outlive
+// the window. Line starts are recorded into `tokens.lines` as whitespace is
+// skipped, whether or not tokens are materialized.
 typedef struct Lexer {
     const char* source;
     TokenArray tokens;
     size_t length;
     size_t start;
     size_t current;
-    size_t ln;
-    size_t col;
-    HashMap* keywords;
+    const ScanOps* scan;
+
+    Token token;
+    bool has_token;
+
+    FILE* stream;
+    size_t base;
+    char* buffer;
+    size_t capacity;
+    bool stream_done;
+    Arena* lexemes;
+
+    bool speculative;
+    bool failed;
+
+    Atom atoms[LEXER_ATOM_CACHE];
 } Lexer;
 
-Lexer* create_lexer(const char* source);
+Lexer* create_lexer(const char* source, size_t length);
+Lexer* create_stream_lexer(FILE* stream);
+void free_lexer(Lexer* self);
+bool lexer_fill(Lexer* self);
+void lexer_error(Lexer* self);
+const char* lexer_error_message(const Token* token);
+void lexer_add_lines(Lexer* self, size_t from, size_t to);
 char lexer_eof(Lexer* self);
 char lexer_current(Lexer* self);
 char lexer_next(Lexer* self);
 char lexer_peek(Lexer* self, size_t offset);
-void lexer_add(Lexer* self, TokenType id, const char* value);
-void lexer_add_db(Lexer* self, TokenType id, const char* value);
+void lexer_advance(Lexer* self, size_t count);
+void lexer_add(Lexer* self, TokenType id);
+void lexer_add_db(Lexer* self, TokenType id);
+void lexer_add_span(Lexer* self, TokenType id, size_t start, size_t end);
+Token lexer_next_token(Lexer* self);
 TokenArray* tokenize(Lexer* self);
 void lexer_scan_token(Lexer* self);
+void lexer_skip_whitespace(Lexer* self);
 void lexer_scan_string(Lexer* self);
 void lexer_scan_number(Lexer* self);
 void lexer_scan_char(Lexer* self);
 void lexer_scan_ident(Lexer* self);
+Atom lexer_intern(Lexer* self, const char* name, size_t length);
+TokenType lookup_keyword(const char* start, size_t length);
 
 bool is_numeric(char c);
 bool is_alpha(char c);
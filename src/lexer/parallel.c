@@ -0,0 +1,146 @@
+#include "parallel.h"
+
+#include <stdint.h>
+
+// The source is cut right after newlines into chunks that are lexed
+// independently. A first parallel pass collects the line starts of every
+// chunk (newlines only ever appear in whitespace, so this is what the lexer
+// would record); a second pass lexes them.
+//
+// Every chunk speculates that its first byte is a token boundary. Each chunk
+// also records `sync`, the start of the first token it saw at or past its
+// nominal end (finishing any token that runs over), and `first`, the start of
+// its own first token. The speculation for chunk i holds iff
+// chunks[i - 1].sync == chunks[i].first; otherwise chunk i started in the
+// middle of a token (e.g. inside a literal) and is re-lexed from the previous
+// chunk's sync point while stitching. Speculative lexers never exit on a
+// lexical error; they mark the chunk as failed, which also forces a re-lex.
+// With the current grammar no token spans a newline, so this only triggers
+// if that ever changes.
+
+typedef struct LexChunk {
+    const char* source;
+    size_t length;
+    size_t begin;
+    size_t end;
+    LineTable lines;
+
+    TokenArray tokens;
+    size_t first;
+    size_t sync;
+} LexChunk;
+
+static void collect_chunk_lines(void* arg) {
+    LexChunk* chunk = (LexChunk*)arg;
+    const char* p = chunk->source + chunk->begin;
+    const char* end = chunk->source + chunk->end;
+
+    chunk->lines = create_line_table();
+    while ((p = (const char*)memchr(p, '\n', end - p))) {
+        p++;
+        line_table_add(&chunk->lines, (uint32_t)(p - chunk->source));
+    }
+}
+
+static void lex_chunk_from(LexChunk* chunk, size_t from, bool speculative) {
+    Lexer* lexer = create_lexer(chunk->source, chunk->length);
+    lexer->speculative = speculative;
+    lexer->current = from;
+
+    chunk->tokens = create_token_array((chunk->end - chunk->begin) / 4 + 16);
+    for (;;) {
+        Token token = lexer_next_token(lexer);
+        size_t at = token.type == END_OF_FILE ? chunk->length : lexer->start;
+
+        if (token.type == END_OF_FILE || at >= chunk->end) {
+            chunk->sync = at;
+            break;
+        }
+        if (chunk->tokens.size == 0) chunk->first = at;
+        token_array_add(&chunk->tokens, token);
+    }
+    if (chunk->tokens.size == 0) chunk->first = chunk->sync;
+    if (lexer->failed) chunk->first = SIZE_MAX;
+
+    free_lexer(lexer);
+}
+
+static void lex_chunk(void* arg) {
+    LexChunk* chunk = (LexChunk*)arg;
+    lex_chunk_from(chunk, chunk->begin, chunk->begin > 0);
+}
+
+TokenArray tokenize_parallel(const char* source, size_t length, ThreadPool* pool) {
+    if (length > LEXER_MAX_SOURCE) {
+        fprintf(stderr, "ERROR: source is too large (%zu bytes, max %zu).\n", length, LEXER_MAX_SOURCE);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t count = (size_t)thread_pool_size(pool) * PARALLEL_LEX_CHUNKS_PER_THREAD;
+    if (count > length / PARALLEL_LEX_MIN_CHUNK) count = length / PARALLEL_LEX_MIN_CHUNK;
+    if (count < 1) count = 1;
+
+    LexChunk* chunks = (LexChunk*)calloc(count, sizeof(LexChunk));
+    if (!chunks) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate lexer chunks.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t chunk_count = 0;
+    size_t begin = 0;
+    for (size_t i = 1; i <= count && begin < length; i++) {
+        size_t end = length;
+        if (i < count) {
+            size_t target = length / count * i;
+            if (target < begin) target = begin;
+            const char* newline = (const char*)memchr(source + target, '\n', length - target);
+            end = newline ? (size_t)(newline - source) + 1 : length;
+        }
+        if (end <= begin) continue;
+
+        LexChunk* chunk = &chunks[chunk_count++];
+        chunk->source = source;
+        chunk->length = length;
+        chunk->begin = begin;
+        chunk->end = end;
+        begin = end;
+    }
+
+    // Resolve the scanner before fanning out so workers only read it.
+    scan_ops();
+
+    for (size_t i = 0; i < chunk_count; i++) thread_pool_submit(pool, collect_chunk_lines, &chunks[i]);
+    for (size_t i = 0; i < chunk_count; i++) thread_pool_submit(pool, lex_chunk, &chunks[i]);
+    thread_pool_wait(pool);
+
+    size_t total = 1;
+    for (size_t i = 0; i < chunk_count; i++) {
+        if (i > 0 && chunks[i].first != chunks[i - 1].sync) {
+            free_token_array(&chunks[i].tokens);
+            lex_chunk_from(&chunks[i], chunks[i - 1].sync, false);
+        }
+        total += chunks[i].tokens.size;
+    }
+
+    TokenArray tokens = create_token_array(total);
+    tokens.source = source;
+    line_table_add(&tokens.lines, 0);
+    for (size_t i = 0; i < chunk_count; i++) {
+        TokenArray* part = &chunks[i].tokens;
+        memcpy(tokens.kinds + tokens.size, part->kinds, part->size * sizeof(uint8_t));
+        memcpy(tokens.offsets + tokens.size, part->offsets, part->size * sizeof(uint32_t));
+        memcpy(tokens.values + tokens.size, part->values, part->size * sizeof(uint32_t));
+        tokens.size += part->size;
+        free_token_array(part);
+
+        for (size_t j = 0; j < chunks[i].lines.size; j++) line_table_add(&tokens.lines, chunks[i].lines.starts[j]);
+        free_line_table(&chunks[i].lines);
+    }
+
+    Token eof = create_token(END_OF_FILE, NULL, 0);
+    eof.offset = (uint32_t)length;
+    token_array_add(&tokens, eof);
+
+    free(chunks);
+    return tokens;
+}
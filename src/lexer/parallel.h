@@ -0,0 +1,15 @@
+#ifndef NUUK_PARALLEL_LEXER_H
+#define NUUK_PARALLEL_LEXER_H
+
+#include "lexer.h"
+#include "E:\THE_LANGUAGE\src\utils\pool.h"
+
+// Inputs smaller than this per worker are not worth splitting.
+#define PARALLEL_LEX_MIN_CHUNK (1024 * 1024)
+#define PARALLEL_LEX_CHUNKS_PER_THREAD 4
+
+// Tokenizes source[0, length) on `pool` and returns the same token array the
+// sequential tokenize() would, END_OF_FILE included. Spans point into `source`.
+TokenArray tokenize_parallel(const char* source, size_t length, ThreadPool* pool);
+
+#endif
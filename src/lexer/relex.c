@@ -0,0 +1,86 @@
+#include "relex.h"
+
+// A token that is only a prefix of the edited text may grow into it ("a" ->
+// "ab"), so lexing restarts at the last token that begins before the edit.
+// Nothing earlier can change: the lexer looks ahead at most one byte, and
+// the byte after every earlier token is still in place. The lexer carries no
+// state between tokens, so once a new token begins exactly where a shifted
+// old token past the edit began, the two streams are identical from there
+// on. END_OF_FILE always matches, which bounds the walk.
+TokenSplice relex(const TokenArray* tokens, const char* source, size_t length,
+                  size_t edit_start, size_t old_end, size_t new_end) {
+    TokenSplice splice;
+    splice.inserted = create_token_array(16);
+    splice.inserted.source = source;
+    splice.delta = (ptrdiff_t)new_end - (ptrdiff_t)old_end;
+
+    size_t before = token_array_below(tokens, 0, tokens->size, (uint32_t)edit_start);
+    splice.first = before ? before - 1 : 0;
+    size_t restart = before ? token_array_offset(tokens, splice.first) : 0;
+
+    Lexer* lexer = create_lexer(source, length);
+    lexer->current = restart;
+
+    size_t old = splice.first;
+    for (;;) {
+        Token token = lexer_next_token(lexer);
+
+        if (token.offset >= new_end) {
+            size_t target = token.offset - splice.delta;
+            uint32_t at = token_array_offset(tokens, old);
+            while (old < tokens->size - 1 && (at < old_end || at < target)) at = token_array_offset(tokens, ++old);
+
+            if (token.type == END_OF_FILE || (at >= old_end && at == target)) break;
+        }
+        token_array_add(&splice.inserted, token);
+    }
+    splice.removed = old - splice.first;
+
+    // Line starts in (restart, convergence] were rescanned; the lexer's own
+    // table begins with line 1 at offset 0, which is never in that range.
+    size_t converged = token_array_offset(tokens, old);
+    splice.first_line = line_table_below(&tokens->lines, (uint32_t)restart + 1);
+    splice.removed_lines = line_table_below(&tokens->lines, (uint32_t)converged + 1) - splice.first_line;
+
+    LineTable* lines = &lexer->tokens.lines;
+    for (size_t i = line_table_below(lines, (uint32_t)restart + 1); i < lines->size; i++) {
+        line_table_add(&splice.inserted.lines, lines->starts[i]);
+    }
+
+    free_lexer(lexer);
+    return splice;
+}
+
+// The replaced entries are the ones just before the gap once it sits after
+// them, so they are dropped by shrinking `size`, and the new ones are
+// written into the gap. Entries past the gap all move by the same `delta`,
+// which is folded into `tail_delta` instead of being added to each.
+void apply_token_splice(TokenArray* tokens, const TokenSplice* splice, const char* source) {
+    const TokenArray* inserted = &splice->inserted;
+
+    token_array_move_gap(tokens, splice->first + splice->removed);
+    tokens->size -= splice->removed;
+    if (tokens->size + inserted->size > tokens->capacity) token_array_reserve(tokens, (tokens->size + inserted->size) * 2);
+    memcpy(tokens->kinds + splice->first, inserted->kinds, inserted->size * sizeof(uint8_t));
+    memcpy(tokens->offsets + splice->first, inserted->offsets, inserted->size * sizeof(uint32_t));
+    memcpy(tokens->values + splice->first, inserted->values, inserted->size * sizeof(uint32_t));
+    tokens->size += inserted->size;
+    tokens->tail_delta += (uint32_t)splice->delta;
+    tokens->source = source;
+
+    LineTable* lines = &tokens->lines;
+    const LineTable* new_lines = &inserted->lines;
+
+    line_table_move_gap(lines, splice->first_line + splice->removed_lines);
+    lines->size -= splice->removed_lines;
+    if (lines->size + new_lines->size > lines->capacity) line_table_reserve(lines, (lines->size + new_lines->size) * 2);
+    // An edit within one line rescans no line starts, and the empty table
+    // has no array.
+    if (new_lines->size) memcpy(lines->starts + splice->first_line, new_lines->starts, new_lines->size * sizeof(uint32_t));
+    lines->size += new_lines->size;
+    lines->tail_delta += (uint32_t)splice->delta;
+}
+
+void free_token_splice(TokenSplice* splice) {
+    free_token_array(&splice->inserted);
+}
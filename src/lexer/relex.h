@@ -0,0 +1,38 @@
+#ifndef NUUK_RELEX_H
+#define NUUK_RELEX_H
+
+#include "lexer.h"
+
+#include <stddef.h>
+
+// The result of re-lexing an edit: old tokens [first, first + removed) are
+// replaced by `inserted`, and old line starts [first_line, first_line +
+// removed_lines) by `inserted.lines`. Offsets in `inserted` refer to the new
+// source; every old token and line start after the splice moves by `delta`
+// bytes.
+typedef struct TokenSplice {
+    size_t first;
+    size_t removed;
+    TokenArray inserted;
+    size_t first_line;
+    size_t removed_lines;
+    ptrdiff_t delta;
+} TokenSplice;
+
+// Re-lexes the edit that replaced old bytes [edit_start, old_end) with new
+// bytes [edit_start, new_end). `tokens` is the array for the old text and
+// `source`/`length` is the new text. Lexing restarts at the last token that
+// begins before the edit and stops as soon as it reaches a token boundary
+// the old array already has past the edit, so the cost is proportional to
+// the damaged region rather than to the file.
+TokenSplice relex(const TokenArray* tokens, const char* source, size_t length,
+                  size_t edit_start, size_t old_end, size_t new_end);
+
+// Applies the splice in place and points `tokens` at the new source. It
+// moves the array's gap from the previous edit to this one and writes only
+// the replaced entries, so its cost is the distance between the two edits
+// plus the size of the splice, never the length of the file.
+void apply_token_splice(TokenArray* tokens, const TokenSplice* splice, const char* source);
+void free_token_splice(TokenSplice* splice);
+
+#endif
@@ -0,0 +1,287 @@
+#include "scan.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// ################################################################
+// # SCALAR
+// ################################################################
+
+static inline int is_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline int is_ident(unsigned char c) {
+    return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline int is_number(unsigned char c) {
+    return (c >= '0' && c <= '9') || c == '.';
+}
+
+static size_t scalar_whitespace(const char* p, size_t n, size_t* lines, size_t* last_newline) {
+    size_t i = 0;
+    *lines = 0;
+    for (; i < n && is_space((unsigned char)p[i]); i++) {
+        if (p[i] == '\n') {
+            (*lines)++;
+            *last_newline = i;
+        }
+    }
+    return i;
+}
+
+static size_t scalar_ident(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && is_ident((unsigned char)p[i])) i++;
+    return i;
+}
+
+static size_t scalar_number(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && is_number((unsigned char)p[i])) i++;
+    return i;
+}
+
+static size_t scalar_string(const char* p, size_t n) {
+    size_t i = 0;
+    while (i < n && p[i] != '"' && p[i] != '\n') i++;
+    return i;
+}
+
+static size_t scalar_newlines(const char* p, size_t n) {
+    size_t lines = 0;
+    for (size_t i = 0; i < n; i++) lines += (p[i] == '\n');
+    return lines;
+}
+
+static const ScanOps scalar_ops = {
+    "scalar", scalar_whitespace, scalar_ident, scalar_number, scalar_string, scalar_newlines,
+};
+
+#ifdef SCAN_X86
+
+// Vector loops handle whole blocks only and hand the tail to the scalar
+// versions above, so no load ever crosses p + n. Class tests use the usual
+// signed-compare range trick: c in [lo, lo + len) <=> (c + 128 - lo) < -128 + len.
+
+#define SCAN_CTZ(mask) ((size_t)__builtin_ctz(mask))
+#define SCAN_LAST(mask) ((size_t)(31 - __builtin_clz(mask)))
+#define SCAN_POPCOUNT(mask) ((size_t)__builtin_popcount(mask))
+
+// ################################################################
+// # SSE2
+// ################################################################
+
+__attribute__((target("sse2")))
+static inline __m128i sse2_range(__m128i x, char lo, char len) {
+    __m128i shifted = _mm_add_epi8(x, _mm_set1_epi8((char)(128 - (unsigned char)lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + len)));
+}
+
+__attribute__((target("sse2")))
+static inline unsigned sse2_ident_mask(__m128i x) {
+    __m128i alpha = sse2_range(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 26);
+    __m128i digit = sse2_range(x, '0', 10);
+    __m128i under = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_whitespace(const char* p, size_t n, size_t* lines, size_t* last_newline) {
+    size_t i = 0;
+    size_t count = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i nl = _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'));
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\r')), nl));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFF;
+        unsigned newline = (unsigned)_mm_movemask_epi8(nl);
+        if (stop) newline &= (1u << SCAN_CTZ(stop)) - 1;
+        if (newline) {
+            count += SCAN_POPCOUNT(newline);
+            *last_newline = i + SCAN_LAST(newline);
+        }
+        if (stop) {
+            *lines = count;
+            return i + SCAN_CTZ(stop);
+        }
+    }
+
+    size_t tail_lines, tail_last;
+    size_t tail = scalar_whitespace(p + i, n - i, &tail_lines, &tail_last);
+    if (tail_lines) *last_newline = i + tail_last;
+    *lines = count + tail_lines;
+    return i + tail;
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_ident(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned stop = ~sse2_ident_mask(_mm_loadu_si128((const __m128i*)(p + i))) & 0xFFFF;
+        if (stop) return i + SCAN_CTZ(stop);
+    }
+    return i + scalar_ident(p + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_number(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i ok = _mm_or_si128(sse2_range(x, '0', 10), _mm_cmpeq_epi8(x, _mm_set1_epi8('.')));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFF;
+        if (stop) return i + SCAN_CTZ(stop);
+    }
+    return i + scalar_number(p + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_string(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i end = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\n')));
+        unsigned stop = (unsigned)_mm_movemask_epi8(end);
+        if (stop) return i + SCAN_CTZ(stop);
+    }
+    return i + scalar_string(p + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t sse2_newlines(const char* p, size_t n) {
+    size_t i = 0;
+    size_t lines = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+        lines += SCAN_POPCOUNT((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))));
+    }
+    return lines + scalar_newlines(p + i, n - i);
+}
+
+static const ScanOps sse2_ops = {
+    "sse2", sse2_whitespace, sse2_ident, sse2_number, sse2_string, sse2_newlines,
+};
+
+// ################################################################
+// # AVX2
+// ################################################################
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_range(__m256i x, char lo, char len) {
+    __m256i shifted = _mm256_add_epi8(x, _mm256_set1_epi8((char)(128 - (unsigned char)lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + len)), shifted);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t avx2_whitespace(const char* p, size_t n, size_t* lines, size_t* last_newline) {
+    size_t i = 0;
+    size_t count = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i nl = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')), nl));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ws);
+        unsigned newline = (unsigned)_mm256_movemask_epi8(nl);
+        if (stop) newline &= (1u << SCAN_CTZ(stop)) - 1;
+        if (newline) {
+            count += SCAN_POPCOUNT(newline);
+            *last_newline = i + SCAN_LAST(newline);
+        }
+        if (stop) {
+            *lines = count;
+            return i + SCAN_CTZ(stop);
+        }
+    }
+
+    size_t tail_lines;
+    size_t tail = sse2_whitespace(p + i, n - i, &tail_lines, last_newline);
+    if (tail_lines) *last_newline += i;
+    *lines = count + tail_lines;
+    return i + tail;
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_ident(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i alpha = avx2_range(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 26);
+        __m256i digit = avx2_range(x, '0', 10);
+        __m256i under = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+        if (stop) return i + SCAN_CTZ(stop);
+    }
+    return i + sse2_ident(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_number(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i ok = _mm256_or_si256(avx2_range(x, '0', 10), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('.')));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (stop) return i + SCAN_CTZ(stop);
+    }
+    return i + sse2_number(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_string(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i end = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+        unsigned stop = (unsigned)_mm256_movemask_epi8(end);
+        if (stop) return i + SCAN_CTZ(stop);
+    }
+    return i + sse2_string(p + i, n - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t avx2_newlines(const char* p, size_t n) {
+    size_t i = 0;
+    size_t lines = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+        lines += SCAN_POPCOUNT((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'))));
+    }
+    return lines + sse2_newlines(p + i, n - i);
+}
+
+static const ScanOps avx2_ops = {
+    "avx2", avx2_whitespace, avx2_ident, avx2_number, avx2_string, avx2_newlines,
+};
+
+#endif
+
+static const ScanOps* select_scan_ops() {
+    const char* forced = getenv("NUUK_SCAN");
+    if (forced && strcmp(forced, "scalar") == 0) return &scalar_ops;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (forced && strcmp(forced, "sse2") == 0 && __builtin_cpu_supports("sse2")) return &sse2_ops;
+    if (__builtin_cpu_supports("avx2")) return &avx2_ops;
+    if (__builtin_cpu_supports("sse2")) return &sse2_ops;
+#endif
+    return &scalar_ops;
+}
+
+const ScanOps* scan_ops() {
+    // Every caller computes the same answer, so a racing first call is benign.
+    static const ScanOps* ops = NULL;
+    if (!ops) ops = select_scan_ops();
+    return ops;
+}
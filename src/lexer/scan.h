@@ -0,0 +1,28 @@
+#ifndef NUUK_SCAN_H
+#define NUUK_SCAN_H
+
+#include <stddef.h>
+
+// Character-class scanners used by the lexer's hot loops. Each one returns
+// how many bytes of p[0, n) belong to its class, starting at p[0]. They never
+// read past p + n, so they are safe on unterminated (e.g. mmap'd) buffers.
+typedef struct ScanOps {
+    const char* name;
+    // ' ', '\t', '\r', '\n'. Also reports the number of newlines skipped and
+    // the index of the last one (only meaningful if *lines > 0).
+    size_t (*whitespace)(const char* p, size_t n, size_t* lines, size_t* last_newline);
+    // [A-Za-z0-9_]
+    size_t (*ident)(const char* p, size_t n);
+    // [0-9.]
+    size_t (*number)(const char* p, size_t n);
+    // Anything but '"' and '\n'.
+    size_t (*string)(const char* p, size_t n);
+    // Counts '\n' in p[0, n).
+    size_t (*newlines)(const char* p, size_t n);
+} ScanOps;
+
+// Picks the widest implementation the CPU supports (AVX2, SSE2, scalar) on
+// first use. Set NUUK_SCAN=scalar|sse2|avx2 to force one.
+const ScanOps* scan_ops();
+
+#endif
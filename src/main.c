@@ -4,47 +4,170 @@
 #include <string.h>
 
 #include "E:\THE_LANGUAGE\src\lexer\lexer.h"
+#include "E:\THE_LANGUAGE\src\lexer\parallel.h"
 #include "E:\THE_LANGUAGE\src\parser\parser.h"
+#include "E:\THE_LANGUAGE\src\parser\parallel.h"
+#include "E:\THE_LANGUAGE\src\parser\fold.h"
 #include "E:\THE_LANGUAGE\src\parser\ast_printer.h"
+#include "E:\THE_LANGUAGE\src\parser\ast_cache.h"
+#include "E:\THE_LANGUAGE\src\utils\source.h"
+#include "E:\THE_LANGUAGE\src\module\module.h"
+#include "E:\THE_LANGUAGE\src\vm\compiler.h"
+#include "E:\THE_LANGUAGE\src\vm\vm.h"
 
 void eval(char* source);
+void eval_lexer(Lexer* lexer);
+void eval_parser(Parser* parser);
+void eval_unit(CompilationUnit* unit, const LineTable* lines);
+void eval_stream(FILE* stream);
 void repl();
 int ends_with(const char* str, const char* suffix);
 void read_file(const char* file_name);
+void read_modules(const char* file_name);
+void cache_unit(const char* cache, const Source* source, const CompilationUnit* unit);
+bool run_unit(const CompilationUnit* unit, const LineTable* lines);
 
 #define MAX_LENGTH 255
 
+// Number of lexer and parser threads for files (-j<N>, -j = one per CPU). 1
+// keeps the fused single-pass lexer/parser.
+static int lex_threads = 1;
+
+// --modules resolves imports and loads the whole program. Modules are looked
+// up next to their importer, then in every -I<dir> and in NUUK_PATH.
+static bool modules = false;
+static const char** include_dirs = NULL;
+static int include_count = 0;
+
+// Files are parsed through the on-disk AST cache unless --no-cache is given.
+static bool use_cache = true;
+
+// --run compiles files to bytecode and executes them instead of printing
+// their AST; --bytecode prints the compiled code. Either one needs the full
+// tree, so the AST cache is not read.
+static bool run = false;
+static bool print_bytecode = false;
+
+// --profile-ops prints how often each opcode and opcode pair ran, in debug
+// builds. The counters only see interpreted code, so it turns the JIT off.
+static bool profile_ops = false;
+
+// --runs=<n> runs each script n times, which makes it hot for the JIT after
+// the first runs; --no-jit keeps it in the interpreter, for comparison.
+static int runs = 1;
+static bool use_jit = true;
+
 int main(int argc, char** argv) {
-    switch (argc) {
-        case 1:
-            repl();
-            break;
-        case 2:
-            read_file(argv[1]);
-            break;
-        default:
-            fprintf(stderr, "Usage: ion run [path]\n");
+    const char* path = NULL;
+    include_dirs = (const char**)malloc(sizeof(const char*) * argc);
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-j", 2) == 0) {
+            lex_threads = argv[i][2] ? atoi(argv[i] + 2) : default_thread_count();
+            if (lex_threads < 1) lex_threads = 1;
+        } else if (strcmp(argv[i], "--modules") == 0) {
+            modules = true;
+        } else if (strcmp(argv[i], "--no-cache") == 0) {
+            use_cache = false;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = true;
+        } else if (strcmp(argv[i], "--bytecode") == 0) {
+            print_bytecode = true;
+        } else if (strcmp(argv[i], "--profile-ops") == 0) {
+            profile_ops = true;
+        } else if (strncmp(argv[i], "--runs=", 7) == 0) {
+            runs = atoi(argv[i] + 7);
+            if (runs < 1) runs = 1;
+        } else if (strcmp(argv[i], "--no-jit") == 0) {
+            use_jit = false;
+        } else if (strncmp(argv[i], "-I", 2) == 0 && argv[i][2]) {
+            include_dirs[include_count++] = argv[i] + 2;
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            fprintf(stderr, "Usage: ion run [-j<threads>] [--modules] [--no-cache] [--run] [--bytecode] [--profile-ops] [--runs=<n>] [--no-jit] [-I<dir>]... [path | -]\n");
             return 1;
+        }
     }
 
+    if (!path) repl();
+    else if (strcmp(path, "-") == 0) eval_stream(stdin);
+    else if (modules) read_modules(path);
+    else read_file(path);
+
+    free(include_dirs);
+
     return 0;
 }
 
 void eval(char* source) {
-    Lexer* lexer = create_lexer(source);
+    Lexer* lexer = create_lexer(source, strlen(source));
     TokenArray* tokens = tokenize(lexer);
 
-    for (int i = 0; i < tokens->size; i++) {
-        print_token(token_array_get(tokens, i));
+    for (size_t i = 0; i < tokens->size; i++) {
+        Token token = token_array_get(tokens, i);
+        print_token(&token);
     }
 
     Parser* parser = create_parser(tokens);
-    StmtArray stmts = parse(parser);
+    CompilationUnit unit = parse(parser);
+    fold_constants(&unit);
 
-    for (int i = 0; i < stmts.size; i++) {
-        dprint_stmt(stmts.elements[i]);
+    if (unit.diagnostics.size > 0) {
+        emit_diagnostics(&unit.diagnostics, parser->lines, stderr);
+    } else {
+        for (int i = 0; i < unit.stmts.size; i++) {
+            dprint_stmt(unit.stmts.elements[i]);
+        }
+        printf("Finished!\n");
+    }
+
+    free_compilation_unit(&unit);
+    free_parser(parser);
+    free_lexer(lexer);
+}
+
+// Lexes and parses in a single pass: the parser pulls tokens from the lexer
+// as it needs them, so no token array is ever built.
+void eval_lexer(Lexer* lexer) {
+    eval_parser(create_streaming_parser(lexer));
+}
+
+// Parses, prints the AST and frees both the tree and the parser.
+void eval_parser(Parser* parser) {
+    CompilationUnit unit = parse(parser);
+    fold_constants(&unit);
+    eval_unit(&unit, parser->lines);
+    free_parser(parser);
+}
+
+// Prints the AST, or compiles and runs it, and frees the unit. If the source
+// has syntax, compile or runtime errors, all of them are reported and the
+// process fails.
+void eval_unit(CompilationUnit* unit, const LineTable* lines) {
+    if (unit->diagnostics.size > 0) {
+        emit_diagnostics(&unit->diagnostics, lines, stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    if (run || print_bytecode) {
+        if (!run_unit(unit, lines)) exit(EXIT_FAILURE);
+        free_compilation_unit(unit);
+        return;
+    }
+
+    for (int i = 0; i < unit->stmts.size; i++) {
+        dprint_stmt(unit->stmts.elements[i]);
     }
     printf("Finished!\n");
+
+    free_compilation_unit(unit);
+}
+
+void eval_stream(FILE* stream) {
+    Lexer* lexer = create_stream_lexer(stream);
+    eval_lexer(lexer);
+    free_lexer(lexer);
 }
 
 void repl() {
@@ -74,26 +197,118 @@ void read_file(const char* file_name) {
         exit(1);
     }
 
-    FILE* file = fopen(file_name, "rb");
-    if (!file) {
+    Source* source = source_open(file_name);
+    if (!source) {
         fprintf(stderr, "Failed to open file %s\n", file_name);
         exit(EXIT_FAILURE);
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
+    // A cache hit maps the stored tree and skips lexing and parsing.
+    char* cache = use_cache ? ast_cache_directory() : NULL;
+    CachedAst cached;
+    if (cache && !run && !print_bytecode && ast_cache_load(cache, source->data, source->length, &cached)) {
+        dprint_flat_ast(&cached.ast);
+        printf("Finished!\n");
 
-    char* buffer = (char*)malloc(file_size + 1);
-    if (!buffer) {
-        fprintf(stderr, "Failed to allocate memory for file %s\n", file_name);
-        fclose(file);
+        ast_cache_release(&cached);
+        free(cache);
+        source_close(source);
+        return;
+    }
+
+    if (lex_threads > 1) {
+        ThreadPool* pool = create_thread_pool(lex_threads);
+        TokenArray tokens = tokenize_parallel(source->data, source->length, pool);
+        CompilationUnit unit = parse_parallel(&tokens, pool);
+        fold_constants(&unit);
+        free_thread_pool(pool);
+
+        cache_unit(cache, source, &unit);
+        eval_unit(&unit, &tokens.lines);
+        free_token_array(&tokens);
+    } else {
+        Lexer* lexer = create_lexer(source->data, source->length);
+        Parser* parser = create_streaming_parser(lexer);
+        CompilationUnit unit = parse(parser);
+        fold_constants(&unit);
+
+        cache_unit(cache, source, &unit);
+        eval_unit(&unit, parser->lines);
+        free_parser(parser);
+        free_lexer(lexer);
+    }
+    free(cache);
+    source_close(source);
+}
+
+// Stores a successfully parsed unit in the AST cache, if there is one.
+void cache_unit(const char* cache, const Source* source, const CompilationUnit* unit) {
+    if (!cache || unit->diagnostics.size > 0) return;
+
+    FlatAst ast = flatten_ast(unit);
+    ast_cache_store(cache, source->data, source->length, &ast);
+    free_flat_ast(&ast);
+}
+
+// Compiles `unit` and, with --run, executes it --runs times. Returns false after
+// reporting compile or runtime errors.
+bool run_unit(const CompilationUnit* unit, const LineTable* lines) {
+    Diagnostics diagnostics = create_diagnostics();
+    Function* script = compile_unit(unit, &diagnostics, true);
+    if (!script) {
+        emit_diagnostics(&diagnostics, lines, stderr);
+        free_diagnostics(&diagnostics);
+        return false;
+    }
+    free_diagnostics(&diagnostics);
+
+    if (print_bytecode) dprint_function(script);
+
+    bool ok = true;
+    if (run) {
+        VM* vm = create_vm();
+        vm->jit = vm->jit && use_jit && !profile_ops;
+        for (int i = 0; i < runs && ok; i++) ok = vm_run(vm, script, NULL);
+        if (!ok) emit_diagnostics(&vm->errors, lines, stderr);
+        if (profile_ops) vm_print_profile(vm, stderr);
+        free_vm(vm);
+    }
+    free_function(script);
+    return ok;
+}
+
+// Loads `file_name` and every module it imports, then prints (or runs) the
+// modules in dependency order, each after all of its imports.
+void read_modules(const char* file_name) {
+    if (!ends_with(file_name, ".tx")) {
+        fprintf(stderr, "File %s has Incorrect extension.\n", file_name);
+        exit(1);
+    }
+
+    ThreadPool* pool = create_thread_pool(lex_threads);
+    ModuleGraph* graph = create_module_graph(pool);
+    for (int i = 0; i < include_count; i++) module_graph_add_search_path(graph, include_dirs[i]);
+    module_graph_add_search_list(graph, getenv("NUUK_PATH"));
+
+    if (!load_modules(graph, file_name)) {
+        fprintf(stderr, "Failed to open file %s\n", file_name);
         exit(EXIT_FAILURE);
     }
+    if (emit_module_diagnostics(graph, stderr) > 0) exit(EXIT_FAILURE);
 
-    fread(buffer, 1, file_size, file);
-    buffer[file_size] = '\0';
+    for (size_t i = 0; i < graph->size; i++) {
+        Module* module = graph->modules[graph->order[i]];
+        if (run || print_bytecode) {
+            if (!run_unit(&module->unit, &module->lexer->tokens.lines)) exit(EXIT_FAILURE);
+            continue;
+        }
+        printf("MODULE %s\n", atom_name(module->path));
+        for (int j = 0; j < module->unit.stmts.size; j++) {
+            dprint_stmt(module->unit.stmts.elements[j]);
+        }
+    }
+    if (!run && !print_bytecode) printf("Finished!\n");
 
-    fclose(file);
-    eval(buffer);
-}
\ No newline at end of file
+    free_module_graph(graph);
+    free_thread_pool(pool);
+}
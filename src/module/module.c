@@ -0,0 +1,367 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include "module.h"
+#include "E:\THE_LANGUAGE\src\parser\fold.h"
+
+#include <limits.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define MODULE_LIST_SEPARATOR ';'
+#else
+#define MODULE_LIST_SEPARATOR ':'
+#endif
+
+#define MODULE_INITIAL_SLOTS 64
+
+static void* module_alloc(size_t size) {
+    void* memory = calloc(1, size);
+    if (!memory) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate module graph.\n");
+        exit(EXIT_FAILURE);
+    }
+    return memory;
+}
+
+// Resolves `path` to an absolute path without '.', '..' or links, so every
+// spelling of a file maps to one module. Fails if the file does not exist.
+static bool canonical_path(const char* path, char* buffer) {
+#ifdef _WIN32
+    return _fullpath(buffer, path, MODULE_PATH_MAX) && _access(buffer, 0) == 0;
+#else
+    char resolved[PATH_MAX];
+    if (!realpath(path, resolved) || strlen(resolved) >= MODULE_PATH_MAX) return false;
+    strcpy(buffer, resolved);
+    return true;
+#endif
+}
+
+ModuleGraph* create_module_graph(ThreadPool* pool) {
+    ModuleGraph* graph = (ModuleGraph*)module_alloc(sizeof(ModuleGraph));
+    graph->pool = pool;
+    graph->slots = MODULE_INITIAL_SLOTS;
+    graph->keys = (Atom*)module_alloc(graph->slots * sizeof(Atom));
+    graph->values = (size_t*)module_alloc(graph->slots * sizeof(size_t));
+    return graph;
+}
+
+void module_graph_add_search_path(ModuleGraph* graph, const char* directory) {
+    size_t length = strlen(directory);
+    while (length > 1 && (directory[length - 1] == '/' || directory[length - 1] == '\\')) length--;
+
+    char* copy = (char*)module_alloc(length + 1);
+    memcpy(copy, directory, length);
+
+    char** grown = (char**)realloc(graph->search_path, (graph->search_size + 1) * sizeof(char*));
+    if (!grown) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate module graph.\n");
+        exit(EXIT_FAILURE);
+    }
+    graph->search_path = grown;
+    graph->search_path[graph->search_size++] = copy;
+}
+
+// Adds every directory of a NUUK_PATH style list (':' separated, ';' on
+// Windows).
+void module_graph_add_search_list(ModuleGraph* graph, const char* list) {
+    char directory[MODULE_PATH_MAX];
+    while (list && *list) {
+        const char* end = strchr(list, MODULE_LIST_SEPARATOR);
+        size_t length = end ? (size_t)(end - list) : strlen(list);
+        if (length > 0 && length < sizeof(directory)) {
+            memcpy(directory, list, length);
+            directory[length] = '\0';
+            module_graph_add_search_path(graph, directory);
+        }
+        list = end ? end + 1 : NULL;
+    }
+}
+
+// Open addressing from a module's path atom to its index in `modules`.
+static void module_graph_rehash(ModuleGraph* graph) {
+    size_t slots = graph->slots * 2;
+    Atom* keys = (Atom*)module_alloc(slots * sizeof(Atom));
+    size_t* values = (size_t*)module_alloc(slots * sizeof(size_t));
+
+    for (size_t i = 0; i < graph->slots; i++) {
+        if (graph->keys[i] == NO_ATOM) continue;
+        size_t slot = graph->keys[i] & (slots - 1);
+        while (keys[slot] != NO_ATOM) slot = (slot + 1) & (slots - 1);
+        keys[slot] = graph->keys[i];
+        values[slot] = graph->values[i];
+    }
+
+    free(graph->keys);
+    free(graph->values);
+    graph->keys = keys;
+    graph->values = values;
+    graph->slots = slots;
+}
+
+// Returns the index of the module at `path`, appending a new, not yet loaded
+// one if there is none.
+static size_t module_graph_intern(ModuleGraph* graph, Atom path) {
+    size_t slot = path & (graph->slots - 1);
+    while (graph->keys[slot] != NO_ATOM) {
+        if (graph->keys[slot] == path) return graph->values[slot];
+        slot = (slot + 1) & (graph->slots - 1);
+    }
+
+    if (graph->size == graph->capacity) {
+        graph->capacity = graph->capacity ? graph->capacity * 2 : 16;
+        Module** grown = (Module**)realloc(graph->modules, graph->capacity * sizeof(Module*));
+        if (!grown) {
+            fprintf(stderr, "FATAL ERROR: Failed to allocate module graph.\n");
+            exit(EXIT_FAILURE);
+        }
+        graph->modules = grown;
+    }
+
+    Module* module = (Module*)module_alloc(sizeof(Module));
+    module->path = path;
+    module->graph = graph;
+    module->unit.diagnostics = create_diagnostics();
+
+    size_t index = graph->size++;
+    graph->modules[index] = module;
+    graph->keys[slot] = path;
+    graph->values[slot] = index;
+    if (graph->size * 2 > graph->slots) module_graph_rehash(graph);
+    return index;
+}
+
+// Writes the dotted name `a.b.c` of an import into `name`, or returns false
+// if the imported expression is not a name.
+static bool module_name(Expr* expr, char* name, size_t capacity, size_t* length) {
+    Token* token;
+    if (expr->type == EXPR_VARIABLE) {
+        token = &((Variable*)expr)->name;
+    } else if (expr->type == EXPR_GET) {
+        Get* get = (Get*)expr;
+        if (!module_name(get->expr, name, capacity, length) || *length + 1 >= capacity) return false;
+        name[(*length)++] = '.';
+        token = &get->property;
+    } else {
+        return false;
+    }
+
+    size_t size = token_length(token);
+    if (*length + size >= capacity) return false;
+    memcpy(name + *length, token_lexeme(token), size);
+    *length += size;
+    name[*length] = '\0';
+    return true;
+}
+
+// Where an expression starts in `source`, for diagnostics.
+static uint32_t expr_offset(Expr* expr, const Source* source) {
+    switch (expr->type) {
+        case EXPR_VARIABLE: return ((Variable*)expr)->name.offset;
+        case EXPR_ASSIGN: return ((Assign*)expr)->name.offset;
+        case EXPR_UNARY: return ((Unary*)expr)->op.offset;
+        case EXPR_GET: return expr_offset(((Get*)expr)->expr, source);
+        case EXPR_CALL: return expr_offset(((Call*)expr)->callee, source);
+        case EXPR_BINARY: return expr_offset(((Binary*)expr)->lhs, source);
+        case EXPR_LOGICAL: return expr_offset(((Logical*)expr)->lhs, source);
+        case EXPR_GROUPING: return expr_offset(((Grouping*)expr)->expr, source);
+        case EXPR_LITERAL: {
+            const char* value = ((Literal*)expr)->value;
+            if (value >= source->data && value < source->data + source->length) return (uint32_t)(value - source->data);
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Looks for `name` (with '.' read as a directory separator) next to the
+// importing module, then along the search path.
+static Atom resolve_module(const Module* importer, const char* name) {
+    const ModuleGraph* graph = importer->graph;
+    char relative[MODULE_PATH_MAX];
+    char candidate[MODULE_PATH_MAX];
+    char resolved[MODULE_PATH_MAX];
+
+    size_t length = strlen(name);
+    for (size_t i = 0; i <= length; i++) relative[i] = name[i] == '.' ? '/' : name[i];
+
+    const char* importer_path = atom_name(importer->path);
+    const char* slash = strrchr(importer_path, '/');
+#ifdef _WIN32
+    const char* backslash = strrchr(importer_path, '\\');
+    if (backslash > slash) slash = backslash;
+#endif
+    int directory = slash ? (int)(slash - importer_path) : 0;
+
+    for (size_t i = 0; i <= graph->search_size; i++) {
+        int written = i == 0
+            ? snprintf(candidate, sizeof(candidate), "%.*s/%s" MODULE_EXTENSION, directory, importer_path, relative)
+            : snprintf(candidate, sizeof(candidate), "%s/%s" MODULE_EXTENSION, graph->search_path[i - 1], relative);
+        if (written < 0 || (size_t)written >= sizeof(candidate)) continue;
+        if (canonical_path(candidate, resolved)) return intern_cstr(resolved);
+    }
+    return NO_ATOM;
+}
+
+static void module_add_import(Module* module, Atom name, Atom path, uint32_t offset) {
+    if (module->import_count == module->import_capacity) {
+        size_t capacity = module->import_capacity ? module->import_capacity * 2 : 4;
+        module->imports = (size_t*)realloc(module->imports, capacity * sizeof(size_t));
+        module->import_names = (Atom*)realloc(module->import_names, capacity * sizeof(Atom));
+        module->import_paths = (Atom*)realloc(module->import_paths, capacity * sizeof(Atom));
+        module->import_offsets = (uint32_t*)realloc(module->import_offsets, capacity * sizeof(uint32_t));
+        if (!module->imports || !module->import_names || !module->import_paths || !module->import_offsets) {
+            fprintf(stderr, "FATAL ERROR: Failed to allocate module imports.\n");
+            exit(EXIT_FAILURE);
+        }
+        module->import_capacity = capacity;
+    }
+    module->import_names[module->import_count] = name;
+    module->import_paths[module->import_count] = path;
+    module->import_offsets[module->import_count] = offset;
+    module->import_count++;
+}
+
+// Pool task: reads, lexes and parses one module and resolves the paths of
+// its top-level imports. Only the module itself is written, and the graph
+// is only read, so all modules of a wave run at the same time.
+static void load_module(void* arg) {
+    Module* module = (Module*)arg;
+    const char* path = atom_name(module->path);
+
+    module->source = source_open(path);
+    if (!module->source) {
+        fprintf(stderr, "Failed to open file %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    module->lexer = create_lexer(module->source->data, module->source->length);
+    Parser* parser = create_streaming_parser(module->lexer);
+    module->unit = parse(parser);
+    free_parser(parser);
+
+    char name[MODULE_PATH_MAX];
+    for (int i = 0; i < module->unit.stmts.size; i++) {
+        Stmt* stmt = module->unit.stmts.elements[i];
+        if (stmt->type != STMT_IMPORT) continue;
+
+        Expr* value = ((Import*)stmt)->value;
+        uint32_t offset = expr_offset(value, module->source);
+        size_t length = 0;
+        if (!module_name(value, name, sizeof(name), &length)) {
+            diagnostics_add(&module->unit.diagnostics, offset, "Expected a module name after 'import'.");
+            continue;
+        }
+
+        Atom resolved = resolve_module(module, name);
+        if (resolved == NO_ATOM) {
+            diagnostics_add(&module->unit.diagnostics, offset, "Cannot find module '%s'.", name);
+            continue;
+        }
+        module_add_import(module, intern(name, length), resolved, offset);
+    }
+
+    // Import names are read from the source text, so fold only afterwards.
+    fold_constants(&module->unit);
+}
+
+// Computes `level` by depth-first search. An import that leads back to a
+// module still being visited closes a cycle; it is reported and ignored.
+static void module_level(ModuleGraph* graph, Module* module) {
+    module->state = 1;
+    module->level = 0;
+
+    for (size_t i = 0; i < module->import_count; i++) {
+        Module* import = graph->modules[module->imports[i]];
+        if (import->state == 1) {
+            diagnostics_add(&module->unit.diagnostics, module->import_offsets[i], "Import of '%s' forms a cycle.", atom_name(module->import_names[i]));
+            continue;
+        }
+        if (import->state == 0) module_level(graph, import);
+        if (import->level + 1 > module->level) module->level = import->level + 1;
+    }
+
+    module->state = 2;
+}
+
+static void order_modules(ModuleGraph* graph) {
+    size_t levels = 0;
+    for (size_t i = 0; i < graph->size; i++) graph->modules[i]->state = 0;
+    for (size_t i = 0; i < graph->size; i++) {
+        if (graph->modules[i]->state == 0) module_level(graph, graph->modules[i]);
+        if (graph->modules[i]->level + 1 > levels) levels = graph->modules[i]->level + 1;
+    }
+
+    // Counting sort by level; ties keep the order of discovery.
+    size_t* starts = (size_t*)module_alloc((levels + 1) * sizeof(size_t));
+    for (size_t i = 0; i < graph->size; i++) starts[graph->modules[i]->level + 1]++;
+    for (size_t level = 1; level <= levels; level++) starts[level] += starts[level - 1];
+
+    free(graph->order);
+    graph->order = (size_t*)module_alloc(graph->size * sizeof(size_t));
+    for (size_t i = 0; i < graph->size; i++) graph->order[starts[graph->modules[i]->level]++] = i;
+    free(starts);
+}
+
+Module* load_modules(ModuleGraph* graph, const char* path) {
+    char resolved[MODULE_PATH_MAX];
+    if (!canonical_path(path, resolved)) return NULL;
+
+    size_t begin = graph->size;
+    size_t root = module_graph_intern(graph, intern_cstr(resolved));
+
+    // Modules are appended as they are first imported, so each wave is the
+    // tail of `modules` that the previous wave added.
+    while (begin < graph->size) {
+        size_t end = graph->size;
+        for (size_t i = begin; i < end; i++) thread_pool_submit(graph->pool, load_module, graph->modules[i]);
+        thread_pool_wait(graph->pool);
+
+        for (size_t i = begin; i < end; i++) {
+            Module* module = graph->modules[i];
+            for (size_t j = 0; j < module->import_count; j++) {
+                module->imports[j] = module_graph_intern(graph, module->import_paths[j]);
+            }
+        }
+        begin = end;
+    }
+
+    order_modules(graph);
+    return graph->modules[root];
+}
+
+size_t emit_module_diagnostics(ModuleGraph* graph, FILE* out) {
+    size_t errors = 0;
+    for (size_t i = 0; i < graph->size; i++) {
+        Module* module = graph->modules[i];
+        if (module->unit.diagnostics.size == 0) continue;
+
+        fprintf(out, "%s:\n", atom_name(module->path));
+        emit_diagnostics(&module->unit.diagnostics, &module->lexer->tokens.lines, out);
+        errors += module->unit.diagnostics.size;
+    }
+    return errors;
+}
+
+void free_module_graph(ModuleGraph* graph) {
+    for (size_t i = 0; i < graph->size; i++) {
+        Module* module = graph->modules[i];
+        free_compilation_unit(&module->unit);
+        if (module->lexer) free_lexer(module->lexer);
+        if (module->source) source_close(module->source);
+        free(module->imports);
+        free(module->import_names);
+        free(module->import_paths);
+        free(module->import_offsets);
+        free(module);
+    }
+    for (size_t i = 0; i < graph->search_size; i++) free(graph->search_path[i]);
+
+    free(graph->search_path);
+    free(graph->modules);
+    free(graph->keys);
+    free(graph->values);
+    free(graph->order);
+    free(graph);
+}
@@ -0,0 +1,73 @@
+#ifndef NUUK_MODULE_H
+#define NUUK_MODULE_H
+
+#include "E:\THE_LANGUAGE\src\parser\parser.h"
+#include "E:\THE_LANGUAGE\src\utils\pool.h"
+#include "E:\THE_LANGUAGE\src\utils\source.h"
+#include <stdbool.h>
+
+#define MODULE_EXTENSION ".tx"
+#define MODULE_PATH_MAX 4096
+
+// One source file of a program. `path` is the interned canonical path, which
+// identifies the module: however many modules import it, and under whatever
+// name, it is read and parsed once. `lexer` is kept for the line table of
+// the source that diagnostics are resolved against.
+//
+// `imports` are the graph indices of the modules named by its top-level
+// import statements, with `import_names` (the dotted name) and
+// `import_offsets` (where the statement is) alongside. `level` is 0 for a
+// module without imports and one more than its deepest import otherwise, so
+// all modules of one level can be processed in parallel once the levels
+// below are done.
+typedef struct Module {
+    Atom path;
+    Source* source;
+    Lexer* lexer;
+    CompilationUnit unit;
+
+    size_t* imports;
+    Atom* import_names;
+    Atom* import_paths;
+    uint32_t* import_offsets;
+    size_t import_count;
+    size_t import_capacity;
+
+    size_t level;
+    int state;
+    const struct ModuleGraph* graph;
+} Module;
+
+// Every module reachable from a root, loaded in waves: a wave holds the
+// modules first imported by the previous one, and all modules of a wave are
+// lexed and parsed in parallel on `pool`. `order` lists the module indices
+// by level, i.e. every module after the ones it imports.
+typedef struct ModuleGraph {
+    Module** modules;
+    size_t size;
+    size_t capacity;
+
+    Atom* keys;
+    size_t* values;
+    size_t slots;
+
+    char** search_path;
+    size_t search_size;
+
+    size_t* order;
+    ThreadPool* pool;
+} ModuleGraph;
+
+ModuleGraph* create_module_graph(ThreadPool* pool);
+// Directories searched, in order, after the importing module's own one.
+void module_graph_add_search_path(ModuleGraph* graph, const char* directory);
+void module_graph_add_search_list(ModuleGraph* graph, const char* list);
+// Loads `path` and everything it imports. Returns the root module, or NULL
+// if `path` cannot be opened.
+Module* load_modules(ModuleGraph* graph, const char* path);
+// Prints the diagnostics of every module, each group headed by its path.
+// Returns the number of errors.
+size_t emit_module_diagnostics(ModuleGraph* graph, FILE* out);
+void free_module_graph(ModuleGraph* graph);
+
+#endif
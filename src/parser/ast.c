@@ -1,16 +1,20 @@
 
 #include "ast.h"
 
-StmtArray create_stmt_array(int capacity) {
+#include <pthread.h>
+
+StmtArray create_stmt_array(Arena* arena, int capacity) {
     StmtArray array;
-    array.elements = (Stmt**)malloc(sizeof(Stmt*) * capacity);
+    array.elements = (Stmt**)arena_alloc(arena, sizeof(Stmt*) * capacity);
     array.capacity = capacity;
     array.size = 0;
 
     return array;
 }
 
-void stmt_array_add(StmtArray* array, Stmt* stmt) {
+// Arrays grow by moving to a bigger arena allocation; the old one is simply
+// abandoned until the arena goes away.
+void stmt_array_add(Arena* arena, StmtArray* array, Stmt* stmt) {
     if (!array || !stmt) {
         fprintf(stderr, "FATAL ERROR: Invalid array or stmt passed to stmt_array_add.\n");
         return;
@@ -18,36 +22,24 @@ void stmt_array_add(StmtArray* array, Stmt* stmt) {
 
     if (array->size >= array->capacity) {
         array->capacity *= 2;
-        array->elements = realloc(array->elements, array->capacity * sizeof(Stmt*));
-        if (!array->elements) {
-            fprintf(stderr, "FATAL ERROR: Failed to resize stmt array.\n");
-            exit(EXIT_FAILURE);
-        }
+        Stmt** elements = (Stmt**)arena_alloc(arena, array->capacity * sizeof(Stmt*));
+        memcpy(elements, array->elements, array->size * sizeof(Stmt*));
+        array->elements = elements;
     }
 
     array->elements[array->size++] = stmt;
 }
 
-void free_stmt_array(StmtArray* array) {
-    if (!array) return;
-
-    for (int i = 0; i < array->size; i++) {
-        free(array->elements[i]);
-    }
-    free(array->elements);
-    free(array);
-}
-
-ExprArray create_expr_array(int capacity) {
+ExprArray create_expr_array(Arena* arena, int capacity) {
     ExprArray array;
-    array.elements = (Expr**)malloc(sizeof(Expr*) * capacity);
+    array.elements = (Expr**)arena_alloc(arena, sizeof(Expr*) * capacity);
     array.capacity = capacity;
     array.size = 0;
 
     return array;
 }
 
-void expr_array_add(ExprArray* array, Expr* expr) {
+void expr_array_add(Arena* arena, ExprArray* array, Expr* expr) {
     if (!array || !expr) {
         fprintf(stderr, "FATAL ERROR: Invalid array or expr passed to expr_array_add.\n");
         return;
@@ -55,24 +47,14 @@ void expr_array_add(ExprArray* array, Expr* expr) {
 
     if (array->size >= array->capacity) {
         array->capacity *= 2;
-        array->elements = realloc(array->elements, array->capacity * sizeof(Expr*));
-        if (!array->elements) {
-            fprintf(stderr, "FATAL ERROR: Failed to resize expr array.\n");
-            exit(EXIT_FAILURE);
-        }
+        Expr** elements = (Expr**)arena_alloc(arena, array->capacity * sizeof(Expr*));
+        memcpy(elements, array->elements, array->size * sizeof(Expr*));
+        array->elements = elements;
     }
 
     array->elements[array->size++] = expr;    
 }
 
-void free_expr_array(ExprArray* array) {
-    for (int i = 0; i < array->size; i++) {
-        free(array->elements[i]);
-    }
-    free(array->elements);
-    free(array);
-}
-
 const char* id(Stmt* stmt) {
     switch (stmt->type) {
         case STMT_EXPRESSION:
@@ -82,51 +64,221 @@ const char* id(Stmt* stmt) {
     }
 }
 
-Datatype* basic_type(const char* name) {
-    BasicType* basic_type = (BasicType*)malloc(sizeof(BasicType));
-    if (!basic_type) {
-        fprintf(stderr, "ERROR: Failed to allocate memory for BasicType!\n");
-        exit(1);
+// The canonical type table: open addressing with linear probing over the
+// shallow structure of each type, guarded by one lock like the intern table.
+// Types are allocated from a process-wide arena and never move.
+#define TYPE_INITIAL_SLOTS 256
+
+// The structure of a type with its children already canonical. Unused
+// fields are zero.
+typedef struct TypeKey {
+    Typeid type;
+    Atom name;
+    Datatype* inner;
+    size_t size;
+    Datatype** types;
+} TypeKey;
+
+typedef struct TypeSlot {
+    uint32_t hash;
+    Datatype* type;
+} TypeSlot;
+
+static pthread_mutex_t type_lock = PTHREAD_MUTEX_INITIALIZER;
+static TypeSlot* type_slots = NULL;
+static size_t type_capacity = 0;
+static size_t type_count = 0;
+static Arena* type_arena = NULL;
+
+static TypeKey type_key(const Datatype* type) {
+    TypeKey key = { type->type, NO_ATOM, NULL, 0, NULL };
+    switch (type->type) {
+        case TYPEID_BASIC:
+            key.name = ((BasicType*)type)->name;
+            break;
+        case TYPEID_POINTER: case TYPEID_SHARED_POINTER: case TYPEID_UNIQUE_POINTER:
+            key.inner = ((Pointer*)type)->type;
+            break;
+        case TYPEID_GENERIC:
+            key.inner = ((Generic*)type)->type;
+            break;
+        case TYPEID_ARRAY:
+            key.inner = ((Array*)type)->type;
+            key.size = ((Array*)type)->array_size;
+            break;
+        case TYPEID_TUPLE:
+            key.size = ((Tuple*)type)->count;
+            key.types = ((Tuple*)type)->types;
+            break;
     }
-    basic_type->base.type = TYPEID_BASIC;
-    basic_type->name = strdup(name);
+    return key;
+}
 
-    return (Datatype*)basic_type;
+static uint64_t mix(uint64_t h, uint64_t value) {
+    h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+static uint32_t hash_type_key(const TypeKey* key) {
+    uint64_t h = mix(key->type, key->name);
+    h = mix(h, (uintptr_t)key->inner);
+    h = mix(h, key->size);
+    if (key->types) {
+        for (size_t i = 0; i < key->size; i++) h = mix(h, (uintptr_t)key->types[i]);
+    }
+    h *= 0xff51afd7ed558ccdull;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static bool type_key_equals(const TypeKey* a, const TypeKey* b) {
+    if (a->type != b->type || a->name != b->name || a->inner != b->inner || a->size != b->size) return false;
+    return !a->types || memcmp(a->types, b->types, a->size * sizeof(Datatype*)) == 0;
+}
+
+static Datatype* allocate_type(const TypeKey* key) {
+    Datatype* type;
+    switch (key->type) {
+        case TYPEID_BASIC: {
+            BasicType* basic = (BasicType*)arena_alloc(type_arena, sizeof(BasicType));
+            basic->name = key->name;
+            type = (Datatype*)basic;
+            break;
+        }
+        case TYPEID_POINTER: case TYPEID_SHARED_POINTER: case TYPEID_UNIQUE_POINTER: {
+            Pointer* ptr = (Pointer*)arena_alloc(type_arena, sizeof(Pointer));
+            ptr->type = key->inner;
+            type = (Datatype*)ptr;
+            break;
+        }
+        case TYPEID_GENERIC: {
+            Generic* generic = (Generic*)arena_alloc(type_arena, sizeof(Generic));
+            generic->type = key->inner;
+            type = (Datatype*)generic;
+            break;
+        }
+        case TYPEID_ARRAY: {
+            Array* array = (Array*)arena_alloc(type_arena, sizeof(Array));
+            array->array_size = key->size;
+            array->type = key->inner;
+            type = (Datatype*)array;
+            break;
+        }
+        case TYPEID_TUPLE: {
+            Tuple* tuple = (Tuple*)arena_alloc(type_arena, sizeof(Tuple));
+            tuple->count = key->size;
+            tuple->types = (Datatype**)arena_alloc(type_arena, key->size * sizeof(Datatype*));
+            memcpy(tuple->types, key->types, key->size * sizeof(Datatype*));
+            type = (Datatype*)tuple;
+            break;
+        }
+        default:
+            fprintf(stderr, "FATAL ERROR: Unknown datatype %d.\n", key->type);
+            exit(EXIT_FAILURE);
+    }
+    type->type = key->type;
+    return type;
+}
+
+static void grow_type_slots() {
+    size_t capacity = type_capacity ? type_capacity * 2 : TYPE_INITIAL_SLOTS;
+    TypeSlot* grown = (TypeSlot*)calloc(capacity, sizeof(TypeSlot));
+    if (!grown) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow datatype table.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < type_capacity; i++) {
+        if (!type_slots[i].type) continue;
+        size_t index = type_slots[i].hash & (capacity - 1);
+        while (grown[index].type) index = (index + 1) & (capacity - 1);
+        grown[index] = type_slots[i];
+    }
+
+    free(type_slots);
+    type_slots = grown;
+    type_capacity = capacity;
+}
+
+static Datatype* intern_type(const TypeKey* key) {
+    uint32_t hash = hash_type_key(key);
+
+    pthread_mutex_lock(&type_lock);
+    if (!type_slots) {
+        grow_type_slots();
+        type_arena = create_arena(0);
+    }
+
+    size_t mask = type_capacity - 1;
+    size_t index = hash & mask;
+    while (type_slots[index].type) {
+        if (type_slots[index].hash == hash) {
+            TypeKey other = type_key(type_slots[index].type);
+            if (type_key_equals(key, &other)) {
+                Datatype* type = type_slots[index].type;
+                pthread_mutex_unlock(&type_lock);
+                return type;
+            }
+        }
+        index = (index + 1) & mask;
+    }
+
+    Datatype* type = allocate_type(key);
+    type_slots[index].hash = hash;
+    type_slots[index].type = type;
+
+    // Keep the load factor at or below 1/2.
+    if (++type_count * 2 > type_capacity) grow_type_slots();
+
+    pthread_mutex_unlock(&type_lock);
+    return type;
+}
+
+Datatype* basic_type(Atom name) {
+    TypeKey key = { TYPEID_BASIC, name, NULL, 0, NULL };
+    return intern_type(&key);
 }
 
 Datatype* pointer(Datatype* type) {
-    Pointer* ptr = (Pointer*)malloc(sizeof(Pointer));
-    ptr->base.type = TYPEID_POINTER;
-    ptr->type = type;
+    TypeKey key = { TYPEID_POINTER, NO_ATOM, type, 0, NULL };
+    return intern_type(&key);
+}
 
-    return (Datatype*)ptr;
+Datatype* shared_pointer(Datatype* type) {
+    TypeKey key = { TYPEID_SHARED_POINTER, NO_ATOM, type, 0, NULL };
+    return intern_type(&key);
 }
 
-Datatype* generic(Datatype* type) {
-    fprintf(stderr, "TODO\n");
-    exit(1);
+Datatype* unique_pointer(Datatype* type) {
+    TypeKey key = { TYPEID_UNIQUE_POINTER, NO_ATOM, type, 0, NULL };
+    return intern_type(&key);
 }
 
-Datatype* array(size_t array_size, Datatype** types) {
-    Array* array = (Array*)malloc(sizeof(Array));
-    array->base.type = TYPEID_ARRAY;
-    array->array_size = array_size;
-    array->types = types;
+Datatype* generic(Datatype* type) {
+    TypeKey key = { TYPEID_GENERIC, NO_ATOM, type, 0, NULL };
+    return intern_type(&key);
+}
 
-    return (Datatype*)array;
+Datatype* array(size_t array_size, Datatype* type) {
+    TypeKey key = { TYPEID_ARRAY, NO_ATOM, type, array_size, NULL };
+    return intern_type(&key);
 }
 
-Datatype* tuple(Datatype** types) {
-    Tuple* tuple = (Tuple*)malloc(sizeof(Tuple));
-    tuple->base.type = TYPEID_TUPLE;
-    tuple->types = types;
+Datatype* tuple(Datatype** types, size_t count) {
+    TypeKey key = { TYPEID_TUPLE, NO_ATOM, NULL, count, types };
+    return intern_type(&key);
+}
 
-    return (Datatype*)tuple;
+size_t datatype_count() {
+    pthread_mutex_lock(&type_lock);
+    size_t count = type_count;
+    pthread_mutex_unlock(&type_lock);
+    return count;
 }
 
-VariableDecl* create_variable_stmt(bool mutability, Datatype* type, Token* name, Expr* value) {
-    VariableDecl* var = (VariableDecl*)malloc(sizeof(VariableDecl));
+VariableDecl* create_variable_stmt(Arena* arena, bool mutability, Datatype* type, Token name, Expr* value) {
+    VariableDecl* var = (VariableDecl*)arena_alloc(arena, sizeof(VariableDecl));
     var->base.type = STMT_VAR;
+    var->base.range = (TokenRange){ 0, 0 };
     var->mutability = mutability;
     var->type = type;
     var->name = name;
@@ -135,9 +287,10 @@ VariableDecl* create_variable_stmt(bool mutability, Datatype* type, Token* name,
     return var;
 }
 
-Binary* create_binary(Expr* lhs, Token op, Expr* rhs) {
-    Binary* binary = (Binary*)malloc(sizeof(Binary));
+Binary* create_binary(Arena* arena, Expr* lhs, Token op, Expr* rhs) {
+    Binary* binary = (Binary*)arena_alloc(arena, sizeof(Binary));
     binary->base.type = EXPR_BINARY;
+    binary->base.range = (TokenRange){ 0, 0 };
     binary->base.accept = binary_accept;
 
     binary->lhs = lhs;
@@ -147,9 +300,10 @@ Binary* create_binary(Expr* lhs, Token op, Expr* rhs) {
     return binary;
 }
 
-Grouping* create_grouping(Expr* expr) {
-    Grouping* grouping = (Grouping*)malloc(sizeof(Grouping));
+Grouping* create_grouping(Arena* arena, Expr* expr) {
+    Grouping* grouping = (Grouping*)arena_alloc(arena, sizeof(Grouping));
     grouping->base.type = EXPR_GROUPING;
+    grouping->base.range = (TokenRange){ 0, 0 };
     grouping->base.accept = grouping_accept;
 
     grouping->expr = expr;
@@ -157,19 +311,25 @@ Grouping* create_grouping(Expr* expr) {
     return grouping;
 }
 
-Literal* create_literal(const char* value) {
-    Literal* literal = (Literal*)malloc(sizeof(Literal));
+Literal* create_literal(Arena* arena, LiteralKind kind, const char* value, size_t length) {
+    Literal* literal = (Literal*)arena_alloc(arena, sizeof(Literal));
     literal->base.type = EXPR_LITERAL;
+    literal->base.range = (TokenRange){ 0, 0 };
     literal->base.accept = literal_accept;
 
     literal->value = value;
+    literal->length = length;
+    literal->kind = kind;
+    literal->offset = 0;
+    literal->as.integer = 0;
 
     return literal;
 }
 
-Logical* create_logical(Expr* lhs, Token op, Expr* rhs) {
-    Logical* logical = (Logical*)malloc(sizeof(Logical));
+Logical* create_logical(Arena* arena, Expr* lhs, Token op, Expr* rhs) {
+    Logical* logical = (Logical*)arena_alloc(arena, sizeof(Logical));
     logical->base.type = EXPR_LOGICAL;
+    logical->base.range = (TokenRange){ 0, 0 };
     logical->base.accept = logical_accept;
 
     logical->lhs = lhs;
@@ -179,9 +339,10 @@ Logical* create_logical(Expr* lhs, Token op, Expr* rhs) {
     return logical;
 }
 
-Unary* create_unary(Token op, Expr* rhs) {
-    Unary* unary = (Unary*)malloc(sizeof(Unary));
+Unary* create_unary(Arena* arena, Token op, Expr* rhs) {
+    Unary* unary = (Unary*)arena_alloc(arena, sizeof(Unary));
     unary->base.type = EXPR_UNARY;
+    unary->base.range = (TokenRange){ 0, 0 };
     unary->base.accept = unary_accept;
 
     unary->op = op;
@@ -190,9 +351,10 @@ Unary* create_unary(Token op, Expr* rhs) {
     return unary;
 }
 
-Variable* create_variable(Token name) {
-    Variable* variable = (Variable*)malloc(sizeof(Variable));
+Variable* create_variable(Arena* arena, Token name) {
+    Variable* variable = (Variable*)arena_alloc(arena, sizeof(Variable));
     variable->base.type = EXPR_VARIABLE;
+    variable->base.range = (TokenRange){ 0, 0 };
     variable->base.accept = variable_accept;
 
     variable->name = name;
@@ -200,20 +362,23 @@ Variable* create_variable(Token name) {
     return variable;
 }
 
-Assign* create_assign(Token name, Expr* value) {
-    Assign* assign = (Assign*)malloc(sizeof(Assign));
+Assign* create_assign(Arena* arena, Token name, Token op, Expr* value) {
+    Assign* assign = (Assign*)arena_alloc(arena, sizeof(Assign));
     assign->base.type = EXPR_ASSIGN;
+    assign->base.range = (TokenRange){ 0, 0 };
     assign->base.accept = assign_accept;
 
     assign->name = name;
+    assign->op = op;
     assign->value = value;
 
     return assign;
 }
 
-Get* create_get(Expr* expr, Token property) {
-    Get* get = (Get*)malloc(sizeof(Get));
+Get* create_get(Arena* arena, Expr* expr, Token property) {
+    Get* get = (Get*)arena_alloc(arena, sizeof(Get));
     get->base.type = EXPR_GET;
+    get->base.range = (TokenRange){ 0, 0 };
     get->base.accept = get_accept;
 
     get->expr = expr;
@@ -222,9 +387,10 @@ Get* create_get(Expr* expr, Token property) {
     return get;
 }
 
-Call* create_call(Expr* callee, ExprArray args) {
-    Call* call = (Call*)malloc(sizeof(Call));
+Call* create_call(Arena* arena, Expr* callee, ExprArray args) {
+    Call* call = (Call*)arena_alloc(arena, sizeof(Call));
     call->base.type = EXPR_CALL;
+    call->base.range = (TokenRange){ 0, 0 };
     call->base.accept = call_accept;
 
     call->callee = callee;
@@ -233,14 +399,12 @@ Call* create_call(Expr* callee, ExprArray args) {
     return call;
 }
 
-Expression* create_expression(Expr* expr) {
-    Expression* expression = (Expression*)malloc(sizeof(Expression));
-    if (!expression) {
-        fprintf(stderr, "(MEMFLT) Memory allocation failed.\n");
-        exit(1);
-    }
+Expression* create_expression(Arena* arena, Expr* expr) {
+    Expression* expression = (Expression*)arena_alloc(arena, sizeof(Expression));
 
     expression->base.type = STMT_EXPRESSION;
+
+    expression->base.range = (TokenRange){ 0, 0 };
     expression->base.accept = expression_accept;
 
     expression->expr = expr;
@@ -248,45 +412,52 @@ Expression* create_expression(Expr* expr) {
     return expression;
 }
 
-Block* create_block(StmtArray* stmts) {
-    Block* block = (Block*)malloc(sizeof(Block));
+Block* create_block(Arena* arena, StmtArray* stmts) {
+    Block* block = (Block*)arena_alloc(arena, sizeof(Block));
     block->base.type = STMT_BLOCK;
+    block->base.range = (TokenRange){ 0, 0 };
     block->base.accept = block_accept;
 
-    block->body = stmts;
+    // `stmts` usually lives on the parser's stack, so the block keeps a copy.
+    block->body = (StmtArray*)arena_alloc(arena, sizeof(StmtArray));
+    *block->body = *stmts;
     return block;
 }
 
-Return* create_return(Expr* value) {
-    Return* return_stmt = (Return*)malloc(sizeof(Return));
+Return* create_return(Arena* arena, Expr* value) {
+    Return* return_stmt = (Return*)arena_alloc(arena, sizeof(Return));
     return_stmt->base.type = STMT_RETURN;
+    return_stmt->base.range = (TokenRange){ 0, 0 };
     return_stmt->base.accept = return_accept;
 
     return_stmt->value = value;
     return return_stmt;
 }
 
-Import* create_import(Expr* value) {
-    Import* import_stmt = (Import*)malloc(sizeof(Import));
+Import* create_import(Arena* arena, Expr* value) {
+    Import* import_stmt = (Import*)arena_alloc(arena, sizeof(Import));
     import_stmt->base.type = STMT_IMPORT;
+    import_stmt->base.range = (TokenRange){ 0, 0 };
     import_stmt->base.accept = import_accept;
 
     import_stmt->value = value;
     return import_stmt;
 }
 
-Expand* create_expand(Expr* value) {
-    Expand* expand_stmt = (Expand*)malloc(sizeof(Expand));
+Expand* create_expand(Arena* arena, Expr* value) {
+    Expand* expand_stmt = (Expand*)arena_alloc(arena, sizeof(Expand));
     expand_stmt->base.type = STMT_EXPAND;
+    expand_stmt->base.range = (TokenRange){ 0, 0 };
     expand_stmt->base.accept = expand_accept;
 
     expand_stmt->value = value;
     return expand_stmt;
 }
 
-Use* create_use(Expr* value) {
-    Use* use_stmt = (Use*)malloc(sizeof(Use));
+Use* create_use(Arena* arena, Expr* value) {
+    Use* use_stmt = (Use*)arena_alloc(arena, sizeof(Use));
     use_stmt->base.type = STMT_USE;
+    use_stmt->base.range = (TokenRange){ 0, 0 };
     use_stmt->base.accept = use_accept;
 
     use_stmt->value = value;
@@ -3,7 +3,9 @@
 #define NUUK_AST_H
 
 #include "E:\THE_LANGUAGE\src\utils\utils.h"
+#include "E:\THE_LANGUAGE\src\utils\arena.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct Visitor Visitor;
 typedef struct Expr Expr;
@@ -88,13 +90,25 @@ typedef enum Typeid {
     TYPEID_TUPLE
 } Typeid;
 
+// The tokens a node was parsed from: `count` tokens starting at `first`.
+// `first` is relative to the first token of the enclosing statement, and
+// for statements to that of the enclosing one, so a subtree stays valid when
+// tokens before it are inserted or removed; only top-level statements are
+// absolute. Nodes not built by the parser have an empty range.
+typedef struct TokenRange {
+    uint32_t first;
+    uint32_t count;
+} TokenRange;
+
 typedef struct Expr {
     ExprType type;
+    TokenRange range;
     const char* (*accept)(struct Expr* self, Visitor* visitor);
 } Expr;
 
 typedef struct Stmt {
     StmtType type;
+    TokenRange range;
     void (*accept)(struct Stmt* self, Visitor* visitor);
 } Stmt;
 
@@ -106,11 +120,18 @@ typedef struct Datatype {
 // # DATATYPES
 // ################################################################
 
+// Datatypes are hash-consed: the constructors return the one process-wide
+// instance of each structure, so two types are equal iff their pointers are,
+// and type memory grows with the number of distinct types rather than with
+// the number of declarations. They are immutable and live for the whole
+// process.
+
 typedef struct BasicType {
     Datatype base;
-    const char* name;
+    Atom name;
 } BasicType;
 
+// Also used for TYPEID_SHARED_POINTER and TYPEID_UNIQUE_POINTER.
 typedef struct Pointer {
     Datatype base;
     Datatype* type;
@@ -124,11 +145,12 @@ typedef struct Generic {
 typedef struct Array {
     Datatype base;
     size_t array_size;
-    Datatype** types;
+    Datatype* type;
 } Array;
 
 typedef struct Tuple {
     Datatype base;
+    size_t count;
     Datatype** types;
 } Tuple;
 
@@ -154,9 +176,32 @@ typedef struct Grouping {
     Expr* expr;
 } Grouping;
 
+typedef enum LiteralKind {
+    LITERAL_ERROR,
+    LITERAL_INT,
+    LITERAL_FLOAT,
+    LITERAL_BOOL,
+    LITERAL_CHAR,
+    LITERAL_STRING,
+} LiteralKind;
+
+// `value` is the text the literal is printed with. Numbers, booleans and
+// chars also carry their typed value in `as`; strings only have the text.
+// LITERAL_ERROR stands in for an operand that could not be parsed.
+// `offset` is the source offset of the literal's token, or of the operator
+// of the expression a folded literal replaces.
 typedef struct Literal {
     Expr base;
     const char* value;
+    size_t length;
+    LiteralKind kind;
+    uint32_t offset;
+    union {
+        int64_t integer;
+        double number;
+        bool boolean;
+        char character;
+    } as;
 } Literal;
 
 typedef struct Logical {
@@ -177,9 +222,11 @@ typedef struct Variable {
     Token name;
 } Variable;
 
+// `op` is ASSIGN or one of the compound operators (PLUS_EQ, ...).
 typedef struct Assign {
     Expr base;
     Token name;
+    Token op;
     Expr* value;
 } Assign;
 
@@ -239,7 +286,7 @@ typedef struct VariableDecl {
     Stmt base;
     bool mutability;
     Datatype* type;
-    Token* name;
+    Token name;
     Expr* value;
 } VariableDecl;
 
@@ -247,40 +294,47 @@ typedef struct VariableDecl {
 // # FUNC DEFS
 // ################################################################
 
-StmtArray create_stmt_array(int capacity);
-void stmt_array_add(StmtArray* array, Stmt* stmt);
-void free_stmt_array(StmtArray* array);
+// Every node and node array is allocated from the arena passed to its
+// constructor and is never freed on its own; free_arena() releases the whole
+// tree at once. Datatypes are shared and not part of any tree's arena.
+
+StmtArray create_stmt_array(Arena* arena, int capacity);
+void stmt_array_add(Arena* arena, StmtArray* array, Stmt* stmt);
 
-ExprArray create_expr_array(int capacity);
-void expr_array_add(ExprArray* array, Expr* expr);
-void free_expr_array(ExprArray* array);
+ExprArray create_expr_array(Arena* arena, int capacity);
+void expr_array_add(Arena* arena, ExprArray* array, Expr* expr);
 
 const char* id(Stmt* stmt);
 
-Datatype* basic_type(const char* name);
+// Canonical datatypes; see the DATATYPES section. Thread-safe. tuple()
+// copies `types`.
+Datatype* basic_type(Atom name);
 Datatype* pointer(Datatype* type);
+Datatype* shared_pointer(Datatype* type);
+Datatype* unique_pointer(Datatype* type);
 Datatype* generic(Datatype* type);
-Datatype* array(size_t array_size, Datatype** types);
-Datatype* tuple(Datatype** types);
-
-VariableDecl* create_variable_stmt(bool mutability, Datatype* type, Token* name, Expr* value);
-
-Binary* create_binary(Expr* lhs, Token op, Expr* rhs);
-Grouping* create_grouping(Expr* expr);
-Literal* create_literal(const char* value);
-Logical* create_logical(Expr* lhs, Token op, Expr* rhs);
-Unary* create_unary(Token op, Expr* rhs);
-Variable* create_variable(Token name);
-Assign* create_assign(Token name, Expr* value);
-Get* create_get(Expr* expr, Token property);
-Call* create_call(Expr* callee, ExprArray args);
-
-Expression* create_expression(Expr* expr);
-Block* create_block(StmtArray* stmts);
-Return* create_return(Expr* value);
-Import* create_import(Expr* value);
-Expand* create_expand(Expr* value);
-Use* create_use(Expr* value);
+Datatype* array(size_t array_size, Datatype* type);
+Datatype* tuple(Datatype** types, size_t count);
+size_t datatype_count();
+
+VariableDecl* create_variable_stmt(Arena* arena, bool mutability, Datatype* type, Token name, Expr* value);
+
+Binary* create_binary(Arena* arena, Expr* lhs, Token op, Expr* rhs);
+Grouping* create_grouping(Arena* arena, Expr* expr);
+Literal* create_literal(Arena* arena, LiteralKind kind, const char* value, size_t length);
+Logical* create_logical(Arena* arena, Expr* lhs, Token op, Expr* rhs);
+Unary* create_unary(Arena* arena, Token op, Expr* rhs);
+Variable* create_variable(Arena* arena, Token name);
+Assign* create_assign(Arena* arena, Token name, Token op, Expr* value);
+Get* create_get(Arena* arena, Expr* expr, Token property);
+Call* create_call(Arena* arena, Expr* callee, ExprArray args);
+
+Expression* create_expression(Arena* arena, Expr* expr);
+Block* create_block(Arena* arena, StmtArray* stmts);
+Return* create_return(Arena* arena, Expr* value);
+Import* create_import(Arena* arena, Expr* value);
+Expand* create_expand(Arena* arena, Expr* value);
+Use* create_use(Arena* arena, Expr* value);
 
 const char* binary_accept(Expr* self, Visitor* visitor);
 const char* grouping_accept(Expr* self, Visitor* visitor);
@@ -0,0 +1,143 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "ast_cache.h"
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define cache_mkdir(path) _mkdir(path)
+#define cache_pid() _getpid()
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define cache_mkdir(path) mkdir(path, 0755)
+#define cache_pid() getpid()
+#endif
+
+#define AST_CACHE_PATH_MAX 4096
+#define AST_CACHE_PRIME 0x9E3779B97F4A7C15ULL
+
+static uint64_t cache_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hashes 32 bytes per step in four independent lanes, so the multiplies of
+// one step overlap and the hash runs at memory speed rather than being
+// bound by a single dependency chain.
+static uint64_t cache_hash(const char* data, size_t length, uint64_t seed) {
+    uint64_t lanes[4] = { seed, seed ^ AST_CACHE_PRIME, seed + AST_CACHE_PRIME, ~seed };
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            memcpy(&word, data + i + lane * 8, sizeof(word));
+            lanes[lane] = (lanes[lane] ^ word) * AST_CACHE_PRIME;
+            lanes[lane] ^= lanes[lane] >> 29;
+        }
+    }
+
+    uint64_t h = length * AST_CACHE_PRIME;
+    for (int lane = 0; lane < 4; lane++) h = (h ^ cache_mix(lanes[lane])) * AST_CACHE_PRIME;
+    for (; i < length; i++) h = (h ^ (unsigned char)data[i]) * 0x100000001B3ULL;
+    return cache_mix(h);
+}
+
+static bool cache_path(const char* directory, const char* source, size_t length, char* path) {
+    uint64_t seed = cache_hash(NUUK_VERSION, strlen(NUUK_VERSION), FLAT_AST_VERSION);
+    uint64_t key = cache_hash(source, length, seed);
+    int written = snprintf(path, AST_CACHE_PATH_MAX, "%s/%016llx-%zx" AST_CACHE_EXTENSION, directory, (unsigned long long)key, length);
+    return written > 0 && written < AST_CACHE_PATH_MAX;
+}
+
+char* ast_cache_directory() {
+    const char* base = getenv("NUUK_CACHE_DIR");
+    const char* suffix = "";
+    if (!base || !*base) {
+        base = getenv("XDG_CACHE_HOME");
+        suffix = "/nuuk";
+    }
+    if (!base || !*base) {
+        base = getenv("HOME");
+        suffix = "/.cache/nuuk";
+    }
+    if (!base || !*base) return NULL;
+
+    size_t length = strlen(base) + strlen(suffix);
+    char* directory = (char*)malloc(length + 1);
+    if (!directory) return NULL;
+    snprintf(directory, length + 1, "%s%s", base, suffix);
+    return directory;
+}
+
+bool ast_cache_load(const char* directory, const char* source, size_t length, CachedAst* cached) {
+    char path[AST_CACHE_PATH_MAX];
+    cached->file = NULL;
+    if (!cache_path(directory, source, length, path)) return false;
+
+    cached->file = source_open(path);
+    if (!cached->file) return false;
+
+    if (!map_flat_ast(cached->file->data, cached->file->length, &cached->ast)) {
+        source_close(cached->file);
+        cached->file = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Creates `directory` and any missing parents.
+static bool make_directories(const char* directory) {
+    char path[AST_CACHE_PATH_MAX];
+    size_t length = strlen(directory);
+    if (length >= sizeof(path)) return false;
+    memcpy(path, directory, length + 1);
+
+    for (size_t i = 1; i <= length; i++) {
+        if (path[i] != '/' && path[i] != '\\' && path[i] != '\0') continue;
+        char separator = path[i];
+        path[i] = '\0';
+        if (cache_mkdir(path) != 0 && errno != EEXIST) return false;
+        path[i] = separator;
+    }
+    return true;
+}
+
+void ast_cache_store(const char* directory, const char* source, size_t length, const FlatAst* ast) {
+    char path[AST_CACHE_PATH_MAX];
+    char temporary[AST_CACHE_PATH_MAX];
+    if (!cache_path(directory, source, length, path)) return;
+    if (!make_directories(directory)) return;
+
+    int written = snprintf(temporary, sizeof(temporary), "%s.%d.tmp", path, (int)cache_pid());
+    if (written < 0 || (size_t)written >= sizeof(temporary)) return;
+
+    size_t size;
+    char* data = write_flat_ast(ast, &size);
+    FILE* file = fopen(temporary, "wb");
+    bool ok = file && fwrite(data, 1, size, file) == size;
+    if (file && fclose(file) != 0) ok = false;
+    free(data);
+
+    // Written under a private name and renamed into place, so concurrent
+    // compilers never map a half-written tree.
+#ifdef _WIN32
+    if (ok) remove(path);
+#endif
+    if (!ok || rename(temporary, path) != 0) remove(temporary);
+}
+
+void ast_cache_release(CachedAst* cached) {
+    free_flat_ast(&cached->ast);
+    source_close(cached->file);
+    cached->file = NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef NUUK_AST_CACHE_H
+#define NUUK_AST_CACHE_H
+
+#include "flat_ast.h"
+#include "E:\THE_LANGUAGE\src\utils\source.h"
+#include <stdbool.h>
+
+// Parsed trees are cached as serialized flat ASTs in a directory, one file
+// per source, named by a 64-bit hash of the source bytes seeded with the
+// compiler version and the flat AST format version, plus the source length.
+// An unchanged source therefore maps straight back to its tree, and a new
+// compiler never sees the trees of an old one. Bump NUUK_VERSION whenever
+// the parser's output changes.
+#define NUUK_VERSION "0.1.2"
+#define AST_CACHE_EXTENSION ".ast"
+
+// A tree mapped from the cache. `ast` borrows from `file`.
+typedef struct CachedAst {
+    Source* file;
+    FlatAst ast;
+} CachedAst;
+
+// $NUUK_CACHE_DIR, else $XDG_CACHE_HOME/nuuk, else $HOME/.cache/nuuk, or NULL
+// if none of them is set. The result is heap-allocated.
+char* ast_cache_directory();
+// Looks up the tree of source[0, length). Returns false on a miss or if the
+// cached file is unusable.
+bool ast_cache_load(const char* directory, const char* source, size_t length, CachedAst* cached);
+// Stores the tree of source[0, length), creating the directory if needed.
+// Failures are ignored: the cache is only an optimization.
+void ast_cache_store(const char* directory, const char* source, size_t length, const FlatAst* ast);
+void ast_cache_release(CachedAst* cached);
+
+#endif
@@ -1,3 +1,7 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
 
 #include "E:\THE_LANGUAGE\src\parser\ast_printer.h"
 
@@ -41,7 +45,7 @@ void dprint_stmt(Stmt* stmt) {
             printf("STMT_VAR(");
             printf(var->mutability ? "MUTABLE, " : "CONSTANT, ");
             dprint_typeid(var->type);
-            printf(", %s, ", var->name->value);
+            printf(", " TOKEN_FMT ", ", TOKEN_ARG(&var->name));
             if (var->value != NULL) dprint_expr(var->value);
             else printf("NULL");
             printf(");\n");
@@ -56,11 +60,11 @@ void dprint_typeid(Datatype* type) {
     switch (type->type) {
         case TYPEID_BASIC:
             BasicType* basic = (BasicType*)type;
-            if (!basic->name) { 
+            if (basic->name == NO_ATOM) { 
                 fprintf(stderr, "ERROR: BasicType has no name\n");
                 exit(1);
             }
-            printf("%s", basic->name);
+            printf("%s", atom_name(basic->name));
             break;
         case TYPEID_POINTER:
             Pointer* inner = (Pointer*)type;
@@ -81,23 +85,23 @@ void dprint_expr(Expr* expr) {
     switch (expr->type) {
         case EXPR_LITERAL:
             Literal* literal = (Literal*)expr;
-            printf("EXPR_LITERAL %s", literal->value);
+            printf("EXPR_LITERAL %.*s", (int)literal->length, literal->value);
             break;
         case EXPR_VARIABLE:
             Variable* variable = (Variable*)expr;
-            printf("EXPR_VARIABLE %s", variable->name.value);
+            printf("EXPR_VARIABLE " TOKEN_FMT, TOKEN_ARG(&variable->name));
             break;
         case EXPR_BINARY:
             Binary* binary = (Binary*)expr;
             printf("EXPR_BINARY(");
             dprint_expr(binary->lhs);
-            printf(" %s ", binary->op.value);
+            printf(" " TOKEN_FMT " ", TOKEN_ARG(&binary->op));
             dprint_expr(binary->rhs);
             printf(")");
             break;
         case EXPR_UNARY:
             Unary* unary = (Unary*)expr;
-            printf("EXPR_UNARY(%s, ", unary->op.value);
+            printf("EXPR_UNARY(" TOKEN_FMT ", ", TOKEN_ARG(&unary->op));
             dprint_expr(unary->rhs);
             printf(")");
             break;
@@ -142,9 +146,9 @@ const char* parenthesize(Visitor* self, const char* name, ExprArray* exprs) {
     strncat(builder, name, sizeof(builder) - sizeof(name) - 1);
 
     for (int i = 0; i < exprs->size; i++) {
-        Expr expr = *exprs->elements[i];
+        Expr* expr = exprs->elements[i];
         strncat(builder, " ", sizeof(builder) - sizeof(" ") - 1);
-        const char* result = expr.accept(&expr, self);
+        const char* result = expr->accept(expr, self);
         snprintf(builder + strlen(builder), sizeof(builder) - strlen(builder), " %s", result);
     }
 
@@ -156,29 +160,29 @@ const char* parenthesize(Visitor* self, const char* name, ExprArray* exprs) {
 
 // Vistor-Pattern
 const char* visit_binary(Visitor* self, Binary* binary) {
-    ExprArray exprs = create_expr_array(2);
-    expr_array_add(&exprs, binary->lhs);
-    expr_array_add(&exprs, binary->rhs);
+    Expr* elements[] = { binary->lhs, binary->rhs };
+    ExprArray exprs = { elements, 2, 2 };
 
-    return parenthesize(self, binary->op.value, &exprs);
+    return parenthesize(self, token_lexeme(&binary->op), &exprs);
 }
 
 const char* visit_grouping(Visitor* self, Grouping* grouping) {
-    ExprArray exprs = create_expr_array(1);
-    expr_array_add(&exprs, grouping->expr);
+    Expr* elements[] = { grouping->expr };
+    ExprArray exprs = { elements, 1, 1 };
 
     return parenthesize(self, "group", &exprs);
 }
 
 const char* visit_literal(Visitor* self, Literal* literal) {
-    return strdup(literal->value);
+    (void)self;
+    return strndup(literal->value, literal->length);
 }
 
 const char* visit_unary(Visitor* self, Unary* unary) {
-    ExprArray exprs = create_expr_array(1);
-    expr_array_add(&exprs, unary->rhs);
+    Expr* elements[] = { unary->rhs };
+    ExprArray exprs = { elements, 1, 1 };
 
-    return parenthesize(self, unary->op.value, &exprs);
+    return parenthesize(self, token_lexeme(&unary->op), &exprs);
 }
 
 void destroy_ast_printer(Visitor* visitor) {
@@ -0,0 +1,510 @@
+#include "flat_ast.h"
+
+#define FLAT_AST_MAGIC "NUUKAST"
+
+static void flat_reserve(FlatAst* ast, uint32_t capacity) {
+    if (capacity <= ast->capacity) return;
+
+    ast->tags = (uint8_t*)realloc(ast->tags, capacity * sizeof(uint8_t));
+    ast->ops = (uint8_t*)realloc(ast->ops, capacity * sizeof(uint8_t));
+    ast->data = (uint32_t*)realloc(ast->data, capacity * sizeof(uint32_t));
+    ast->ends = (NodeIndex*)realloc(ast->ends, capacity * sizeof(NodeIndex));
+    ast->spans = (uint32_t*)realloc(ast->spans, capacity * sizeof(uint32_t));
+    if (!ast->tags || !ast->ops || !ast->data || !ast->ends || !ast->spans) {
+        fprintf(stderr, "FATAL ERROR: Failed to resize flat AST.\n");
+        exit(EXIT_FAILURE);
+    }
+    ast->capacity = capacity;
+}
+
+static void flat_reserve_strings(FlatAst* ast, uint32_t capacity) {
+    if (capacity <= ast->strings_capacity) return;
+
+    ast->strings = (char*)realloc(ast->strings, capacity);
+    if (!ast->strings) {
+        fprintf(stderr, "FATAL ERROR: Failed to resize flat AST strings.\n");
+        exit(EXIT_FAILURE);
+    }
+    ast->strings_capacity = capacity;
+}
+
+// Appends a node whose subtree is still empty; flat_close() sets its end
+// once the children have been added.
+static NodeIndex flat_open(FlatAst* ast, FlatTag tag, uint8_t op, uint32_t data, uint32_t span) {
+    if (ast->size == UINT32_MAX) {
+        fprintf(stderr, "FATAL ERROR: AST has too many nodes to flatten.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (ast->size >= ast->capacity) flat_reserve(ast, ast->capacity ? ast->capacity * 2 : 256);
+
+    NodeIndex node = ast->size++;
+    ast->tags[node] = (uint8_t)tag;
+    ast->ops[node] = op;
+    ast->data[node] = data;
+    ast->ends[node] = ast->size;
+    ast->spans[node] = span;
+    return node;
+}
+
+static void flat_close(FlatAst* ast, NodeIndex node) {
+    ast->ends[node] = ast->size;
+}
+
+static uint32_t flat_add_string(FlatAst* ast, const char* value, size_t length) {
+    uint32_t offset = ast->strings_size;
+    uint32_t size = (uint32_t)length;
+    size_t needed = (size_t)offset + sizeof(size) + length;
+    if (needed > UINT32_MAX) {
+        fprintf(stderr, "FATAL ERROR: AST literals are too large to flatten.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t capacity = ast->strings_capacity ? ast->strings_capacity : 1024;
+    while (capacity < needed) capacity = capacity > UINT32_MAX / 2 ? UINT32_MAX : capacity * 2;
+    flat_reserve_strings(ast, capacity);
+
+    memcpy(ast->strings + offset, &size, sizeof(size));
+    memcpy(ast->strings + offset + sizeof(size), value, length);
+    ast->strings_size = (uint32_t)needed;
+    return offset;
+}
+
+static void flatten_expr(FlatAst* ast, Expr* expr);
+
+static void flatten_datatype(FlatAst* ast, Datatype* type) {
+    switch (type->type) {
+        case TYPEID_BASIC:
+            flat_open(ast, FLAT_TYPE_BASIC, 0, ((BasicType*)type)->name, FLAT_NO_SPAN);
+            break;
+        case TYPEID_POINTER: {
+            NodeIndex node = flat_open(ast, FLAT_TYPE_POINTER, 0, 0, FLAT_NO_SPAN);
+            flatten_datatype(ast, ((Pointer*)type)->type);
+            flat_close(ast, node);
+            break;
+        }
+        default:
+            fprintf(stderr, "FATAL ERROR: Datatype %d cannot be flattened yet.\n", type->type);
+            exit(EXIT_FAILURE);
+    }
+}
+
+static void flatten_unary_child(FlatAst* ast, FlatTag tag, uint8_t op, uint32_t data, uint32_t span, Expr* child) {
+    NodeIndex node = flat_open(ast, tag, op, data, span);
+    flatten_expr(ast, child);
+    flat_close(ast, node);
+}
+
+static void flatten_expr(FlatAst* ast, Expr* expr) {
+    switch (expr->type) {
+        case EXPR_BINARY: case EXPR_LOGICAL: {
+            // Binary and Logical share their layout.
+            Binary* binary = (Binary*)expr;
+            NodeIndex node = flat_open(ast, expr->type == EXPR_BINARY ? FLAT_BINARY : FLAT_LOGICAL, (uint8_t)binary->op.type, 0, binary->op.offset);
+            flatten_expr(ast, binary->lhs);
+            flatten_expr(ast, binary->rhs);
+            flat_close(ast, node);
+            break;
+        }
+        case EXPR_GROUPING:
+            flatten_unary_child(ast, FLAT_GROUPING, 0, 0, FLAT_NO_SPAN, ((Grouping*)expr)->expr);
+            break;
+        case EXPR_LITERAL: {
+            Literal* literal = (Literal*)expr;
+            flat_open(ast, FLAT_LITERAL, 0, flat_add_string(ast, literal->value, literal->length), literal->offset);
+            break;
+        }
+        case EXPR_UNARY: {
+            Unary* unary = (Unary*)expr;
+            flatten_unary_child(ast, FLAT_UNARY, (uint8_t)unary->op.type, 0, unary->op.offset, unary->rhs);
+            break;
+        }
+        case EXPR_VARIABLE: {
+            Variable* variable = (Variable*)expr;
+            flat_open(ast, FLAT_VARIABLE, 0, variable->name.atom, variable->name.offset);
+            break;
+        }
+        case EXPR_ASSIGN: {
+            Assign* assign = (Assign*)expr;
+            flatten_unary_child(ast, FLAT_ASSIGN, assign->op.type, assign->name.atom, assign->op.offset, assign->value);
+            break;
+        }
+        case EXPR_GET: {
+            Get* get = (Get*)expr;
+            flatten_unary_child(ast, FLAT_GET, 0, get->property.atom, get->property.offset, get->expr);
+            break;
+        }
+        case EXPR_CALL: {
+            Call* call = (Call*)expr;
+            NodeIndex node = flat_open(ast, FLAT_CALL, 0, (uint32_t)call->args.size, FLAT_NO_SPAN);
+            flatten_expr(ast, call->callee);
+            for (int i = 0; i < call->args.size; i++) flatten_expr(ast, call->args.elements[i]);
+            flat_close(ast, node);
+            break;
+        }
+    }
+}
+
+static void flatten_stmt(FlatAst* ast, Stmt* stmt) {
+    switch (stmt->type) {
+        case STMT_EXPRESSION:
+            flatten_unary_child(ast, FLAT_EXPRESSION, 0, 0, FLAT_NO_SPAN, ((Expression*)stmt)->expr);
+            break;
+        case STMT_RETURN:
+            flatten_unary_child(ast, FLAT_RETURN, 0, 0, FLAT_NO_SPAN, ((Return*)stmt)->value);
+            break;
+        case STMT_IMPORT:
+            flatten_unary_child(ast, FLAT_IMPORT, 0, 0, FLAT_NO_SPAN, ((Import*)stmt)->value);
+            break;
+        case STMT_EXPAND:
+            flatten_unary_child(ast, FLAT_EXPAND, 0, 0, FLAT_NO_SPAN, ((Expand*)stmt)->value);
+            break;
+        case STMT_USE:
+            flatten_unary_child(ast, FLAT_USE, 0, 0, FLAT_NO_SPAN, ((Use*)stmt)->value);
+            break;
+        case STMT_BLOCK: {
+            StmtArray* body = ((Block*)stmt)->body;
+            NodeIndex node = flat_open(ast, FLAT_BLOCK, 0, (uint32_t)body->size, FLAT_NO_SPAN);
+            for (int i = 0; i < body->size; i++) flatten_stmt(ast, body->elements[i]);
+            flat_close(ast, node);
+            break;
+        }
+        case STMT_VAR: {
+            VariableDecl* var = (VariableDecl*)stmt;
+            NodeIndex node = flat_open(ast, FLAT_VAR, var->mutability, var->name.atom, var->name.offset);
+            flatten_datatype(ast, var->type);
+            if (var->value) flatten_expr(ast, var->value);
+            flat_close(ast, node);
+            break;
+        }
+    }
+}
+
+FlatAst flatten_ast(const CompilationUnit* unit) {
+    FlatAst ast;
+    memset(&ast, 0, sizeof(ast));
+
+    NodeIndex root = flat_open(&ast, FLAT_UNIT, 0, (uint32_t)unit->stmts.size, FLAT_NO_SPAN);
+    for (int i = 0; i < unit->stmts.size; i++) flatten_stmt(&ast, unit->stmts.elements[i]);
+    flat_close(&ast, root);
+
+    return ast;
+}
+
+void free_flat_ast(FlatAst* ast) {
+    free(ast->data);
+    if (!ast->mapped) {
+        free(ast->tags);
+        free(ast->ops);
+        free(ast->ends);
+        free(ast->spans);
+        free(ast->strings);
+    }
+    memset(ast, 0, sizeof(*ast));
+}
+
+NodeIndex flat_first_child(const FlatAst* ast, NodeIndex node) {
+    (void)ast;
+    return node + 1;
+}
+
+NodeIndex flat_next_sibling(const FlatAst* ast, NodeIndex node) {
+    return ast->ends[node];
+}
+
+const char* flat_literal(const FlatAst* ast, NodeIndex node, size_t* length) {
+    uint32_t size;
+    memcpy(&size, ast->strings + ast->data[node], sizeof(size));
+    *length = size;
+    return ast->strings + ast->data[node] + sizeof(size);
+}
+
+// ################################################################
+// # PRINTING
+// ################################################################
+
+static void dprint_flat_typeid(const FlatAst* ast, NodeIndex node) {
+    switch (ast->tags[node]) {
+        case FLAT_TYPE_BASIC:
+            printf("%s", atom_name(ast->data[node]));
+            break;
+        case FLAT_TYPE_POINTER:
+            dprint_flat_typeid(ast, flat_first_child(ast, node));
+            printf("*");
+            break;
+        default:
+            printf("TYPEID_UNKOWN\n");
+    }
+}
+
+static void dprint_flat_expr(const FlatAst* ast, NodeIndex node) {
+    NodeIndex child = flat_first_child(ast, node);
+
+    switch (ast->tags[node]) {
+        case FLAT_LITERAL: {
+            size_t length;
+            const char* value = flat_literal(ast, node, &length);
+            printf("EXPR_LITERAL %.*s", (int)length, value);
+            break;
+        }
+        case FLAT_VARIABLE:
+            printf("EXPR_VARIABLE %s", atom_name(ast->data[node]));
+            break;
+        case FLAT_BINARY:
+            printf("EXPR_BINARY(");
+            dprint_flat_expr(ast, child);
+            printf(" %s ", token_type_spelling((TokenType)ast->ops[node]));
+            dprint_flat_expr(ast, flat_next_sibling(ast, child));
+            printf(")");
+            break;
+        case FLAT_UNARY:
+            printf("EXPR_UNARY(%s, ", token_type_spelling((TokenType)ast->ops[node]));
+            dprint_flat_expr(ast, child);
+            printf(")");
+            break;
+        default:
+            printf("EXPR_UNKOWN");
+    }
+}
+
+static void dprint_flat_stmt(const FlatAst* ast, NodeIndex node) {
+    static const char* const names[] = {
+        [FLAT_EXPRESSION] = "STMT_EXPRESSION", [FLAT_RETURN] = "STMT_RETURN", [FLAT_IMPORT] = "STMT_IMPORT",
+        [FLAT_USE] = "STMT_USE", [FLAT_EXPAND] = "STMT_EXPAND",
+    };
+    NodeIndex child = flat_first_child(ast, node);
+
+    switch (ast->tags[node]) {
+        case FLAT_EXPRESSION: case FLAT_RETURN: case FLAT_IMPORT: case FLAT_USE: case FLAT_EXPAND:
+            printf("%s(", names[ast->tags[node]]);
+            dprint_flat_expr(ast, child);
+            printf(");\n");
+            break;
+        case FLAT_BLOCK:
+            printf("STMT_BLOCK\n");
+            break;
+        case FLAT_VAR:
+            printf("STMT_VAR(");
+            printf(ast->ops[node] ? "MUTABLE, " : "CONSTANT, ");
+            dprint_flat_typeid(ast, child);
+            printf(", %s, ", atom_name(ast->data[node]));
+            if (ast->ends[child] < ast->ends[node]) dprint_flat_expr(ast, ast->ends[child]);
+            else printf("NULL");
+            printf(");\n");
+            break;
+        default:
+            printf("STMT_UNKOWN\n");
+    }
+}
+
+void dprint_flat_ast(const FlatAst* ast) {
+    for (NodeIndex node = flat_first_child(ast, 0); node < ast->ends[0]; node = flat_next_sibling(ast, node)) {
+        dprint_flat_stmt(ast, node);
+    }
+}
+
+// ################################################################
+// # SERIALIZATION
+// ################################################################
+
+typedef struct FlatAstHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint32_t strings_size;
+    uint32_t names_count;
+    uint32_t names_size;
+} FlatAstHeader;
+
+// data, ends and spans, then tags and ops.
+#define FLAT_NODE_BYTES (3 * sizeof(uint32_t) + 2)
+
+static bool flat_tag_has_atom(uint8_t tag) {
+    return tag == FLAT_VAR || tag == FLAT_VARIABLE || tag == FLAT_ASSIGN || tag == FLAT_GET || tag == FLAT_TYPE_BASIC;
+}
+
+// Layout: header, data, ends, spans, tags, ops, strings, then names_count
+// entries of (uint32_t length, bytes). Atoms in `data` are replaced by their
+// index in the name table.
+char* write_flat_ast(const FlatAst* ast, size_t* length) {
+    size_t atoms = atom_count() + 1;
+    uint32_t* names = (uint32_t*)malloc(atoms * sizeof(uint32_t));
+    uint32_t* data = (uint32_t*)malloc(ast->size * sizeof(uint32_t) + 1);
+    if (!names || !data) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate flat AST writer.\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(names, 0xFF, atoms * sizeof(uint32_t));
+
+    FlatAstHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLAT_AST_MAGIC, sizeof(FLAT_AST_MAGIC));
+    header.version = FLAT_AST_VERSION;
+    header.size = ast->size;
+    header.strings_size = ast->strings_size;
+
+    for (uint32_t i = 0; i < ast->size; i++) {
+        data[i] = ast->data[i];
+        if (!flat_tag_has_atom(ast->tags[i])) continue;
+
+        Atom atom = ast->data[i];
+        if (names[atom] == UINT32_MAX) {
+            names[atom] = header.names_count++;
+            header.names_size += sizeof(uint32_t) + (uint32_t)atom_length(atom);
+        }
+        data[i] = names[atom];
+    }
+
+    *length = sizeof(header) + (size_t)ast->size * FLAT_NODE_BYTES + ast->strings_size + header.names_size;
+    char* out = (char*)malloc(*length);
+    if (!out) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate serialized AST.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char* p = out;
+    memcpy(p, &header, sizeof(header)); p += sizeof(header);
+    memcpy(p, data, ast->size * sizeof(uint32_t)); p += ast->size * sizeof(uint32_t);
+    memcpy(p, ast->ends, ast->size * sizeof(NodeIndex)); p += ast->size * sizeof(NodeIndex);
+    memcpy(p, ast->spans, ast->size * sizeof(uint32_t)); p += ast->size * sizeof(uint32_t);
+    memcpy(p, ast->tags, ast->size); p += ast->size;
+    memcpy(p, ast->ops, ast->size); p += ast->size;
+    if (ast->strings_size) memcpy(p, ast->strings, ast->strings_size);
+    p += ast->strings_size;
+
+    // Names are written in index order, i.e. in order of first use.
+    for (uint32_t i = 0; i < ast->size; i++) {
+        if (!flat_tag_has_atom(ast->tags[i])) continue;
+        Atom atom = ast->data[i];
+        if (names[atom] == UINT32_MAX) continue;
+
+        uint32_t size = (uint32_t)atom_length(atom);
+        memcpy(p, &size, sizeof(size)); p += sizeof(size);
+        memcpy(p, atom_name(atom), size); p += size;
+        names[atom] = UINT32_MAX;
+    }
+
+    free(names);
+    free(data);
+    return out;
+}
+
+// Checks that the children of `node` exactly tile its subtree and that there
+// are as many as its tag requires.
+static bool flat_node_valid(const FlatAst* ast, NodeIndex node) {
+    uint32_t children = 0;
+    for (NodeIndex child = node + 1; child < ast->ends[node]; child = ast->ends[child]) {
+        if (ast->ends[child] <= child || ast->ends[child] > ast->ends[node]) return false;
+        children++;
+    }
+
+    switch (ast->tags[node]) {
+        case FLAT_UNIT: case FLAT_BLOCK: return children == ast->data[node];
+        case FLAT_CALL: return children == ast->data[node] + 1;
+        case FLAT_VAR: return children == 1 || children == 2;
+        case FLAT_BINARY: case FLAT_LOGICAL: return children == 2 && ast->ops[node] <= END_OF_FILE;
+        case FLAT_UNARY: case FLAT_ASSIGN: return children == 1 && ast->ops[node] <= END_OF_FILE;
+        case FLAT_LITERAL: case FLAT_VARIABLE: case FLAT_TYPE_BASIC: return children == 0;
+        default: return children == 1;
+    }
+}
+
+static bool flat_read_header(const char* data, size_t length, FlatAstHeader* header) {
+    if (length < sizeof(*header)) return false;
+
+    memcpy(header, data, sizeof(*header));
+    if (memcmp(header->magic, FLAT_AST_MAGIC, sizeof(FLAT_AST_MAGIC)) != 0 || header->version != FLAT_AST_VERSION) return false;
+
+    size_t expected = sizeof(*header) + (size_t)header->size * FLAT_NODE_BYTES + header->strings_size + header->names_size;
+    if (length != expected || header->size == 0) return false;
+    return header->names_count <= header->names_size / sizeof(uint32_t);
+}
+
+// Interns the name table at `names`, replaces the name indices in `data` by
+// atoms and checks the shape of every node. Frees the tree on failure.
+static bool flat_resolve(FlatAst* ast, const FlatAstHeader* header, const char* names, const char* end) {
+    Atom* atoms = (Atom*)malloc((header->names_count + 1) * sizeof(Atom));
+    if (!atoms) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate flat AST reader.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char* p = names;
+    bool ok = true;
+    for (uint32_t i = 0; i < header->names_count && ok; i++) {
+        uint32_t size;
+        if (end - p < (ptrdiff_t)sizeof(size)) { ok = false; break; }
+        memcpy(&size, p, sizeof(size)); p += sizeof(size);
+        if ((size_t)(end - p) < size) { ok = false; break; }
+        atoms[i] = intern(p, size);
+        p += size;
+    }
+
+    for (uint32_t i = 0; i < ast->size && ok; i++) {
+        if (ast->tags[i] > FLAT_TYPE_POINTER || ast->ends[i] <= i || ast->ends[i] > ast->size) ok = false;
+        else if (!flat_node_valid(ast, i)) ok = false;
+        else if (flat_tag_has_atom(ast->tags[i])) {
+            if (ast->data[i] >= header->names_count) ok = false;
+            else ast->data[i] = atoms[ast->data[i]];
+        } else if (ast->tags[i] == FLAT_LITERAL) {
+            uint32_t size;
+            if ((size_t)ast->data[i] + sizeof(size) > ast->strings_size) { ok = false; break; }
+            memcpy(&size, ast->strings + ast->data[i], sizeof(size));
+            if ((size_t)ast->data[i] + sizeof(size) + size > ast->strings_size) ok = false;
+        }
+    }
+
+    free(atoms);
+    if (!ok || ast->tags[0] != FLAT_UNIT || ast->ends[0] != ast->size) {
+        free_flat_ast(ast);
+        return false;
+    }
+    return true;
+}
+
+bool read_flat_ast(const char* data, size_t length, FlatAst* ast) {
+    FlatAstHeader header;
+    memset(ast, 0, sizeof(*ast));
+    if (!flat_read_header(data, length, &header)) return false;
+
+    const char* p = data + sizeof(header);
+    flat_reserve(ast, header.size);
+    memcpy(ast->data, p, header.size * sizeof(uint32_t)); p += header.size * sizeof(uint32_t);
+    memcpy(ast->ends, p, header.size * sizeof(NodeIndex)); p += header.size * sizeof(NodeIndex);
+    memcpy(ast->spans, p, header.size * sizeof(uint32_t)); p += header.size * sizeof(uint32_t);
+    memcpy(ast->tags, p, header.size); p += header.size;
+    memcpy(ast->ops, p, header.size); p += header.size;
+    ast->size = header.size;
+
+    flat_reserve_strings(ast, header.strings_size ? header.strings_size : 1);
+    memcpy(ast->strings, p, header.strings_size); p += header.strings_size;
+    ast->strings_size = header.strings_size;
+
+    return flat_resolve(ast, &header, p, data + length);
+}
+
+bool map_flat_ast(const char* data, size_t length, FlatAst* ast) {
+    FlatAstHeader header;
+    memset(ast, 0, sizeof(*ast));
+    if ((uintptr_t)data % sizeof(uint32_t) != 0) return false;
+    if (!flat_read_header(data, length, &header)) return false;
+
+    const char* p = data + sizeof(header);
+    ast->data = (uint32_t*)malloc(header.size * sizeof(uint32_t));
+    if (!ast->data) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate flat AST reader.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(ast->data, p, header.size * sizeof(uint32_t)); p += header.size * sizeof(uint32_t);
+    ast->ends = (NodeIndex*)p; p += header.size * sizeof(NodeIndex);
+    ast->spans = (uint32_t*)p; p += header.size * sizeof(uint32_t);
+    ast->tags = (uint8_t*)p; p += header.size;
+    ast->ops = (uint8_t*)p; p += header.size;
+    ast->strings = (char*)p; p += header.strings_size;
+    ast->size = header.size;
+    ast->capacity = header.size;
+    ast->strings_size = header.strings_size;
+    ast->strings_capacity = header.strings_size;
+    ast->mapped = true;
+
+    return flat_resolve(ast, &header, p, data + length);
+}
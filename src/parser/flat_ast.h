@@ -0,0 +1,89 @@
+#ifndef NUUK_FLAT_AST_H
+#define NUUK_FLAT_AST_H
+
+#include "E:\THE_LANGUAGE\src\parser\parser.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// A flat, pointer-free copy of a CompilationUnit. Nodes are stored in
+// pre-order in parallel arrays and addressed by 32-bit indices: the first
+// child of node i is i + 1 and its next sibling is ends[i], the index just
+// past its subtree. Index 0 is always the FLAT_UNIT root. Passes can walk
+// the arrays front to back, and since nothing in it is a pointer, the whole
+// structure is serialized by copying the arrays.
+typedef uint32_t NodeIndex;
+
+// `spans` holds the source offset of the token that identifies each node:
+// the operator of a Binary/Logical/Unary/Assign, the name of a Variable,
+// Get or variable declaration, the token of a Literal. Nodes without such a
+// token get FLAT_NO_SPAN.
+#define FLAT_NO_SPAN UINT32_MAX
+
+// Per-tag layout of `ops`, `data` and the children:
+//
+//   FLAT_UNIT, FLAT_BLOCK   data: statement count; children: the statements
+//   FLAT_EXPRESSION, FLAT_RETURN, FLAT_IMPORT, FLAT_EXPAND, FLAT_USE
+//                           one child
+//   FLAT_VAR                ops: VariableDecl.mutability; data: name atom;
+//                           children: datatype, then the value if any
+//   FLAT_BINARY, FLAT_LOGICAL
+//                           ops: operator TokenType; children: lhs, rhs
+//   FLAT_UNARY              ops: operator TokenType; one child
+//   FLAT_GROUPING           one child
+//   FLAT_LITERAL            data: offset of the literal in `strings`
+//   FLAT_VARIABLE           data: name atom
+//   FLAT_ASSIGN             ops: ASSIGN or the compound operator;
+//                           data: target atom; one child
+//   FLAT_GET                data: property atom; one child
+//   FLAT_CALL               data: argument count; children: callee, arguments
+//   FLAT_TYPE_BASIC         data: type name atom
+//   FLAT_TYPE_POINTER       one child, the pointee
+typedef enum FlatTag {
+    FLAT_UNIT,
+    FLAT_EXPRESSION, FLAT_BLOCK, FLAT_IMPORT, FLAT_EXPAND, FLAT_RETURN, FLAT_USE, FLAT_VAR,
+    FLAT_BINARY, FLAT_GROUPING, FLAT_LITERAL, FLAT_LOGICAL, FLAT_UNARY, FLAT_VARIABLE,
+    FLAT_ASSIGN, FLAT_GET, FLAT_CALL,
+    FLAT_TYPE_BASIC, FLAT_TYPE_POINTER,
+} FlatTag;
+
+// `strings` holds literal text, each entry a native uint32_t length followed
+// by the bytes. A `mapped` tree borrows every array but `data` from the
+// buffer it was mapped from; see map_flat_ast().
+typedef struct FlatAst {
+    uint8_t* tags;
+    uint8_t* ops;
+    uint32_t* data;
+    NodeIndex* ends;
+    uint32_t* spans;
+    uint32_t size;
+    uint32_t capacity;
+
+    char* strings;
+    uint32_t strings_size;
+    uint32_t strings_capacity;
+    bool mapped;
+} FlatAst;
+
+FlatAst flatten_ast(const CompilationUnit* unit);
+void free_flat_ast(FlatAst* ast);
+
+NodeIndex flat_first_child(const FlatAst* ast, NodeIndex node);
+NodeIndex flat_next_sibling(const FlatAst* ast, NodeIndex node);
+const char* flat_literal(const FlatAst* ast, NodeIndex node, size_t* length);
+
+// Prints every statement the way dprint_stmt() prints the pointer AST.
+void dprint_flat_ast(const FlatAst* ast);
+
+// The serialized form is the arrays in native byte order behind a small
+// header, plus a table of the spellings of all atoms, which are remapped
+// when reading. The 32-bit arrays come first, so a buffer that is 4-byte
+// aligned (e.g. a mapped file) can be used in place by map_flat_ast(), which
+// only copies `data`; the buffer must then outlive the tree.
+// read_flat_ast() copies everything. Both return false on malformed input,
+// including a header of another FLAT_AST_VERSION.
+#define FLAT_AST_VERSION 2
+char* write_flat_ast(const FlatAst* ast, size_t* length);
+bool read_flat_ast(const char* data, size_t length, FlatAst* ast);
+bool map_flat_ast(const char* data, size_t length, FlatAst* ast);
+
+#endif
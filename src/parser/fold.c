@@ -0,0 +1,298 @@
+#include "fold.h"
+#include "E:\THE_LANGUAGE\src\vm\value.h"
+
+#include <inttypes.h>
+
+typedef struct Folder {
+    Arena* arena;
+    Diagnostics* diagnostics;
+} Folder;
+
+static Expr* fold_expr(Folder* self, Expr* expr);
+
+static bool is_constant(const Expr* expr) {
+    if (expr->type != EXPR_LITERAL) return false;
+    LiteralKind kind = ((const Literal*)expr)->kind;
+    return kind == LITERAL_INT || kind == LITERAL_FLOAT || kind == LITERAL_BOOL || kind == LITERAL_CHAR;
+}
+
+static bool literal_is_number(const Literal* literal) {
+    return literal->kind == LITERAL_INT || literal->kind == LITERAL_FLOAT || literal->kind == LITERAL_CHAR;
+}
+
+static int64_t literal_int(const Literal* literal) {
+    return literal->kind == LITERAL_CHAR ? (unsigned char)literal->as.character : literal->as.integer;
+}
+
+static double literal_float(const Literal* literal) {
+    return literal->kind == LITERAL_FLOAT ? literal->as.number : (double)literal_int(literal);
+}
+
+// The literal that replaces `node`, a Binary or Unary; it keeps the node's
+// token range and takes the offset of its operator.
+static Literal* folded(Folder* self, const Expr* node, LiteralKind kind) {
+    Literal* literal = create_literal(self->arena, kind, NULL, 0);
+    literal->base.range = node->range;
+    literal->offset = node->type == EXPR_BINARY ? ((const Binary*)node)->op.offset : ((const Unary*)node)->op.offset;
+    return literal;
+}
+
+static void set_text(Folder* self, Literal* literal, const char* text) {
+    literal->length = strlen(text);
+    literal->value = arena_strndup(self->arena, text, literal->length);
+}
+
+static Expr* int_literal(Folder* self, const Expr* node, int64_t value) {
+    Literal* literal = folded(self, node, LITERAL_INT);
+    literal->as.integer = value;
+    char text[32];
+    snprintf(text, sizeof(text), "%" PRId64, value);
+    set_text(self, literal, text);
+    return (Expr*)literal;
+}
+
+static Expr* float_literal(Folder* self, const Expr* node, double value) {
+    Literal* literal = folded(self, node, LITERAL_FLOAT);
+    literal->as.number = value;
+    // Round-trips exactly and always reads back as a float.
+    char text[40];
+    snprintf(text, sizeof(text), "%.17g", value);
+    if (!strpbrk(text, ".en")) strcat(text, ".0");
+    set_text(self, literal, text);
+    return (Expr*)literal;
+}
+
+static Expr* bool_literal(Folder* self, const Expr* node, bool value) {
+    Literal* literal = folded(self, node, LITERAL_BOOL);
+    literal->as.boolean = value;
+    literal->value = value ? "true" : "false";
+    literal->length = value ? 4 : 5;
+    return (Expr*)literal;
+}
+
+static Expr* fold_int_binary(Folder* self, Binary* binary, int64_t lhs, int64_t rhs) {
+    // An operand that is already out of range is left for the compiler to
+    // report at the literal.
+    if (!int_fits(lhs) || !int_fits(rhs)) return (Expr*)binary;
+
+    int64_t result;
+    bool overflow = false;
+    switch (binary->op.type) {
+        case PLUS: overflow = __builtin_add_overflow(lhs, rhs, &result); break;
+        case MINUS: overflow = __builtin_sub_overflow(lhs, rhs, &result); break;
+        case STAR: overflow = __builtin_mul_overflow(lhs, rhs, &result); break;
+        case SLASH: case MOD:
+            if (rhs == 0) {
+                diagnostics_add(self->diagnostics, binary->op.offset, "Division by zero in constant expression.");
+                return (Expr*)binary;
+            }
+            result = binary->op.type == SLASH ? lhs / rhs : lhs % rhs;
+            break;
+        default:
+            return (Expr*)binary;
+    }
+
+    if (overflow || !int_fits(result)) {
+        diagnostics_add(self->diagnostics, binary->op.offset, "Integer overflow in constant expression.");
+        return (Expr*)binary;
+    }
+    return int_literal(self, (Expr*)binary, result);
+}
+
+static Expr* fold_float_binary(Folder* self, Binary* binary, double lhs, double rhs) {
+    double result;
+    switch (binary->op.type) {
+        case PLUS: result = lhs + rhs; break;
+        case MINUS: result = lhs - rhs; break;
+        case STAR: result = lhs * rhs; break;
+        case SLASH:
+            if (rhs == 0.0) {
+                diagnostics_add(self->diagnostics, binary->op.offset, "Division by zero in constant expression.");
+                return (Expr*)binary;
+            }
+            result = lhs / rhs;
+            break;
+        default:
+            return (Expr*)binary;
+    }
+
+    // Literals are always finite, so an infinite result overflowed.
+    if (result - result != 0.0) {
+        diagnostics_add(self->diagnostics, binary->op.offset, "Floating-point overflow in constant expression.");
+        return (Expr*)binary;
+    }
+    return float_literal(self, (Expr*)binary, result);
+}
+
+static Expr* fold_comparison(Folder* self, Binary* binary, const Literal* lhs, const Literal* rhs) {
+    TokenType op = binary->op.type;
+    if (lhs->kind == LITERAL_BOOL || rhs->kind == LITERAL_BOOL) {
+        if (lhs->kind != rhs->kind || (op != EQ && op != NEQ)) return (Expr*)binary;
+        return bool_literal(self, (Expr*)binary, (lhs->as.boolean == rhs->as.boolean) == (op == EQ));
+    }
+
+    int order;
+    if (lhs->kind == LITERAL_FLOAT || rhs->kind == LITERAL_FLOAT) {
+        double a = literal_float(lhs), b = literal_float(rhs);
+        order = a < b ? -1 : a > b ? 1 : 0;
+    } else {
+        int64_t a = literal_int(lhs), b = literal_int(rhs);
+        order = a < b ? -1 : a > b ? 1 : 0;
+    }
+
+    switch (op) {
+        case EQ: return bool_literal(self, (Expr*)binary, order == 0);
+        case NEQ: return bool_literal(self, (Expr*)binary, order != 0);
+        case LT: return bool_literal(self, (Expr*)binary, order < 0);
+        case GT: return bool_literal(self, (Expr*)binary, order > 0);
+        case LTE: return bool_literal(self, (Expr*)binary, order <= 0);
+        case GTE: return bool_literal(self, (Expr*)binary, order >= 0);
+        default: return (Expr*)binary;
+    }
+}
+
+static Expr* fold_binary(Folder* self, Binary* binary) {
+    binary->lhs = fold_expr(self, binary->lhs);
+    if (binary->op.type == COLON_COLON) return (Expr*)binary;
+    binary->rhs = fold_expr(self, binary->rhs);
+
+    if (!is_constant(binary->lhs) || !is_constant(binary->rhs)) return (Expr*)binary;
+
+    Literal* lhs = (Literal*)binary->lhs;
+    Literal* rhs = (Literal*)binary->rhs;
+    switch (binary->op.type) {
+        case EQ: case NEQ: case LT: case GT: case LTE: case GTE:
+            return fold_comparison(self, binary, lhs, rhs);
+        default:
+            break;
+    }
+
+    if (!literal_is_number(lhs) || !literal_is_number(rhs)) return (Expr*)binary;
+    if (lhs->kind == LITERAL_FLOAT || rhs->kind == LITERAL_FLOAT) {
+        return fold_float_binary(self, binary, literal_float(lhs), literal_float(rhs));
+    }
+    return fold_int_binary(self, binary, literal_int(lhs), literal_int(rhs));
+}
+
+static Expr* fold_logical(Folder* self, Logical* logical) {
+    logical->lhs = fold_expr(self, logical->lhs);
+    logical->rhs = fold_expr(self, logical->rhs);
+
+    if (logical->lhs->type != EXPR_LITERAL || ((Literal*)logical->lhs)->kind != LITERAL_BOOL) return (Expr*)logical;
+    bool lhs = ((Literal*)logical->lhs)->as.boolean;
+    // The right side is only evaluated if the left one does not decide.
+    bool decided = logical->op.type == AND ? !lhs : lhs;
+    return decided ? logical->lhs : logical->rhs;
+}
+
+static Expr* fold_unary(Folder* self, Unary* unary) {
+    unary->rhs = fold_expr(self, unary->rhs);
+    if (!is_constant(unary->rhs)) return (Expr*)unary;
+
+    Literal* rhs = (Literal*)unary->rhs;
+    switch (unary->op.type) {
+        case MINUS:
+            if (rhs->kind == LITERAL_FLOAT) return float_literal(self, (Expr*)unary, -rhs->as.number);
+            if (!literal_is_number(rhs)) break;
+            // -140737488355328 is in range although its literal is not.
+            int64_t value = literal_int(rhs);
+            if (value == INT64_MIN || !int_fits(-value)) {
+                if (int_fits(value)) diagnostics_add(self->diagnostics, unary->op.offset, "Integer overflow in constant expression.");
+                break;
+            }
+            return int_literal(self, (Expr*)unary, -value);
+        case BANG:
+            if (rhs->kind == LITERAL_BOOL) return bool_literal(self, (Expr*)unary, !rhs->as.boolean);
+            break;
+        default:
+            break;
+    }
+    return (Expr*)unary;
+}
+
+// Returns the node that replaces `expr`, which may be `expr` itself.
+static Expr* fold_expr(Folder* self, Expr* expr) {
+    switch (expr->type) {
+        case EXPR_BINARY:
+            return fold_binary(self, (Binary*)expr);
+        case EXPR_LOGICAL:
+            return fold_logical(self, (Logical*)expr);
+        case EXPR_UNARY:
+            return fold_unary(self, (Unary*)expr);
+        case EXPR_GROUPING: {
+            Grouping* grouping = (Grouping*)expr;
+            grouping->expr = fold_expr(self, grouping->expr);
+            return is_constant(grouping->expr) ? grouping->expr : expr;
+        }
+        case EXPR_ASSIGN: {
+            Assign* assign = (Assign*)expr;
+            assign->value = fold_expr(self, assign->value);
+            return expr;
+        }
+        case EXPR_GET: {
+            Get* get = (Get*)expr;
+            get->expr = fold_expr(self, get->expr);
+            return expr;
+        }
+        case EXPR_CALL: {
+            Call* call = (Call*)expr;
+            call->callee = fold_expr(self, call->callee);
+            for (int i = 0; i < call->args.size; i++) {
+                call->args.elements[i] = fold_expr(self, call->args.elements[i]);
+            }
+            return expr;
+        }
+        case EXPR_LITERAL: case EXPR_VARIABLE:
+            return expr;
+    }
+    return expr;
+}
+
+static void fold_stmt(Folder* self, Stmt* stmt) {
+    switch (stmt->type) {
+        case STMT_EXPRESSION: {
+            Expression* expression = (Expression*)stmt;
+            expression->expr = fold_expr(self, expression->expr);
+            break;
+        }
+        case STMT_BLOCK: {
+            StmtArray* body = ((Block*)stmt)->body;
+            for (int i = 0; i < body->size; i++) fold_stmt(self, body->elements[i]);
+            break;
+        }
+        case STMT_RETURN: {
+            Return* return_stmt = (Return*)stmt;
+            return_stmt->value = fold_expr(self, return_stmt->value);
+            break;
+        }
+        case STMT_IMPORT: {
+            Import* import_stmt = (Import*)stmt;
+            import_stmt->value = fold_expr(self, import_stmt->value);
+            break;
+        }
+        case STMT_EXPAND: {
+            Expand* expand_stmt = (Expand*)stmt;
+            expand_stmt->value = fold_expr(self, expand_stmt->value);
+            break;
+        }
+        case STMT_USE: {
+            Use* use_stmt = (Use*)stmt;
+            use_stmt->value = fold_expr(self, use_stmt->value);
+            break;
+        }
+        case STMT_VAR: {
+            VariableDecl* var = (VariableDecl*)stmt;
+            if (var->value) var->value = fold_expr(self, var->value);
+            break;
+        }
+    }
+}
+
+void fold_constants(CompilationUnit* unit) {
+    if (unit->diagnostics.size > 0) return;
+
+    Folder folder = { unit->arena, &unit->diagnostics };
+    for (int i = 0; i < unit->stmts.size; i++) {
+        fold_stmt(&folder, unit->stmts.elements[i]);
+    }
+}
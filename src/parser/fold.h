@@ -0,0 +1,25 @@
+#ifndef NUUK_FOLD_H
+#define NUUK_FOLD_H
+
+#include "parser.h"
+
+// Folds constant subtrees of a parsed unit. Binary, Unary, Logical and
+// Grouping nodes over int, float, bool and char literals are evaluated and
+// replaced by a literal of the result, in the arena of the unit:
+//
+//   - int op int stays int (48-bit, as at run time; '/' truncates); any
+//     float operand makes it float; chars take part as ints
+//   - comparisons and '==' / '!=' give bools
+//   - 'and' / 'or' with a constant left side short-circuit, so
+//     `false and f()` becomes false and `true and f()` becomes f()
+//
+// Operations with a non-constant operand are left alone, even `x + 0` or
+// `x * 1`: nothing guarantees x is an int at run time, and for a bool, char
+// or -0.0 x the operation is not the identity.
+//
+// Overflow (including a float result that is no longer finite) and
+// division by zero are added to the unit's diagnostics and leave the
+// operation unfolded. A unit with syntax errors is left as is.
+void fold_constants(CompilationUnit* unit);
+
+#endif
@@ -0,0 +1,300 @@
+#include "incremental.h"
+
+#include <stdint.h>
+
+// Old tokens [edit_start, edit_end) were replaced; an old token i at or past
+// edit_end is now token i + shift. `errors` holds the old token index of
+// every old diagnostic, sorted. The old tokens [region_start, region_end)
+// are the ones whose statements were parsed again.
+typedef struct Reparser {
+    Parser* parser;
+    Arena* arena;
+    size_t edit_start;
+    size_t edit_end;
+    ptrdiff_t shift;
+    size_t* errors;
+    size_t error_count;
+    size_t region_start;
+    size_t region_end;
+    Reparse* result;
+} Reparser;
+
+static size_t stmt_start(const Stmt* stmt, size_t base) {
+    return base + stmt->range.first;
+}
+
+static size_t stmt_end(const Stmt* stmt, size_t base) {
+    return base + stmt->range.first + stmt->range.count;
+}
+
+// Where the statement after `stmt` was parsed from. A declaration that
+// consumed nothing (a stray '}') is followed by the token it failed on.
+static size_t stmt_next(const Stmt* stmt, size_t base) {
+    return stmt_end(stmt, base) + (stmt->range.count == 0);
+}
+
+// Index of the first statement whose successor starts after `token`.
+// Statements of a list cover its tokens in order, so this is a bisection.
+static int first_ending_after(const StmtArray* list, size_t base, size_t token) {
+    int lo = 0, hi = list->size;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (stmt_next(list->elements[mid], base) <= token) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static size_t count_below(const size_t* values, size_t size, size_t bound) {
+    size_t lo = 0, hi = size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (values[mid] < bound) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// A declaration reports its errors at its own tokens or, looking ahead, at
+// up to PARSER_LOOKAHEAD tokens past its end. An old diagnostic at old
+// token `boundary` or just after it could therefore belong to the
+// statement on either side, and a reparsed region may only begin or end at
+// a boundary that has none.
+static bool clean_boundary(const Reparser* self, size_t boundary) {
+    size_t i = count_below(self->errors, self->error_count, boundary);
+    return i == self->error_count || self->errors[i] >= boundary + PARSER_LOOKAHEAD;
+}
+
+// Replaces elements [first, first + removed) of `list` by `inserted`.
+static void splice_stmts(Arena* arena, StmtArray* list, int first, int removed, const StmtArray* inserted) {
+    int size = list->size - removed + inserted->size;
+    if (size > list->capacity) {
+        int capacity = list->capacity ? list->capacity : 1;
+        while (capacity < size) capacity *= 2;
+        Stmt** elements = (Stmt**)arena_alloc(arena, capacity * sizeof(Stmt*));
+        memcpy(elements, list->elements, list->size * sizeof(Stmt*));
+        list->elements = elements;
+        list->capacity = capacity;
+    }
+    memmove(list->elements + first + inserted->size, list->elements + first + removed,
+            (list->size - first - removed) * sizeof(Stmt*));
+    memcpy(list->elements + first, inserted->elements, inserted->size * sizeof(Stmt*));
+    list->size = size;
+}
+
+// Drops the diagnostics a failed attempt added.
+static void truncate_diagnostics(Diagnostics* diagnostics, size_t size) {
+    for (size_t i = size; i < diagnostics->size; i++) {
+        free(diagnostics->items[i].message);
+    }
+    diagnostics->size = size;
+}
+
+static bool reparse_list(Reparser* self, StmtArray* list, size_t base, size_t begin, size_t close);
+
+// Rebuilds a Block whose braces are both outside the edit around the
+// statements of its body that are. Returns NULL if the edit does not stay
+// inside the block, e.g. because it added or removed a brace.
+static Stmt* reparse_block(Reparser* self, Block* old, size_t base) {
+    size_t start = stmt_start(&old->base, base);
+    size_t end = stmt_end(&old->base, base);
+    if (start >= self->edit_start || end - 1 < self->edit_end) return NULL;
+
+    StmtArray body = create_stmt_array(self->arena, old->body->size + 1);
+    memcpy(body.elements, old->body->elements, old->body->size * sizeof(Stmt*));
+    body.size = old->body->size;
+
+    int replaced = self->result->replaced.size;
+    int reparsed = self->result->reparsed.size;
+    if (!reparse_list(self, &body, start, start + 1, end - 1 + self->shift)) {
+        self->result->replaced.size = replaced;
+        self->result->reparsed.size = reparsed;
+        return NULL;
+    }
+
+    Block* block = create_block(self->arena, &body);
+    block->base.range.first = old->base.range.first;
+    block->base.range.count = (uint32_t)(old->base.range.count + self->shift);
+    return (Stmt*)block;
+}
+
+// Updates the statements of `list` in place. Ranges in it are relative to
+// token `base`, which lies before the edit, and its first statement starts
+// at `begin`. `close` is the new index of the '}' ending a block body, or
+// SIZE_MAX for the top level, which ends at END_OF_FILE. Statements ending
+// before the edit are kept; the ones from the first statement that overlaps
+// it are parsed again until the parser lands on the start of an old
+// statement past the edit, and that statement and all after it are kept.
+// Both ends of the parsed region move outwards past statement boundaries
+// with old diagnostics at them (see clean_boundary), and the region is
+// recorded in `self`. A block body fails, leaving `list` untouched, if the
+// new statements do not end exactly at `close` or have syntax errors, or
+// its region cannot stay inside the body; its parent then reparses the
+// whole block.
+static bool reparse_list(Reparser* self, StmtArray* list, size_t base, size_t begin, size_t close) {
+    Parser* parser = self->parser;
+    bool nested = close != SIZE_MAX;
+
+    int first = first_ending_after(list, base, self->edit_start);
+    int next = first;
+    while (next < list->size && stmt_start(list->elements[next], base) < self->edit_end) next++;
+
+    StmtArray inserted = create_stmt_array(self->arena, 4);
+    size_t pos = first > 0 ? stmt_next(list->elements[first - 1], base) : begin;
+
+    Stmt* block = NULL;
+    if (next == first + 1 && list->elements[first]->type == STMT_BLOCK) {
+        block = reparse_block(self, (Block*)list->elements[first], base);
+    }
+
+    if (block) {
+        stmt_array_add(self->arena, &self->result->replaced, list->elements[first]);
+        stmt_array_add(self->arena, &self->result->reparsed, block);
+        stmt_array_add(self->arena, &inserted, block);
+    } else {
+        // The first statement of a top-level list has nothing before it. In
+        // a block body, the statement before the block may own errors there.
+        while (!clean_boundary(self, pos) && (first > 0 || nested)) {
+            if (first == 0) return false;
+            first--;
+            pos = first > 0 ? stmt_next(list->elements[first - 1], base) : begin;
+        }
+        self->region_start = pos;
+
+        size_t diagnostics = parser->diagnostics.size;
+        int replaced = self->result->replaced.size;
+        int reparsed = self->result->reparsed.size;
+        for (int i = first; i < next; i++) {
+            stmt_array_add(self->arena, &self->result->replaced, list->elements[i]);
+        }
+
+        parser_set_range(parser, pos, parser->end);
+        parser->base = base;
+        for (;;) {
+            while (next < list->size && stmt_start(list->elements[next], base) + self->shift < pos) {
+                stmt_array_add(self->arena, &self->result->replaced, list->elements[next++]);
+            }
+            if (next < list->size && stmt_start(list->elements[next], base) + self->shift == pos &&
+                clean_boundary(self, stmt_start(list->elements[next], base))) {
+                self->region_end = stmt_start(list->elements[next], base);
+                break;
+            }
+            if (!nested && parser_eof(parser)) {
+                self->region_end = SIZE_MAX;
+                break;
+            }
+
+            Stmt* stmt = NULL;
+            if (nested && pos == close) {
+                // The body ends here, unless old errors just past it may
+                // belong to its last statement.
+                if (clean_boundary(self, close - self->shift)) {
+                    self->region_end = close - self->shift;
+                    break;
+                }
+            } else if (!nested || !parser_check(parser, RBRACE)) {
+                size_t start = parser->current;
+                stmt = declaration(parser);
+                if (parser->current == start) parser_next(parser);
+            }
+            if (nested && (!stmt || parser->current > close || parser->diagnostics.size > diagnostics)) {
+                truncate_diagnostics(&parser->diagnostics, diagnostics);
+                self->result->replaced.size = replaced;
+                self->result->reparsed.size = reparsed;
+                return false;
+            }
+
+            stmt_array_add(self->arena, &inserted, stmt);
+            stmt_array_add(self->arena, &self->result->reparsed, stmt);
+            pos = parser->current;
+        }
+    }
+
+    for (int i = next; i < list->size; i++) {
+        list->elements[i]->range.first = (uint32_t)(list->elements[i]->range.first + self->shift);
+    }
+    splice_stmts(self->arena, list, first, next - first, &inserted);
+    return true;
+}
+
+CompilationUnit parse_editable(TokenArray* tokens) {
+    Parser* parser = create_parser(tokens);
+    parser->copy_literals = true;
+    CompilationUnit unit = parse(parser);
+    free_parser(parser);
+    return unit;
+}
+
+static int compare_indices(const void* a, const void* b) {
+    size_t lhs = *(const size_t*)a, rhs = *(const size_t*)b;
+    return lhs < rhs ? -1 : lhs > rhs;
+}
+
+// The old index of the token an old diagnostic at old byte `offset` was
+// reported at. Tokens before the splice kept their offsets and those after
+// it moved by `delta` bytes. One in the replaced tokens maps to the first
+// of them, the lowest index it could have had.
+static size_t old_token_index(const TokenArray* tokens, const TokenSplice* splice, uint32_t offset) {
+    size_t before = token_array_below(tokens, 0, splice->first, offset);
+    if (before < splice->first) return before;
+
+    size_t tail = splice->first + splice->inserted.size;
+    int64_t moved = (int64_t)offset + splice->delta;
+    if (moved < token_array_offset(tokens, tail)) return splice->first;
+    return splice->first + splice->removed + token_array_below(tokens, tail, tokens->size, (uint32_t)moved) - tail;
+}
+
+Reparse reparse(CompilationUnit* unit, TokenArray* tokens, const TokenSplice* splice) {
+    Reparse result;
+    result.replaced = create_stmt_array(unit->arena, 4);
+    result.reparsed = create_stmt_array(unit->arena, 4);
+
+    Parser* parser = create_parser(tokens);
+    parser->copy_literals = true;
+    parser->arena = unit->arena;
+
+    Diagnostics* old = &unit->diagnostics;
+    size_t* errors = (size_t*)malloc((old->size + 1) * sizeof(size_t));
+    if (!errors) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate reparser.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < old->size; i++) errors[i] = old_token_index(tokens, splice, old->items[i].offset);
+    qsort(errors, old->size, sizeof(size_t), compare_indices);
+
+    Reparser reparser;
+    reparser.parser = parser;
+    reparser.arena = unit->arena;
+    reparser.edit_start = splice->first;
+    reparser.edit_end = splice->first + splice->removed;
+    reparser.shift = (ptrdiff_t)splice->inserted.size - (ptrdiff_t)splice->removed;
+    reparser.errors = errors;
+    reparser.error_count = old->size;
+    reparser.region_start = 0;
+    reparser.region_end = SIZE_MAX;
+    reparser.result = &result;
+    reparse_list(&reparser, &unit->stmts, 0, 0, SIZE_MAX);
+    result.full = reparser.region_start == 0 && reparser.region_end == SIZE_MAX;
+    free(errors);
+
+    // Old diagnostics before the reparsed region stay where they are, those
+    // after it move with their tokens, and the ones in it are replaced by
+    // what the parser found there now.
+    Diagnostics diagnostics = create_diagnostics();
+    for (size_t i = 0; i < old->size; i++) {
+        size_t token = old_token_index(tokens, splice, old->items[i].offset);
+        if (token < reparser.region_start) {
+            diagnostics_add(&diagnostics, old->items[i].offset, "%s", old->items[i].message);
+        } else if (token >= reparser.region_end && reparser.region_end != SIZE_MAX) {
+            diagnostics_add(&diagnostics, (uint32_t)(old->items[i].offset + splice->delta), "%s", old->items[i].message);
+        }
+    }
+    for (size_t i = 0; i < parser->diagnostics.size; i++) {
+        diagnostics_add(&diagnostics, parser->diagnostics.items[i].offset, "%s", parser->diagnostics.items[i].message);
+    }
+
+    free_diagnostics(&unit->diagnostics);
+    unit->diagnostics = diagnostics;
+    free_parser(parser);
+    return result;
+}
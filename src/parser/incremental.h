@@ -0,0 +1,35 @@
+#ifndef NUUK_INCREMENTAL_H
+#define NUUK_INCREMENTAL_H
+
+#include "parser.h"
+#include "E:\THE_LANGUAGE\src\lexer\relex.h"
+
+// What reparse() changed. `replaced` holds the old statements that left the
+// tree and `reparsed` the new ones that took their place, at any depth; a
+// Block that was rebuilt around reused statements is in both, its reused
+// statements in neither. `full` is set if every top-level statement had to
+// be parsed again. The replaced nodes stay in the unit's arena.
+typedef struct Reparse {
+    StmtArray replaced;
+    StmtArray reparsed;
+    bool full;
+} Reparse;
+
+// Parses `tokens` like parse(), but copies literal text into the unit, since
+// nodes kept by reparse() outlive the source they were parsed from.
+CompilationUnit parse_editable(TokenArray* tokens);
+
+// Brings `unit` up to date after `splice` has been applied to `tokens` (see
+// apply_token_splice()). Top-level declarations and Block statements whose
+// tokens are untouched are kept, with their ranges moved past the edit;
+// only the statements overlapping the edit are parsed again, and a Block
+// with both braces outside the edit is reparsed statement by statement.
+// The unit's diagnostics are updated the same way: those of kept statements
+// are kept, moved with their tokens, and those of the reparsed region are
+// replaced. Since a statement may report errors just past its end, the
+// region is widened until no old diagnostic sits at its boundaries. Tokens
+// stored in kept nodes still carry the byte offsets of the parse that made
+// them; use the node ranges against `tokens` for current positions.
+Reparse reparse(CompilationUnit* unit, TokenArray* tokens, const TokenSplice* splice);
+
+#endif
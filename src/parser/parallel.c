@@ -0,0 +1,212 @@
+#include "parallel.h"
+
+#include <pthread.h>
+
+// A balancing scan over the token kinds cuts the array after every ';' or
+// '}' at bracket depth 0. In a well-formed file these are exactly the points
+// where a top-level declaration ends, and declarations parse without any
+// state from the ones before them, so consecutive declarations are grouped
+// into ranges that are parsed independently and concatenated in order.
+//
+// Every worker owns a Parser and an Arena and a deque of ranges, a
+// contiguous slice of the range list. It pops ranges off the front of its
+// own deque and, once that is empty, steals from the back of the others.
+//
+// If any range reports an error, the cuts may not have been declaration
+// boundaries after all, and recovery could differ from a sequential run, so
+// the whole file is parsed again by parse() to get exactly its diagnostics.
+
+typedef struct ParseRange {
+    size_t begin;
+    size_t end;
+    StmtArray stmts;
+} ParseRange;
+
+typedef struct ParseDeque {
+    pthread_mutex_t lock;
+    size_t front;
+    size_t back;
+} ParseDeque;
+
+typedef struct ParseWorker {
+    struct ParallelParse* job;
+    size_t index;
+    Parser* parser;
+    Arena* arena;
+} ParseWorker;
+
+typedef struct ParallelParse {
+    TokenArray* tokens;
+    ParseRange* ranges;
+    ParseDeque* deques;
+    ParseWorker* workers;
+    size_t count;
+} ParallelParse;
+
+// Returns the number of ranges written to `ranges` (at most `capacity`), or 0
+// if the brackets do not balance.
+static size_t split_declarations(const TokenArray* tokens, size_t target, ParseRange* ranges, size_t capacity) {
+    size_t end = tokens->size - 1;
+    size_t count = 0;
+    size_t begin = 0;
+    size_t depth = 0;
+
+    for (size_t i = 0; i < end; i++) {
+        switch (token_array_kind(tokens, i)) {
+            case LPAREN: case LBRACE: case LSQUARE:
+                depth++;
+                continue;
+            case RPAREN: case RSQUARE:
+                if (depth == 0) return 0;
+                depth--;
+                continue;
+            case RBRACE:
+                if (depth == 0) return 0;
+                depth--;
+                break;
+            case SEMICOLON:
+                break;
+            default:
+                continue;
+        }
+        if (depth > 0 || i + 1 - begin < target || count + 1 == capacity) continue;
+
+        ranges[count].begin = begin;
+        ranges[count].end = i + 1;
+        count++;
+        begin = i + 1;
+    }
+    if (depth > 0) return 0;
+
+    if (begin < end || count == 0) {
+        ranges[count].begin = begin;
+        ranges[count].end = end;
+        count++;
+    }
+    return count;
+}
+
+static bool pop_range(ParseDeque* deque, size_t* range) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->front < deque->back;
+    if (found) *range = deque->front++;
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool steal_range(ParseDeque* deque, size_t* range) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->front < deque->back;
+    if (found) *range = --deque->back;
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static bool next_range(ParseWorker* worker, size_t* range) {
+    ParallelParse* job = worker->job;
+    if (pop_range(&job->deques[worker->index], range)) return true;
+
+    for (size_t i = 1; i < job->count; i++) {
+        if (steal_range(&job->deques[(worker->index + i) % job->count], range)) return true;
+    }
+    return false;
+}
+
+static void parse_worker(void* arg) {
+    ParseWorker* worker = (ParseWorker*)arg;
+    ParallelParse* job = worker->job;
+
+    worker->arena = create_arena(0);
+    worker->parser = create_parser(job->tokens);
+    worker->parser->arena = worker->arena;
+
+    size_t index;
+    while (next_range(worker, &index)) {
+        ParseRange* range = &job->ranges[index];
+        parser_set_range(worker->parser, range->begin, range->end);
+        range->stmts = parse_declarations(worker->parser);
+    }
+}
+
+CompilationUnit parse_parallel(TokenArray* tokens, ThreadPool* pool) {
+    size_t threads = (size_t)thread_pool_size(pool);
+    size_t capacity = threads * PARALLEL_PARSE_RANGES_PER_THREAD;
+    ParseRange* ranges = NULL;
+    size_t range_count = 0;
+
+    if (threads > 1 && tokens->size / threads >= PARALLEL_PARSE_MIN_TOKENS) {
+        ranges = (ParseRange*)calloc(capacity, sizeof(ParseRange));
+        if (!ranges) {
+            fprintf(stderr, "FATAL ERROR: Failed to allocate parser ranges.\n");
+            exit(EXIT_FAILURE);
+        }
+        range_count = split_declarations(tokens, tokens->size / capacity, ranges, capacity);
+    }
+
+    if (range_count < 2) {
+        free(ranges);
+        Parser* parser = create_parser(tokens);
+        CompilationUnit unit = parse(parser);
+        free_parser(parser);
+        return unit;
+    }
+
+    ParallelParse job;
+    job.tokens = tokens;
+    job.ranges = ranges;
+    job.count = threads < range_count ? threads : range_count;
+    job.deques = (ParseDeque*)calloc(job.count, sizeof(ParseDeque));
+    job.workers = (ParseWorker*)calloc(job.count, sizeof(ParseWorker));
+    if (!job.deques || !job.workers) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate parser workers.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The datatype table is created lazily; do it before fanning out.
+    builtin_datatypes();
+
+    for (size_t i = 0; i < job.count; i++) {
+        pthread_mutex_init(&job.deques[i].lock, NULL);
+        job.deques[i].front = range_count * i / job.count;
+        job.deques[i].back = range_count * (i + 1) / job.count;
+        job.workers[i].job = &job;
+        job.workers[i].index = i;
+    }
+    // Workers steal from any deque, so all of them are set up first.
+    for (size_t i = 0; i < job.count; i++) thread_pool_submit(pool, parse_worker, &job.workers[i]);
+    thread_pool_wait(pool);
+
+    CompilationUnit unit;
+    unit.arena = create_arena(0);
+    unit.diagnostics = create_diagnostics();
+
+    bool failed = false;
+    int total = 0;
+    for (size_t i = 0; i < job.count; i++) {
+        if (job.workers[i].parser->diagnostics.size > 0) failed = true;
+        free_parser(job.workers[i].parser);
+        arena_adopt(unit.arena, job.workers[i].arena);
+        pthread_mutex_destroy(&job.deques[i].lock);
+    }
+    for (size_t i = 0; i < range_count; i++) total += ranges[i].stmts.size;
+
+    if (!failed) {
+        unit.stmts = create_stmt_array(unit.arena, total > 0 ? total : 1);
+        for (size_t i = 0; i < range_count; i++) {
+            memcpy(unit.stmts.elements + unit.stmts.size, ranges[i].stmts.elements, ranges[i].stmts.size * sizeof(Stmt*));
+            unit.stmts.size += ranges[i].stmts.size;
+        }
+    }
+
+    free(job.workers);
+    free(job.deques);
+    free(ranges);
+
+    if (failed) {
+        free_compilation_unit(&unit);
+        Parser* parser = create_parser(tokens);
+        unit = parse(parser);
+        free_parser(parser);
+    }
+    return unit;
+}
@@ -0,0 +1,15 @@
+#ifndef NUUK_PARALLEL_PARSER_H
+#define NUUK_PARALLEL_PARSER_H
+
+#include "parser.h"
+#include "E:\THE_LANGUAGE\src\utils\pool.h"
+
+// Inputs with fewer tokens than this per worker are parsed sequentially.
+#define PARALLEL_PARSE_MIN_TOKENS (64 * 1024)
+#define PARALLEL_PARSE_RANGES_PER_THREAD 8
+
+// Parses a materialized token array on `pool` and returns the same unit
+// parse() would, diagnostics included.
+CompilationUnit parse_parallel(TokenArray* tokens, ThreadPool* pool);
+
+#endif
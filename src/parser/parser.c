@@ -1,42 +1,119 @@
 
 #include "E:\THE_LANGUAGE\src\parser\parser.h"
 
+#include <errno.h>
+#include <pthread.h>
+
+static SymbolTable* builtins;
+static pthread_once_t builtins_once = PTHREAD_ONCE_INIT;
+
+static void create_builtin_datatypes() {
+    static const char* const names[] = { "int", "float", "double", "bool", "char", "usize", "isize", "uint" };
+    SymbolTable* table = create_symbol_table(NULL);
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        Atom name = intern_cstr(names[i]);
+        symbol_declare(table, name, SYMBOL_TYPE, basic_type(name));
+    }
+    builtins = table;
+}
+
+const SymbolTable* builtin_datatypes() {
+    pthread_once(&builtins_once, create_builtin_datatypes);
+    return builtins;
+}
+
 Parser* create_parser(TokenArray* tokens) {
     Parser* parser = (Parser*)malloc(sizeof(Parser));
     parser->tokens = tokens;
-    
-    SymbolTable* table = create_symbol_table();
-    symbol_insert(table, "int");
-    symbol_insert(table, "float");
-    symbol_insert(table, "double");
-    symbol_insert(table, "bool");
-    symbol_insert(table, "char");
-    symbol_insert(table, "usize");
-    symbol_insert(table, "isize");
-    symbol_insert(table, "uint");
-
-    parser->datatypes = table;
+    parser->lexer = NULL;
+    parser->lines = tokens ? &tokens->lines : NULL;
+    parser->arena = NULL;
+    parser->pulled = 0;
+    parser->end = tokens && tokens->size > 0 ? tokens->size - 1 : 0;
+    parser->diagnostics = create_diagnostics();
+    parser->panic = false;
+    parser->copy_literals = false;
+    parser->symbols = create_symbol_table(builtin_datatypes());
 
     parser->current = 0;
+    parser->base = 0;
+    return parser;
+}
+
+// Fuses lexing into parsing: tokens are scanned only when the parser first
+// looks at them, so token memory stays O(PARSER_WINDOW).
+Parser* create_streaming_parser(Lexer* lexer) {
+    Parser* parser = create_parser(NULL);
+    parser->lexer = lexer;
+    parser->lines = &lexer->tokens.lines;
     return parser;
 }
 
-StmtArray parse(Parser* self) {
-    StmtArray stmts = create_stmt_array(2);
+// Frees the parser itself; the token source and the AST are not touched.
+void free_parser(Parser* self) {
+    free_symbol_table(self->symbols);
+    free_diagnostics(&self->diagnostics);
+    free(self);
+}
+
+// Restricts an array parser to tokens [begin, end): it restarts at `begin`
+// and sees END_OF_FILE at `end`. Used to parse a slice of declarations.
+// The token before `begin` is loaded too, so parser_back() sees what a parser
+// coming from the start would have seen.
+void parser_set_range(Parser* self, size_t begin, size_t end) {
+    self->current = begin;
+    self->pulled = begin;
+    if (begin > 0) self->window[(begin - 1) % PARSER_WINDOW] = token_array_get(self->tokens, begin - 1);
+    self->end = end;
+    self->base = 0;
+    self->panic = false;
+}
+
+// Parses the whole input into a new compilation unit. Nodes are allocated
+// from `self->arena`, which is created here and handed over to the unit,
+// together with every syntax error found on the way.
+CompilationUnit parse(Parser* self) {
+    CompilationUnit unit;
+    unit.arena = create_arena(0);
+    self->arena = unit.arena;
+
+    unit.stmts = parse_declarations(self);
+
+    unit.diagnostics = self->diagnostics;
+    self->diagnostics = create_diagnostics();
+    self->panic = false;
+    self->arena = NULL;
+    return unit;
+}
+
+// Parses declarations up to END_OF_FILE into `self->arena`.
+StmtArray parse_declarations(Parser* self) {
+    StmtArray stmts = create_stmt_array(self->arena, 2);
     while (!parser_eof(self)) {
+        size_t start = self->current;
         Stmt* stmt = declaration(self);
+        // A stray '}' fails without consuming anything.
+        if (self->current == start) parser_next(self);
         if (!stmt) {
-            fprintf(stderr, "%s ERROR: NULL statement encountered.\n", location(parser_current(self)));
+            fprintf(stderr, "%s ERROR: NULL statement encountered.\n", location(self->lines, parser_current(self)));
             exit(1);
         }
-        stmt_array_add(&stmts, stmt);
+        stmt_array_add(self->arena, &stmts, stmt);
         //parser_next(self);
     }
-
-    printf("Parser finished!\n");
     return stmts;
 }
 
+// Releases every node and datatype of the unit in one step.
+void free_compilation_unit(CompilationUnit* unit) {
+    free_diagnostics(&unit->diagnostics);
+    free_arena(unit->arena);
+    unit->arena = NULL;
+    unit->stmts.elements = NULL;
+    unit->stmts.capacity = 0;
+    unit->stmts.size = 0;
+}
+
 
 bool parser_expect(Parser* self, int count, ...) {
     va_list args;
@@ -69,13 +146,29 @@ bool parser_eof(Parser* self) {
     return parser_peek(self, 0)->type == END_OF_FILE;
 }
 
+// Produces token number `self->pulled`. From `end` on an array parser keeps
+// returning END_OF_FILE, like a lexer does.
+static Token parser_pull(Parser* self) {
+    if (self->lexer) return lexer_next_token(self->lexer);
+    if (self->pulled < self->end) return token_array_get(self->tokens, self->pulled);
+
+    Token eof = create_token(END_OF_FILE, NULL, 0);
+    eof.offset = token_array_offset(self->tokens, self->end);
+    return eof;
+}
+
 Token* parser_peek(Parser* self, size_t offset) {
-    Token* token = token_array_get(self->tokens, self->current + offset);
-    if (!token) {
-        fprintf(stderr, "%s ERROR: Peeked into oblivion.\n", location(parser_current(self)));
+    if (offset >= PARSER_LOOKAHEAD) {
+        fprintf(stderr, "FATAL ERROR: Lookahead of %zu exceeds the parser window.\n", offset);
         exit(EXIT_FAILURE);
     }
-    return token;
+    while (self->pulled <= self->current + offset) {
+        Token token = parser_pull(self);
+        if (token.type == ILLEGAL) diagnostics_add(&self->diagnostics, token.offset, "%s", lexer_error_message(&token));
+        self->window[self->pulled % PARSER_WINDOW] = token;
+        self->pulled++;
+    }
+    return &self->window[(self->current + offset) % PARSER_WINDOW];
 }
 
 Token* parser_current(Parser* self) {
@@ -83,28 +176,90 @@ Token* parser_current(Parser* self) {
 }
 
 Token* parser_back(Parser* self) {
-    Token* token = token_array_get(self->tokens, self->current - 1);
-    if (!token) {
-        fprintf(stderr, "%s ERROR: Failed to re-read previous token.\n", location(parser_current(self)));
+    if (self->current == 0) {
+        fprintf(stderr, "FATAL ERROR: Failed to re-read previous token.\n");
         exit(EXIT_FAILURE);
     }
-    return token;
+    return &self->window[(self->current - 1) % PARSER_WINDOW];
 }
 
+// On a mismatch this reports the error and returns the current token without
+// consuming it, so the caller can carry on until the parser resynchronizes.
 Token* parser_consume(Parser* self, TokenType type, const char* msg) {
     if (parser_check(self, type)) return parser_next(self);
-    fprintf(stderr, "%s ERROR: Unexpected Token '%s': %s", location(parser_current(self)), parser_current(self)->value, msg);
-    exit(1);
+    parser_error(self, parser_current(self), "Unexpected Token '" TOKEN_FMT "': %s", TOKEN_ARG(parser_current(self)), msg);
+    return parser_current(self);
+}
+
+// Records an error at `token` unless the parser is already recovering from
+// one in the same declaration. An ILLEGAL token was reported when it was
+// pulled, so an error at it only starts the recovery.
+void parser_error(Parser* self, const Token* token, const char* fmt, ...) {
+    if (self->panic) return;
+    self->panic = true;
+    if (token->type == ILLEGAL) return;
+
+    va_list args;
+    va_start(args, fmt);
+    diagnostics_vadd(&self->diagnostics, token->offset, fmt, args);
+    va_end(args);
+}
+
+static bool starts_declaration(Parser* self, Token* token) {
+    switch (token->type) {
+        case CONST: case RETURN: case IMPORT: case EXPAND: case USE:
+        case DEF: case STRUCT: case ENUM: case UNION: case STATIC: case EXTERN: case MACRO:
+        case IF: case WHILE: case FOR: case FOREACH: case SWITCH:
+            return true;
+        default:
+            return is_datatype(self, token);
+    }
+}
+
+// Leaves panic mode by skipping tokens up to just past a ';', or up to a '}'
+// or the start of the next declaration.
+void parser_synchronize(Parser* self) {
+    self->panic = false;
+
+    while (!parser_eof(self)) {
+        if (self->current > 0 && parser_back(self)->type == SEMICOLON) return;
+
+        Token* token = parser_current(self);
+        if (token->type == RBRACE || starts_declaration(self, token)) return;
+        parser_next(self);
+    }
 }
 
+// Stands in for an operand that could not be parsed.
+static Expr* error_expr(Parser* self) {
+    return (Expr*)create_literal(self->arena, LITERAL_ERROR, "", 0);
+}
+
+
+// The range of a node that began at token `start` and ends at the last
+// token consumed.
+static TokenRange node_range(Parser* self, size_t start) {
+    return (TokenRange){ (uint32_t)(start - self->base), (uint32_t)(self->current - start) };
+}
 
 Stmt* declaration(Parser* self) {
     // TODO: variable declarations, ...
-    if (parser_check(self, CONST) || symbol_lookup(self->datatypes, parser_current(self)->value)) {
-        return variable_decl(self);
+    size_t start = self->current;
+    size_t parent = self->base;
+    self->base = start;
+
+    Stmt* stmt;
+    if (parser_check(self, CONST) || is_datatype(self, parser_current(self))) {
+        stmt = variable_decl(self);
+    } else {
+        stmt = statement(self);
     }
-    
-    return statement(self);
+
+    if (self->panic) parser_synchronize(self);
+
+    self->base = parent;
+    stmt->range = node_range(self, start);
+    return stmt;
 }
 
 Stmt* variable_decl(Parser* self) {
@@ -114,39 +269,34 @@ Stmt* variable_decl(Parser* self) {
         parser_next(self);
     }
 
-    if (!symbol_lookup(self->datatypes, parser_current(self)->value)) {
-        fprintf(stderr, "%s ERROR: Invalid Datatype '%s'. Expected variable declaration after 'const'.\n", location(parser_current(self)), parser_current(self)->value);
-        exit(1);
-    } else {
-        Datatype* type = datatype(self, parser_current(self));
-        parser_next(self);
-        Token* name = parser_consume(self, IDENTIFIER, "Expected identifier after variable declaration.\n");
-
-        if (parser_current(self)->type != ASSIGN) {
-            parser_consume(self, SEMICOLON, "Expected ';' after variable declaration.\n");
-            return (Stmt*)create_variable_stmt(mutability, type, name, NULL);
-        } else {
-            parser_consume(self, ASSIGN, "Expected '=' after variable declaration.\n");
-            Expr* value = expression(self);
-            parser_consume(self, SEMICOLON, "Expected ';' after variable declaration.\n");
-            return (Stmt*)create_variable_stmt(mutability, type, name, value);
-        }
+    if (!is_datatype(self, parser_current(self))) {
+        parser_error(self, parser_current(self), "Invalid Datatype '" TOKEN_FMT "'. Expected variable declaration after 'const'.", TOKEN_ARG(parser_current(self)));
+        return (Stmt*)create_expression(self->arena, error_expr(self));
+    }
+
+    Datatype* type = datatype(self, parser_current(self));
+    parser_next(self);
+    Token name = *parser_consume(self, IDENTIFIER, "Expected identifier after variable declaration.");
+    if (name.type == IDENTIFIER) symbol_declare(self->symbols, name.atom, SYMBOL_VARIABLE, type);
+
+    if (parser_current(self)->type != ASSIGN) {
+        parser_consume(self, SEMICOLON, "Expected ';' after variable declaration.");
+        return (Stmt*)create_variable_stmt(self->arena, mutability, type, name, NULL);
     }
 
-    fprintf(stderr, "%s ERROR: Invalid token while parsing variable declaration: '%s'.\n", location(parser_current(self)), parser_current(self)->value);
-    exit(1);
+    parser_consume(self, ASSIGN, "Expected '=' after variable declaration.");
+    Expr* value = expression(self);
+    parser_consume(self, SEMICOLON, "Expected ';' after variable declaration.");
+    return (Stmt*)create_variable_stmt(self->arena, mutability, type, name, value);
 }
 
 Stmt* statement(Parser* self) {
     
-    if (parser_expect(self, LBRACE)) return block(self);
-
-    printf("parsing: %s\n", parser_current(self)->value);
+    if (parser_expect(self, 1, LBRACE)) return block(self);
 
     // TODO: for, while, return, ...
 
     if (parser_check(self, RETURN)) {
-        printf("parsing return!!!\n");
         return return_stmt(self);
     }
 
@@ -171,237 +321,269 @@ Stmt* return_stmt(Parser* self) {
     parser_next(self);
     Expr* expr = expression(self);
     parser_consume(self, SEMICOLON, "Expected ';' after return statement.");
-    return (Stmt*)create_return(expr);
+    return (Stmt*)create_return(self->arena, expr);
 }
 
 Stmt* import_stmt(Parser* self) {
     parser_next(self);
     Expr* expr = expression(self);
     parser_consume(self, SEMICOLON, "Expected ';' after import statement.");
-    return (Stmt*)create_import(expr);
+    return (Stmt*)create_import(self->arena, expr);
 }
 
 Stmt* expand_stmt(Parser* self) {
     parser_next(self);
     Expr* expr = expression(self);
     parser_consume(self, SEMICOLON, "Expected ';' after expand statement.");
-    return (Stmt*)create_expand(expr);
+    return (Stmt*)create_expand(self->arena, expr);
 }
 
 Stmt* use_stmt(Parser* self) {
     parser_next(self);
     Expr* expr = expression(self);
     parser_consume(self, SEMICOLON, "Expected ';' after use statement.");
-    return (Stmt*)create_use(expr);
+    return (Stmt*)create_use(self->arena, expr);
 }
 
 Stmt* block(Parser* self) {
-    StmtArray stmts = create_stmt_array(2);
+    StmtArray stmts = create_stmt_array(self->arena, 2);
+    symbol_push_scope(self->symbols);
 
     while (!parser_check(self, RBRACE) && !parser_eof(self)) {
-        stmt_array_add(&stmts, declaration(self));
+        size_t start = self->current;
+        stmt_array_add(self->arena, &stmts, declaration(self));
+        if (self->current == start) parser_next(self);
     }
 
+    symbol_pop_scope(self->symbols);
     parser_consume(self, RBRACE, "Expected '}' after block.");
-    return (Stmt*)create_block(&stmts);
+    return (Stmt*)create_block(self->arena, &stmts);
 }
 
 Stmt* expression_stmt(Parser* self) {
     Expr* expr = expression(self);
     parser_consume(self, SEMICOLON, "Expected ';' after expression.");
-    Stmt* stmt = (Stmt*)create_expression(expr);
+    Stmt* stmt = (Stmt*)create_expression(self->arena, expr);
     if (!stmt) {
-        fprintf(stderr, "%s FATAL ERROR: Failed to create expression statement.\n", location(parser_current(self)));
+        fprintf(stderr, "%s FATAL ERROR: Failed to create expression statement.\n", location(self->lines, parser_current(self)));
         exit(1);
     }
     return stmt;
 }
 
 
+// Binding powers of the infix and postfix operators, indexed by TokenType.
+// A token with a left power of 0 ends the expression. Left-associative
+// operators bind their right operand one tighter than themselves,
+// right-associative ones (assignment) one looser. Postfix operators ('(',
+// '.', '::') have no right operand and bind tighter than any prefix one.
+typedef struct BindingPower {
+    uint8_t left;
+    uint8_t right;
+} BindingPower;
+
+#define PREFIX_POWER 15
+#define POSTFIX_POWER 17
+
+static const BindingPower binding_powers[END_OF_FILE + 1] = {
+    [ASSIGN] = { 2, 1 }, [PLUS_EQ] = { 2, 1 }, [MINUS_EQ] = { 2, 1 }, [STAR_EQ] = { 2, 1 }, [SLASH_EQ] = { 2, 1 },
+    [OR] = { 3, 4 },
+    [AND] = { 5, 6 },
+    [EQ] = { 7, 8 }, [NEQ] = { 7, 8 },
+    [LT] = { 9, 10 }, [GT] = { 9, 10 }, [LTE] = { 9, 10 }, [GTE] = { 9, 10 },
+    [PLUS] = { 11, 12 }, [MINUS] = { 11, 12 },
+    [STAR] = { 13, 14 }, [SLASH] = { 13, 14 }, [MOD] = { 13, 14 },
+    [LPAREN] = { POSTFIX_POWER, 0 }, [DOT] = { POSTFIX_POWER, 0 }, [COLON_COLON] = { POSTFIX_POWER, 0 },
+};
+
+static const bool prefix_operators[END_OF_FILE + 1] = {
+    [BANG] = true, [AMPERSAND] = true, [STAR] = true, [MINUS] = true, [AT] = true,
+};
+
 Expr* expression(Parser* self) {
-    return assignment(self);
+    return parse_precedence(self, 0);
 }
 
-Expr* assignment(Parser* self) {
-    Expr* expr = or(self);
+// Parses an operand, then keeps folding in operators that bind tighter than
+// `power`. Every operand costs one prefix step and one table lookup per
+// operator, however deep the precedence level of its operator is.
+Expr* parse_precedence(Parser* self, uint8_t power) {
+    size_t start = self->current;
+    Expr* expr = unary(self);
+    expr->range = node_range(self, start);
 
-    if (parser_expect(self, 5, ASSIGN, PLUS_EQ, MINUS_EQ, STAR_EQ, SLASH_EQ)) {
-        Token* eq = parser_back(self);
-        Expr* val = assignment(self);
-        
-        if (expr->type == EXPR_VARIABLE) {
-            Variable* var = (Variable*)expr;
-            return (Expr*)create_assign(var->name, val);
-        }
+    for (;;) {
+        Token* token = parser_current(self);
+        BindingPower bp = binding_powers[token->type];
+        if (bp.left <= power) break;
 
-        fprintf(stderr, "%s ERROR: Invalid assignment target: '%s'.", location(eq), eq->value);
-        exit(EXIT_FAILURE);
+        Token op = *parser_next(self);
+        switch (op.type) {
+            case LPAREN:
+                expr = call(self, expr);
+                break;
+            case DOT: {
+                Token* property = parser_consume(self, IDENTIFIER, "Expected property name after '.'.");
+                expr = (Expr*)create_get(self->arena, expr, *property);
+                break;
+            }
+            case COLON_COLON: {
+                // Scope access stays a Binary node whose rhs is the name.
+                Token* name = parser_consume(self, IDENTIFIER, "Expected name after '::'.");
+                Expr* rhs = (Expr*)create_variable(self->arena, *name);
+                rhs->range = node_range(self, self->current - 1);
+                expr = (Expr*)create_binary(self->arena, expr, op, rhs);
+                break;
+            }
+            case OR: case AND: {
+                Expr* rhs = parse_precedence(self, bp.right);
+                expr = (Expr*)create_logical(self->arena, expr, op, rhs);
+                break;
+            }
+            case ASSIGN: case PLUS_EQ: case MINUS_EQ: case STAR_EQ: case SLASH_EQ: {
+                Expr* value = parse_precedence(self, bp.right);
+                if (expr->type != EXPR_VARIABLE) {
+                    parser_error(self, &op, "Invalid assignment target: '" TOKEN_FMT "'.", TOKEN_ARG(&op));
+                    break;
+                }
+                expr = (Expr*)create_assign(self->arena, ((Variable*)expr)->name, op, value);
+                break;
+            }
+            default: {
+                Expr* rhs = parse_precedence(self, bp.right);
+                expr = (Expr*)create_binary(self->arena, expr, op, rhs);
+                break;
+            }
+        }
+        expr->range = node_range(self, start);
     }
 
     return expr;
 }
 
-Expr* or(Parser* self) {
-    Expr* expr = and(self);
-
-    while (parser_expect(self, 1, OR)) {
-        Token* op = parser_back(self);
-        Expr* rhs = and(self);
-        expr = (Expr*)create_logical(expr, *op, rhs);
+Expr* unary(Parser* self) {
+    if (prefix_operators[parser_current(self)->type]) {
+        Token op = *parser_next(self);
+        Expr* rhs = parse_precedence(self, PREFIX_POWER);
+        return (Expr*)create_unary(self->arena, op, rhs);
     }
 
-    return expr;
+    return primary(self);
 }
 
-Expr* and(Parser* self) {
-    Expr* expr = equality(self);
-
-    while (parser_expect(self, 1, AND)) {
-        Token* op = parser_back(self);
-        Expr* rhs = equality(self);
-        expr = (Expr*)create_logical(expr, *op, rhs);
+// Builds the literal of a NUMBER, STRING or CHAR token. Numbers are
+// converted here, so malformed ones and ones that do not fit in an int64 or
+// a double are reported as syntax errors.
+static Expr* token_literal(Parser* self, const Token* token) {
+    const char* text = token->start;
+    if (self->copy_literals) text = arena_strndup(self->arena, token->start, token->length);
+
+    if (token->type == STRING) {
+        Literal* literal = create_literal(self->arena, LITERAL_STRING, text, token->length);
+        literal->offset = token->offset;
+        return (Expr*)literal;
     }
-
-    return expr;
-}
-
-Expr* equality(Parser* self) {
-    Expr* expr = comparison(self);
-
-    while (parser_expect(self, 2, NEQ, EQ)) {
-        Token* op = parser_back(self);
-        Expr* rhs = comparison(self);
-        expr = (Expr*)create_binary(expr, *op, rhs);
+    if (token->type == CHAR) {
+        Literal* literal = create_literal(self->arena, LITERAL_CHAR, text, token->length);
+        literal->offset = token->offset;
+        literal->as.character = text[0];
+        return (Expr*)literal;
     }
-    
-    return expr;
-}
-
-Expr* comparison(Parser* self) {
-    Expr* expr = term(self);
 
-    while (parser_expect(self, 4, GT, LT, LTE, GTE)) {
-        Token* op = parser_back(self);
-        Expr* rhs = term(self);
-        expr = (Expr*)create_binary(expr, *op, rhs);
+    char digits[64];
+    if (token->length >= sizeof(digits)) {
+        parser_error(self, token, "Number literal '" TOKEN_FMT "' is too long.", TOKEN_ARG(token));
+        return error_expr(self);
     }
-
-    return expr;
-}
-
-Expr* term(Parser* self) {
-    Expr* expr = factor(self);
-
-    while (parser_expect(self, 2, MINUS, PLUS)) {
-        Token* op = parser_back(self);
-        Expr* rhs = factor(self);
-        Expr* new_expr = (Expr*)create_binary(expr, *op, rhs);
-        if (!new_expr) {
-            fprintf(stderr, "%s FATAL ERROR: Failed to create new binary expression.\n", location(parser_current(self)));
-            exit(1);
-        }
-        expr = new_expr;
+    memcpy(digits, text, token->length);
+    digits[token->length] = '\0';
+
+    char* end;
+    errno = 0;
+    Literal* literal;
+    if (memchr(digits, '.', token->length)) {
+        literal = create_literal(self->arena, LITERAL_FLOAT, text, token->length);
+        literal->as.number = strtod(digits, &end);
+    } else {
+        literal = create_literal(self->arena, LITERAL_INT, text, token->length);
+        literal->as.integer = strtoll(digits, &end, 10);
     }
+    literal->offset = token->offset;
 
-    return expr;
-}
-
-Expr* factor(Parser* self) {
-    Expr* expr = unary(self);
-
-    while (parser_expect(self, 2, SLASH, STAR)) {
-        Token* op = parser_back(self);
-        Expr* rhs = unary(self);
-        expr = (Expr*)create_binary(expr, *op, rhs);
+    if (end != digits + token->length) {
+        parser_error(self, token, "Malformed number literal '" TOKEN_FMT "'.", TOKEN_ARG(token));
+        return error_expr(self);
     }
-
-    return expr;
-}
-
-Expr* unary(Parser* self) {
-    if (parser_expect(self, 4, BANG, AMPERSAND, STAR, MINUS)) {
-        Token* op = parser_back(self);
-        Expr* rhs = unary(self);
-        return (Expr*)create_unary(*op, rhs);
+    if (errno == ERANGE) {
+        parser_error(self, token, "Number literal '" TOKEN_FMT "' is out of range.", TOKEN_ARG(token));
+        return error_expr(self);
     }
-
-    return primary(self);
+    return (Expr*)literal;
 }
 
 Expr* primary(Parser* self) {
-    if (parser_expect(self, 1, FALSE)) {
-        return (Expr*)create_literal("false");
-    }
-    
-    if (parser_expect(self, 1, TRUE)) {
-        return (Expr*)create_literal("true");
-    }
-
-    if (parser_expect(self, 2, NUMBER, STRING)) {
-        return (Expr*)create_literal(parser_back(self)->value);
-    }
-
-    if (parser_expect(self, 1, IDENTIFIER)) {
-        Expr* expr = (Expr*)create_variable(*parser_back(self));
-
-        for (;;) {
-            if (parser_expect(self, 1, DOT)) {
-                Token* property = parser_consume(self, IDENTIFIER, "Expected property name after '.'.");
-                expr = (Expr*)create_get(expr, *property);
-            }  else if (parser_check(self, LPAREN)) {
-                expr = call(self, expr);
-            } else {
-                break;
-            }
+    Token* token = parser_current(self);
+    switch (token->type) {
+        case FALSE: case TRUE: {
+            bool value = token->type == TRUE;
+            uint32_t offset = parser_next(self)->offset;
+            Literal* literal = create_literal(self->arena, LITERAL_BOOL, value ? "true" : "false", value ? 4 : 5);
+            literal->offset = offset;
+            literal->as.boolean = value;
+            return (Expr*)literal;
         }
-
-
-        return expr;
-    }
-
-    if (parser_expect(self, 1, LPAREN)) {
-        Expr* expr = expression(self);
-        parser_consume(self, RPAREN, "Expected ')' after grouping expression.");
-        return (Expr*)create_grouping(expr);
+        case NUMBER: case STRING: case CHAR:
+            return token_literal(self, parser_next(self));
+        case IDENTIFIER:
+            return (Expr*)create_variable(self->arena, *parser_next(self));
+        case LPAREN: {
+            parser_next(self);
+            Expr* expr = expression(self);
+            parser_consume(self, RPAREN, "Expected ')' after grouping expression.");
+            return (Expr*)create_grouping(self->arena, expr);
+        }
+        default:
+            break;
     }
 
-    fprintf(stderr, "%s ERROR: Expected expression, got: '%s'.\n", location(parser_current(self)), parser_current(self)->value);
-    exit(1);
+    parser_error(self, parser_current(self), "Expected expression, got: '" TOKEN_FMT "'.", TOKEN_ARG(parser_current(self)));
+    return error_expr(self);
 }
 
+// Parses the arguments of a call; the '(' has already been consumed.
 Expr* call(Parser* self, Expr* callee) {
-    parser_consume(self, LPAREN, "Expect '(' after function name.");
-    ExprArray args = create_expr_array(2);
+    ExprArray args = create_expr_array(self->arena, 2);
 
     if (!parser_check(self, RPAREN)) {
         for (;;) {
-            if (args.size + 1 <= 255) {
-                expr_array_add(&args, expression(self));
-            } else {
-                fprintf(stderr, "%s ERROR: Maximum amount of arguments reached (max. 255).\n", location(parser_current(self)));
-                exit(1);
-            } 
+            if (args.size + 1 > 255) {
+                parser_error(self, parser_current(self), "Maximum amount of arguments reached (max. 255).");
+            }
+            expr_array_add(self->arena, &args, expression(self));
 
             if (!parser_expect(self, 1, COMMA)) break;
 
             if (parser_check(self, RPAREN)) {
-                fprintf(stderr, "%s ERROR: Trailing comma in function call.\n", location(parser_current(self)));
-                exit(1);
+                parser_error(self, parser_current(self), "Trailing comma in function call.");
+                break;
             }
         }
     }
 
     parser_consume(self, RPAREN, "Expected ')' after function arguments.");
-    return (Expr*)create_call(callee, args);
+    return (Expr*)create_call(self->arena, callee, args);
+}
+
+bool is_datatype(Parser* parser, Token* token) {
+    return token->type == IDENTIFIER && symbol_lookup(parser->symbols, token->atom, SYMBOL_TYPE);
 }
 
 Datatype* datatype(Parser* parser, Token* token) {
-    if (!symbol_lookup(parser->datatypes, token->value)) {
-        fprintf(stderr, "%s ERROR: Invalid Datatype '%s'!\n", location(parser_current(parser)), token->value);
-        exit(EXIT_FAILURE);
+    if (!is_datatype(parser, token)) {
+        parser_error(parser, token, "Invalid Datatype '" TOKEN_FMT "'!", TOKEN_ARG(token));
     }
 
-    Datatype* base = basic_type(token->value);
+    Datatype* base = basic_type(token->atom);
 
     while (parser_peek(parser, 1)->type == STAR) {
         parser_next(parser);
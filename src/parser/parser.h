@@ -3,17 +3,66 @@
 #define NUUK_PARSER_H
 
 #include "E:\THE_LANGUAGE\src\parser\ast.h"
+#include "E:\THE_LANGUAGE\src\lexer\lexer.h"
+#include "E:\THE_LANGUAGE\src\utils\diagnostics.h"
+#include "E:\THE_LANGUAGE\src\utils\symbols.h"
 #include <stdarg.h>
 #include <stdbool.h>
 
+// Deepest parser_peek offset the grammar uses, plus one slot for parser_back.
+#define PARSER_LOOKAHEAD 2
+#define PARSER_WINDOW 4
+
+// A parser reads either a materialized TokenArray or pulls tokens on demand
+// from a Lexer. Either way tokens pass through a ring buffer of PARSER_WINDOW
+// expanded tokens, so a Token* from parser_peek/parser_back is only valid
+// until the parser advances again and anything kept longer must be copied.
+// An array parser only reads tokens up to `end`, where it sees END_OF_FILE;
+// see parser_set_range().
+// `lines` is the line table of the source, for diagnostics, and `arena` is
+// where new nodes are allocated. `symbols` holds the variables declared so
+// far, one scope per enclosing block, over the builtin types. `base` is the first token of the statement
+// being parsed, which node ranges are relative to. With `copy_literals` set
+// literal text is copied into the arena instead of pointing into the source.
+//
+// Syntax errors do not stop the parser. The first error of a declaration is
+// recorded in `diagnostics` and puts the parser in `panic` mode, which
+// silences follow-up errors until declaration() resynchronizes on the next
+// ';', '}' or declaration keyword. Lexical errors arrive as ILLEGAL tokens
+// and are recorded in `diagnostics` too, whatever the mode.
 typedef struct Parser {
     TokenArray* tokens;
-    SymbolTable* datatypes;
+    Lexer* lexer;
+    const LineTable* lines;
+    Arena* arena;
+    Token window[PARSER_WINDOW];
+    size_t pulled;
+    size_t end;
+    SymbolTable* symbols;
     size_t current;
+    size_t base;
+    Diagnostics diagnostics;
+    bool panic;
+    bool copy_literals;
 } Parser;
 
+// The AST of one source. Every node reachable from `stmts` lives in
+// `arena`; datatypes are canonical and shared (see ast.h). If `diagnostics`
+// is not empty the source had syntax errors and `stmts` is only a
+// best-effort tree that must not be evaluated.
+typedef struct CompilationUnit {
+    Arena* arena;
+    StmtArray stmts;
+    Diagnostics diagnostics;
+} CompilationUnit;
+
 Parser* create_parser(TokenArray* tokens);
-StmtArray parse(Parser* self);
+Parser* create_streaming_parser(Lexer* lexer);
+void free_parser(Parser* self);
+void parser_set_range(Parser* self, size_t begin, size_t end);
+CompilationUnit parse(Parser* self);
+StmtArray parse_declarations(Parser* self);
+void free_compilation_unit(CompilationUnit* unit);
 
 bool parser_expect(Parser* self, int count, ...);
 bool parser_check(Parser* self, TokenType type);
@@ -23,6 +72,8 @@ Token* parser_peek(Parser* self, size_t offset);
 Token* parser_current(Parser* self);
 Token* parser_back(Parser* self);
 Token* parser_consume(Parser* self, TokenType type, const char* msg);
+void parser_error(Parser* self, const Token* token, const char* fmt, ...);
+void parser_synchronize(Parser* self);
 
 Stmt* declaration(Parser* self);
 Stmt* statement(Parser* self);
@@ -35,16 +86,15 @@ Stmt* expand_stmt(Parser* self);
 Stmt* use_stmt(Parser* self);
 Stmt* variable_decl(Parser* self);
 
+// The root scope of every parser, holding the builtin datatype names. It is
+// built once and only read afterwards, so parsers on different threads
+// share it.
+const SymbolTable* builtin_datatypes();
+bool is_datatype(Parser* parser, Token* token);
 Datatype* datatype(Parser* parser, Token* token);
 
 Expr* expression(Parser* self);
-Expr* assignment(Parser* self);
-Expr* or(Parser* self);
-Expr* and(Parser* self);
-Expr* equality(Parser* self);
-Expr* comparison(Parser* self);
-Expr* term(Parser* self);
-Expr* factor(Parser* self);
+Expr* parse_precedence(Parser* self, uint8_t power);
 Expr* unary(Parser* self);
 Expr* primary(Parser* self);
 Expr* call(Parser* self, Expr* callee);
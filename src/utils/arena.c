@@ -0,0 +1,94 @@
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+
+static ArenaBlock* create_arena_block(size_t size, ArenaBlock* next) {
+    ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+    if (!block) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate arena block.\n");
+        exit(EXIT_FAILURE);
+    }
+    block->next = next;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+Arena* create_arena(size_t block_size) {
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    if (!arena) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate arena.\n");
+        exit(EXIT_FAILURE);
+    }
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : ARENA_BLOCK_SIZE;
+    return arena;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock* block = arena->head;
+    if (!block || block->size - block->used < size) {
+        if (size > arena->block_size / 4) {
+            // Oversized requests get a block of their own behind the current
+            // one, so the remaining space of the current block is not lost.
+            ArenaBlock* large = create_arena_block(size, NULL);
+            large->used = size;
+            if (block) {
+                large->next = block->next;
+                block->next = large;
+            } else {
+                arena->head = large;
+            }
+            return large->data;
+        }
+        block = create_arena_block(arena->block_size, arena->head);
+        arena->head = block;
+    }
+
+    void* memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+char* arena_strndup(Arena* arena, const char* source, size_t length) {
+    char* copy = (char*)arena_alloc(arena, length + 1);
+    memcpy(copy, source, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_adopt(Arena* arena, Arena* other) {
+    if (!other) return;
+
+    ArenaBlock* tail = other->head;
+    if (tail) {
+        while (tail->next) tail = tail->next;
+        // Keep `arena`'s current block in front so it stays the one that is
+        // bumped next.
+        if (arena->head) {
+            tail->next = arena->head->next;
+            arena->head->next = other->head;
+        } else {
+            arena->head = other->head;
+        }
+    }
+    free(other);
+}
+
+void free_arena(Arena* arena) {
+    if (!arena) return;
+
+    ArenaBlock* block = arena->head;
+    while (block) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
@@ -0,0 +1,30 @@
+#ifndef NUUK_ARENA_H
+#define NUUK_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Bump-pointer allocator. Memory handed out by an arena is never moved and is
+// released all at once by free_arena().
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+    _Alignas(16) char data[];
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock* head;
+    size_t block_size;
+} Arena;
+
+Arena* create_arena(size_t block_size);
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strndup(Arena* arena, const char* source, size_t length);
+// Moves every block of `other` into `arena` and frees `other`, so memory
+// allocated from either is released together.
+void arena_adopt(Arena* arena, Arena* other);
+void free_arena(Arena* arena);
+
+#endif
@@ -0,0 +1,77 @@
+#include "diagnostics.h"
+
+Diagnostics create_diagnostics() {
+    Diagnostics diagnostics;
+    diagnostics.items = NULL;
+    diagnostics.size = 0;
+    diagnostics.capacity = 0;
+
+    return diagnostics;
+}
+
+static void diagnostics_push(Diagnostics* diagnostics, Diagnostic diagnostic) {
+    if (diagnostics->size == diagnostics->capacity) {
+        size_t capacity = diagnostics->capacity ? diagnostics->capacity * 2 : 8;
+        Diagnostic* items = (Diagnostic*)realloc(diagnostics->items, capacity * sizeof(Diagnostic));
+        if (!items) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        diagnostics->items = items;
+        diagnostics->capacity = capacity;
+    }
+    diagnostic.order = (uint32_t)diagnostics->size;
+    diagnostics->items[diagnostics->size++] = diagnostic;
+}
+
+void diagnostics_vadd(Diagnostics* diagnostics, uint32_t offset, const char* fmt, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+
+    Diagnostic diagnostic;
+    diagnostic.offset = offset;
+    diagnostic.message = (char*)malloc(length > 0 ? length + 1 : 1);
+    if (!diagnostic.message) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    vsnprintf(diagnostic.message, length > 0 ? length + 1 : 1, fmt, args);
+    diagnostics_push(diagnostics, diagnostic);
+}
+
+void diagnostics_add(Diagnostics* diagnostics, uint32_t offset, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    diagnostics_vadd(diagnostics, offset, fmt, args);
+    va_end(args);
+}
+
+static int compare_diagnostics(const void* a, const void* b) {
+    const Diagnostic* lhs = (const Diagnostic*)a;
+    const Diagnostic* rhs = (const Diagnostic*)b;
+    if (lhs->offset != rhs->offset) return lhs->offset < rhs->offset ? -1 : 1;
+    if (lhs->order != rhs->order) return lhs->order < rhs->order ? -1 : 1;
+    return 0;
+}
+
+void emit_diagnostics(Diagnostics* diagnostics, const LineTable* lines, FILE* out) {
+    if (diagnostics->size > 1) {
+        qsort(diagnostics->items, diagnostics->size, sizeof(Diagnostic), compare_diagnostics);
+    }
+
+    for (size_t i = 0; i < diagnostics->size; i++) {
+        size_t ln, col;
+        line_table_find(lines, diagnostics->items[i].offset, &ln, &col);
+        fprintf(out, "[%zu:%zu] ERROR: %s\n", ln, col, diagnostics->items[i].message);
+    }
+}
+
+void free_diagnostics(Diagnostics* diagnostics) {
+    for (size_t i = 0; i < diagnostics->size; i++) {
+        free(diagnostics->items[i].message);
+    }
+    free(diagnostics->items);
+    *diagnostics = create_diagnostics();
+}
@@ -0,0 +1,33 @@
+#ifndef NUUK_DIAGNOSTICS_H
+#define NUUK_DIAGNOSTICS_H
+
+#include "utils.h"
+#include <stdarg.h>
+#include <stdbool.h>
+
+// One reported error. Only the source offset is kept; line and column are
+// resolved from the line table when the diagnostics are printed, which also
+// works for streaming parsers whose line table is still growing.
+typedef struct Diagnostic {
+    uint32_t offset;
+    uint32_t order;
+    char* message;
+} Diagnostic;
+
+// Errors collected over a whole run, so they can be reported together and in
+// source order instead of aborting on the first one.
+typedef struct Diagnostics {
+    Diagnostic* items;
+    size_t size;
+    size_t capacity;
+} Diagnostics;
+
+Diagnostics create_diagnostics();
+void diagnostics_add(Diagnostics* diagnostics, uint32_t offset, const char* fmt, ...);
+void diagnostics_vadd(Diagnostics* diagnostics, uint32_t offset, const char* fmt, va_list args);
+// Sorts by offset (stable for equal offsets) and prints one
+// "[ln:col] ERROR: message" line per entry.
+void emit_diagnostics(Diagnostics* diagnostics, const LineTable* lines, FILE* out);
+void free_diagnostics(Diagnostics* diagnostics);
+
+#endif
@@ -0,0 +1,140 @@
+#include "intern.h"
+#include "arena.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Atoms are stored in fixed-size pages that never move, so atom_name() can
+// read them without taking the lock: an atom id is only ever obtained from
+// intern(), which publishes the page entry under the lock first.
+#define ATOM_PAGE_BITS 12
+#define ATOM_PAGE_SIZE (1u << ATOM_PAGE_BITS)
+#define ATOM_MAX_PAGES 4096
+#define ATOM_INITIAL_SLOTS 1024
+
+typedef struct AtomInfo {
+    const char* name;
+    uint32_t length;
+    uint32_t hash;
+} AtomInfo;
+
+// Open-addressing slot with linear probing. atom == NO_ATOM marks it empty.
+typedef struct AtomSlot {
+    uint32_t hash;
+    Atom atom;
+} AtomSlot;
+
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static AtomInfo* pages[ATOM_MAX_PAGES];
+static AtomSlot* slots = NULL;
+static size_t slot_capacity = 0;
+static uint32_t next_atom = 1;
+static Arena* names = NULL;
+
+static inline AtomInfo* atom_info(Atom atom) {
+    return &pages[atom >> ATOM_PAGE_BITS][atom & (ATOM_PAGE_SIZE - 1)];
+}
+
+uint32_t atom_hash(const char* name, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void grow_slots() {
+    size_t capacity = slot_capacity ? slot_capacity * 2 : ATOM_INITIAL_SLOTS;
+    AtomSlot* grown = (AtomSlot*)calloc(capacity, sizeof(AtomSlot));
+    if (!grown) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow intern table.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < slot_capacity; i++) {
+        if (slots[i].atom == NO_ATOM) continue;
+        size_t index = slots[i].hash & (capacity - 1);
+        while (grown[index].atom != NO_ATOM) index = (index + 1) & (capacity - 1);
+        grown[index] = slots[i];
+    }
+
+    free(slots);
+    slots = grown;
+    slot_capacity = capacity;
+}
+
+Atom intern_hashed(const char* name, size_t length, uint32_t hash) {
+    pthread_mutex_lock(&intern_lock);
+    if (!slots) {
+        grow_slots();
+        names = create_arena(0);
+    }
+
+    size_t mask = slot_capacity - 1;
+    size_t index = hash & mask;
+    while (slots[index].atom != NO_ATOM) {
+        if (slots[index].hash == hash) {
+            AtomInfo* info = atom_info(slots[index].atom);
+            if (info->length == length && memcmp(info->name, name, length) == 0) {
+                Atom atom = slots[index].atom;
+                pthread_mutex_unlock(&intern_lock);
+                return atom;
+            }
+        }
+        index = (index + 1) & mask;
+    }
+
+    Atom atom = next_atom++;
+    size_t page = atom >> ATOM_PAGE_BITS;
+    if (page >= ATOM_MAX_PAGES) {
+        fprintf(stderr, "FATAL ERROR: Too many distinct identifiers.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!pages[page]) {
+        pages[page] = (AtomInfo*)malloc(sizeof(AtomInfo) * ATOM_PAGE_SIZE);
+        if (!pages[page]) {
+            fprintf(stderr, "FATAL ERROR: Failed to allocate atom page.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    AtomInfo* info = atom_info(atom);
+    info->name = arena_strndup(names, name, length);
+    info->length = (uint32_t)length;
+    info->hash = hash;
+    slots[index].hash = hash;
+    slots[index].atom = atom;
+
+    // Keep the load factor at or below 1/2.
+    if ((size_t)(next_atom - 1) * 2 > slot_capacity) grow_slots();
+
+    pthread_mutex_unlock(&intern_lock);
+    return atom;
+}
+
+Atom intern(const char* name, size_t length) {
+    return intern_hashed(name, length, atom_hash(name, length));
+}
+
+Atom intern_cstr(const char* name) {
+    return intern(name, strlen(name));
+}
+
+const char* atom_name(Atom atom) {
+    return atom_info(atom)->name;
+}
+
+size_t atom_length(Atom atom) {
+    return atom_info(atom)->length;
+}
+
+size_t atom_count() {
+    pthread_mutex_lock(&intern_lock);
+    size_t count = next_atom - 1;
+    pthread_mutex_unlock(&intern_lock);
+    return count;
+}
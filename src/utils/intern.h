@@ -0,0 +1,23 @@
+#ifndef NUUK_INTERN_H
+#define NUUK_INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// An atom is the process-wide id of an interned spelling: two atoms are equal
+// iff their spellings are. Atom 0 (NO_ATOM) is never handed out.
+typedef uint32_t Atom;
+
+#define NO_ATOM 0
+
+// All functions are thread-safe. Spellings live for the whole process and
+// are NUL-terminated.
+uint32_t atom_hash(const char* name, size_t length);
+Atom intern(const char* name, size_t length);
+Atom intern_hashed(const char* name, size_t length, uint32_t hash);
+Atom intern_cstr(const char* name);
+const char* atom_name(Atom atom);
+size_t atom_length(Atom atom);
+size_t atom_count();
+
+#endif
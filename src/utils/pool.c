@@ -0,0 +1,142 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct PoolJob {
+    PoolTask task;
+    void* arg;
+    struct PoolJob* next;
+} PoolJob;
+
+struct ThreadPool {
+    pthread_t* threads;
+    int size;
+
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t idle;
+    PoolJob* head;
+    PoolJob* tail;
+    int pending;
+    bool stopping;
+};
+
+static void* pool_worker(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->head && !pool->stopping) pthread_cond_wait(&pool->has_work, &pool->lock);
+        if (!pool->head) break;
+
+        PoolJob* job = pool->head;
+        pool->head = job->next;
+        if (!pool->head) pool->tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->task(job->arg);
+        free(job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool* create_thread_pool(int threads) {
+    if (threads < 1) threads = 1;
+
+    ThreadPool* pool = (ThreadPool*)malloc(sizeof(ThreadPool));
+    if (!pool) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate thread pool.\n");
+        exit(EXIT_FAILURE);
+    }
+    pool->threads = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    pool->size = threads;
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->pending = 0;
+    pool->stopping = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0) {
+            fprintf(stderr, "FATAL ERROR: Failed to start worker thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+void thread_pool_submit(ThreadPool* pool, PoolTask task, void* arg) {
+    PoolJob* job = (PoolJob*)malloc(sizeof(PoolJob));
+    if (!job) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate pool job.\n");
+        exit(EXIT_FAILURE);
+    }
+    job->task = task;
+    job->arg = arg;
+    job->next = NULL;
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail) pool->tail->next = job;
+    else pool->head = job;
+    pool->tail = job;
+    pool->pending++;
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int thread_pool_size(ThreadPool* pool) {
+    return pool->size;
+}
+
+void free_thread_pool(ThreadPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->size; i++) pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->threads);
+    free(pool);
+}
+
+int default_thread_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
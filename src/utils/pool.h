@@ -0,0 +1,19 @@
+#ifndef NUUK_POOL_H
+#define NUUK_POOL_H
+
+typedef void (*PoolTask)(void* arg);
+
+typedef struct ThreadPool ThreadPool;
+
+// Fixed-size pool of worker threads fed from a shared FIFO queue.
+ThreadPool* create_thread_pool(int threads);
+void thread_pool_submit(ThreadPool* pool, PoolTask task, void* arg);
+// Blocks until every submitted task has finished.
+void thread_pool_wait(ThreadPool* pool);
+int thread_pool_size(ThreadPool* pool);
+void free_thread_pool(ThreadPool* pool);
+
+// Number of online CPUs, at least 1.
+int default_thread_count();
+
+#endif
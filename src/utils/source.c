@@ -0,0 +1,181 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#endif
+
+#include "source.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SOURCE_READ_CHUNK (64 * 1024)
+
+static Source* alloc_source(const char* path) {
+    Source* source = (Source*)malloc(sizeof(Source));
+    if (!source) {
+        fprintf(stderr, "FATAL ERROR: Failed to allocate source.\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t length = strlen(path);
+    source->name = (char*)malloc(length + 1);
+    memcpy(source->name, path, length + 1);
+    source->data = "";
+    source->length = 0;
+    source->mapped = false;
+#ifdef _WIN32
+    source->file = NULL;
+    source->mapping = NULL;
+#endif
+    return source;
+}
+
+// Reads `file` to its end into a heap buffer; used for pipes, terminals and
+// anything else that cannot be mapped.
+static bool read_buffered(Source* source, FILE* file) {
+    size_t capacity = SOURCE_READ_CHUNK;
+    size_t length = 0;
+    char* buffer = (char*)malloc(capacity);
+    if (!buffer) return false;
+
+    for (;;) {
+        if (capacity - length < SOURCE_READ_CHUNK) {
+            capacity *= 2;
+            char* grown = (char*)realloc(buffer, capacity);
+            if (!grown) {
+                free(buffer);
+                return false;
+            }
+            buffer = grown;
+        }
+        size_t read = fread(buffer + length, 1, capacity - length, file);
+        if (read == 0) break;
+        length += read;
+    }
+
+    if (ferror(file)) {
+        free(buffer);
+        return false;
+    }
+    if (length == 0) {
+        free(buffer);
+        return true;
+    }
+
+    source->data = buffer;
+    source->length = length;
+    return true;
+}
+
+#ifdef _WIN32
+
+Source* source_open(const char* path) {
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    Source* source = alloc_source(path);
+    LARGE_INTEGER size;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size)) {
+        if (size.QuadPart == 0) {
+            CloseHandle(file);
+            return source;
+        }
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const char* view = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (view) {
+            source->data = view;
+            source->length = (size_t)size.QuadPart;
+            source->mapped = true;
+            source->file = file;
+            source->mapping = mapping;
+            return source;
+        }
+        if (mapping) CloseHandle(mapping);
+    }
+    CloseHandle(file);
+
+    FILE* stream = fopen(path, "rb");
+    if (!stream || !read_buffered(source, stream)) {
+        if (stream) fclose(stream);
+        source_close(source);
+        return NULL;
+    }
+    fclose(stream);
+    return source;
+}
+
+void source_close(Source* source) {
+    if (!source) return;
+    if (source->mapped) {
+        UnmapViewOfFile(source->data);
+        CloseHandle((HANDLE)source->mapping);
+        CloseHandle((HANDLE)source->file);
+    } else if (source->length) {
+        free((char*)source->data);
+    }
+    free(source->name);
+    free(source);
+}
+
+#else
+
+Source* source_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    Source* source = alloc_source(path);
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        if (info.st_size == 0) {
+            close(fd);
+            return source;
+        }
+        void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            // The mapping keeps the file referenced; the descriptor is not needed.
+            close(fd);
+            madvise(view, (size_t)info.st_size, MADV_SEQUENTIAL);
+            source->data = (const char*)view;
+            source->length = (size_t)info.st_size;
+            source->mapped = true;
+            return source;
+        }
+    }
+
+    FILE* stream = fdopen(fd, "rb");
+    if (!stream) {
+        close(fd);
+        source_close(source);
+        return NULL;
+    }
+    if (!read_buffered(source, stream)) {
+        fclose(stream);
+        source_close(source);
+        return NULL;
+    }
+    fclose(stream);
+    return source;
+}
+
+void source_close(Source* source) {
+    if (!source) return;
+    if (source->mapped) {
+        munmap((void*)source->data, source->length);
+    } else if (source->length) {
+        free((char*)source->data);
+    }
+    free(source->name);
+    free(source);
+}
+
+#endif
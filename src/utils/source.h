@@ -0,0 +1,26 @@
+#ifndef NUUK_SOURCE_H
+#define NUUK_SOURCE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// An immutable source file. Regular files are memory-mapped, so the lexer
+// and every token span read the page cache directly; pipes and other
+// non-regular files fall back to buffered reads into a heap buffer. In both
+// cases `data` is NOT NUL-terminated and must stay open for as long as any
+// token or AST node built from it is alive.
+typedef struct Source {
+    char* name;
+    const char* data;
+    size_t length;
+    bool mapped;
+#ifdef _WIN32
+    void* file;
+    void* mapping;
+#endif
+} Source;
+
+Source* source_open(const char* path);
+void source_close(Source* source);
+
+#endif
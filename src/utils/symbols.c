@@ -0,0 +1,178 @@
+#include "symbols.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYMBOL_INITIAL_SLOTS 16
+
+static uint32_t symbol_hash(Atom name, SymbolKind kind) {
+    uint32_t hash = (name << 1 | (uint32_t)kind) * 0x9e3779b1u;
+    return hash ^ (hash >> 16);
+}
+
+static void* grow_array(void* array, size_t* capacity, size_t width) {
+    size_t grown = *capacity ? *capacity * 2 : 8;
+    array = realloc(array, grown * width);
+    if (!array) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = grown;
+    return array;
+}
+
+SymbolTable* create_symbol_table(const SymbolTable* root) {
+    SymbolTable* table = (SymbolTable*)malloc(sizeof(SymbolTable));
+    if (!table) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    table->root = root;
+    table->slots = NULL;
+    table->capacity = 0;
+    table->size = 0;
+    table->log = NULL;
+    table->log_size = 0;
+    table->log_capacity = 0;
+    table->scopes = NULL;
+    table->depth = 0;
+    table->scope_capacity = 0;
+    return table;
+}
+
+void free_symbol_table(SymbolTable* table) {
+    free(table->slots);
+    free(table->log);
+    free(table->scopes);
+    free(table);
+}
+
+static SymbolSlot* find_slot(const SymbolTable* table, Atom name, SymbolKind kind) {
+    if (table->size == 0) return NULL;
+
+    uint32_t mask = table->capacity - 1;
+    uint32_t index = symbol_hash(name, kind) & mask;
+    // Robin Hood order: once the probe is further from home than the
+    // resident is from its own, the name cannot be further on.
+    for (uint32_t distance = 1;; distance++) {
+        SymbolSlot* slot = &table->slots[index];
+        if (slot->distance < distance) return NULL;
+        if (slot->symbol.name == name && slot->symbol.kind == kind) return slot;
+        index = (index + 1) & mask;
+    }
+}
+
+static void place_symbol(SymbolTable* table, Symbol symbol) {
+    uint32_t mask = table->capacity - 1;
+    uint32_t index = symbol_hash(symbol.name, symbol.kind) & mask;
+    SymbolSlot incoming = { symbol, 1 };
+
+    for (;;) {
+        SymbolSlot* slot = &table->slots[index];
+        if (slot->distance == 0) {
+            *slot = incoming;
+            table->size++;
+            return;
+        }
+        // Take the slot from a resident that is closer to home.
+        if (slot->distance < incoming.distance) {
+            SymbolSlot resident = *slot;
+            *slot = incoming;
+            incoming = resident;
+        }
+        index = (index + 1) & mask;
+        incoming.distance++;
+    }
+}
+
+static void grow_slots(SymbolTable* table) {
+    SymbolSlot* old = table->slots;
+    uint32_t old_capacity = table->capacity;
+
+    table->capacity = old_capacity ? old_capacity * 2 : SYMBOL_INITIAL_SLOTS;
+    table->slots = (SymbolSlot*)calloc(table->capacity, sizeof(SymbolSlot));
+    if (!table->slots) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow symbol table.\n");
+        exit(EXIT_FAILURE);
+    }
+    table->size = 0;
+
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].distance) place_symbol(table, old[i].symbol);
+    }
+    free(old);
+}
+
+// Backward-shift deletion: later members of the probe run move one slot
+// closer to home, so no tombstones are needed.
+static void remove_slot(SymbolTable* table, SymbolSlot* slot) {
+    uint32_t mask = table->capacity - 1;
+    uint32_t index = (uint32_t)(slot - table->slots);
+
+    for (;;) {
+        uint32_t next = (index + 1) & mask;
+        if (table->slots[next].distance <= 1) break;
+        table->slots[index] = table->slots[next];
+        table->slots[index].distance--;
+        index = next;
+    }
+    table->slots[index].distance = 0;
+    table->size--;
+}
+
+void symbol_push_scope(SymbolTable* table) {
+    if (table->depth == table->scope_capacity) {
+        table->scopes = (size_t*)grow_array(table->scopes, &table->scope_capacity, sizeof(size_t));
+    }
+    table->scopes[table->depth++] = table->log_size;
+}
+
+void symbol_pop_scope(SymbolTable* table) {
+    if (table->depth == 0) {
+        fprintf(stderr, "FATAL ERROR: Popped the outermost scope.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t start = table->scopes[--table->depth];
+    while (table->log_size > start) {
+        SymbolUndo* undo = &table->log[--table->log_size];
+        SymbolSlot* slot = find_slot(table, undo->previous.name, undo->previous.kind);
+        if (undo->existed) slot->symbol = undo->previous;
+        else remove_slot(table, slot);
+    }
+}
+
+bool symbol_declare(SymbolTable* table, Atom name, SymbolKind kind, void* value) {
+    Symbol symbol = { name, kind, table->depth, value };
+    SymbolSlot* slot = find_slot(table, name, kind);
+
+    bool fresh = !slot || slot->symbol.scope != table->depth;
+    // The outermost scope is never popped, so it needs no undo entries.
+    if (table->depth > 0) {
+        if (table->log_size == table->log_capacity) {
+            table->log = (SymbolUndo*)grow_array(table->log, &table->log_capacity, sizeof(SymbolUndo));
+        }
+        SymbolUndo* undo = &table->log[table->log_size++];
+        undo->existed = slot != NULL;
+        undo->previous = slot ? slot->symbol : symbol;
+    }
+
+    if (slot) {
+        slot->symbol = symbol;
+        return fresh;
+    }
+
+    // Keep the load factor at or below 3/4.
+    if ((table->size + 1) * 4 > table->capacity * 3) grow_slots(table);
+    place_symbol(table, symbol);
+    return fresh;
+}
+
+const Symbol* symbol_lookup(const SymbolTable* table, Atom name, SymbolKind kind) {
+    for (; table; table = table->root) {
+        SymbolSlot* slot = find_slot(table, name, kind);
+        if (slot) return &slot->symbol;
+    }
+    return NULL;
+}
@@ -0,0 +1,73 @@
+#ifndef NUUK_SYMBOLS_H
+#define NUUK_SYMBOLS_H
+
+#include "intern.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Types and variables are separate namespaces: declaring a variable never
+// hides a type name, so it cannot change how later tokens parse.
+typedef enum SymbolKind {
+    SYMBOL_TYPE,
+    SYMBOL_VARIABLE,
+} SymbolKind;
+
+// `scope` is the depth the symbol was declared at, 0 for the outermost
+// scope of a table. `value` is owned by whoever declared the symbol, e.g.
+// the Datatype of a variable.
+typedef struct Symbol {
+    Atom name;
+    SymbolKind kind;
+    uint32_t scope;
+    void* value;
+} Symbol;
+
+// Robin Hood slot. `distance` is one more than how far the slot is from the
+// symbol's home bucket, so 0 marks it empty.
+typedef struct SymbolSlot {
+    Symbol symbol;
+    uint32_t distance;
+} SymbolSlot;
+
+// What a declaration replaced, so leaving its scope can put it back.
+typedef struct SymbolUndo {
+    Symbol previous;
+    bool existed;
+} SymbolUndo;
+
+// A stack of scopes over one open-addressing table that holds only the
+// innermost visible symbol per name. Declaring logs what it shadows, and
+// popping a scope replays its part of the log backwards, so leaving a scope
+// costs O(symbols it declared) and lookups never walk a scope chain.
+// Names not found fall through to `root`, an immutable table that can be
+// shared between threads, e.g. the builtin types.
+typedef struct SymbolTable {
+    const struct SymbolTable* root;
+    SymbolSlot* slots;
+    uint32_t capacity;
+    uint32_t size;
+
+    SymbolUndo* log;
+    size_t log_size;
+    size_t log_capacity;
+
+    size_t* scopes;
+    uint32_t depth;
+    size_t scope_capacity;
+} SymbolTable;
+
+SymbolTable* create_symbol_table(const SymbolTable* root);
+void free_symbol_table(SymbolTable* table);
+
+void symbol_push_scope(SymbolTable* table);
+void symbol_pop_scope(SymbolTable* table);
+
+// Declares `name` in the current scope, shadowing any outer symbol of the
+// same kind. Returns false if the current scope already declared it; the new
+// symbol replaces the old one either way.
+bool symbol_declare(SymbolTable* table, Atom name, SymbolKind kind, void* value);
+const Symbol* symbol_lookup(const SymbolTable* table, Atom name, SymbolKind kind);
+
+#endif
@@ -3,40 +3,64 @@
 
 #include <ctype.h>
 
-Token* create_token(TokenType type, const char* value, size_t ln, size_t col) {
-    Token* token = (Token*)malloc(sizeof(Token));
-    token->type = type;
-    token->value = value;
-    token->ln = ln;
-    token->col = col;
-    
+Token create_token(TokenType type, const char* start, size_t length) {
+    Token token;
+    token.type = type;
+    token.atom = NO_ATOM;
+    token.start = start;
+    token.offset = 0;
+    token.length = (uint32_t)length;
+
     return token;
 }
 
+static const char* const token_spellings[] = {
+    [LPAREN] = "(", [RPAREN] = ")", [LBRACE] = "{", [RBRACE] = "}",
+    [LSQUARE] = "[", [RSQUARE] = "]", [COMMA] = ",", [DOT] = ".", [SEMICOLON] = ";",
+    [PLUS] = "+", [MINUS] = "-", [STAR] = "*", [SLASH] = "/", [MOD] = "%",
+    [EQ] = "==", [NEQ] = "!=", [LT] = "<", [GT] = ">", [LTE] = "<=", [GTE] = ">=",
+    [AND] = "and", [OR] = "or", [BANG] = "!", [FALSE] = "false", [TRUE] = "true",
+    [COLON] = ":", [COLON_COLON] = "::", [ASSIGN] = "=", [MINUS_EQ] = "-=", [PLUS_EQ] = "+=",
+    [STAR_EQ] = "*=", [SLASH_EQ] = "/=", [AMPERSAND] = "&", [AT] = "@",
+
+    [IDENTIFIER] = "IDENTIFIER", [STRING] = "STRING", [NUMBER] = "NUMBER", [CHAR] = "CHAR",
+    [ILLEGAL] = "ILLEGAL",
+
+    [IF] = "if", [MOVE] = "move", [ELSE] = "else", [TRY] = "try", [WHILE] = "while",
+    [FOR] = "for", [BREAK] = "break", [CONTINUE] = "continue", [SWITCH] = "switch",
+    [CASE] = "case", [BEGIN] = "begin", [END] = "end", [SPACE] = "space", [STATIC] = "static",
+    [STRUCT] = "struct", [ENUM] = "enum", [UNION] = "union", [TAGGED] = "tagged",
+    [CONST] = "const", [USE] = "use", [DEF] = "def", [NEW] = "new", [RETURN] = "return",
+    [FOREACH] = "foreach", [IN] = "in", [DEFAULT] = "default", [EXTERN] = "extern",
+    [MACRO] = "macro", [FINAL] = "final", [IMPORT] = "import", [NAMEOF] = "nameof",
+    [SIZEOF] = "sizeof", [TYPEOF] = "typeof", [FALL] = "fall", [VARARGS] = "varargs",
+    [VARARG] = "vararg", [FINALLY] = "finally", [EXPAND] = "expand", [UNIQUE] = "unique",
+    [SHARED] = "shared",
+
+    [END_OF_FILE] = "END_OF_FILE",
+};
+
+const char* token_type_spelling(TokenType type) {
+    return token_spellings[type];
+}
+
+const char* token_lexeme(const Token* token) {
+    return token->start ? token->start : token_spellings[token->type];
+}
+
+size_t token_length(const Token* token) {
+    return token->start ? token->length : strlen(token_spellings[token->type]);
+}
+
 void print_token(Token* token) {
     printf("[");
     print_token_type(token);
-    printf(", %s]\n", token->value);
+    printf(", " TOKEN_FMT "]\n", TOKEN_ARG(token));
 }
 
 void print_token_type(Token* token) {
-    switch (token->type) {
-        case IDENTIFIER:
-            printf("IDENTIFIER");
-            break;
-        case STRING:
-            printf("STRING");
-            break;
-        case CHAR:
-            printf("CHAR");
-            break;
-        case NUMBER:
-            printf("NUMBER");
-            break;
-        default:
-            printf("%s", to_upper(token->value));
-            break;
-    }
+    const char* spelling = token_spellings[token->type];
+    while (*spelling) putchar(toupper((unsigned char)*spelling++));
 }
 
 char* to_upper(const char* c) {
@@ -54,226 +78,227 @@ char* to_upper(const char* c) {
     return upper;
 }
 
-char* location(Token* token) {
-    char buffer[100];
-    snprintf(buffer, sizeof(buffer), "[%zu:%zu]", token->ln, token->col);
-    return 0;
+// Formats "[ln:col]" for a diagnostic. The result lives in a per-thread
+// buffer that the next call overwrites.
+const char* location(const LineTable* lines, const Token* token) {
+    static _Thread_local char buffer[48];
+    size_t ln, col;
+    line_table_find(lines, token->offset, &ln, &col);
+    snprintf(buffer, sizeof(buffer), "[%zu:%zu]", ln, col);
+    return buffer;
 }
 
-char* concat(const char* source, size_t start, size_t end) {
-    if (!source || start >= end || start >= strlen(source)) {
-        fprintf(stderr, "ERROR: Invalid substring range [%zu, %zu]\n", start, end);
-        return NULL;
-    }
+LineTable create_line_table() {
+    LineTable table;
+    table.starts = NULL;
+    table.size = 0;
+    table.capacity = 0;
+    table.tail = 0;
+    table.tail_delta = 0;
 
-    size_t length = end - start;
-    char* result = (char*)malloc(length + 1);
-    if (!result) {
-        fprintf(stderr, "ERROR: Failed to allocate memory for string!\n");
-        return NULL;
-    }
-
-    strncpy(result, source + start, length);
-    result[length] = '\0';
-    return result;
+    return table;
 }
 
-unsigned int hash_function(const char* key) {
-    unsigned int hash = 5381;
-    while (*key) {
-        hash = ((hash << 5) + hash) + (unsigned char)(*key++); // hash * 33 + key[i]
+void line_table_reserve(LineTable* table, size_t capacity) {
+    if (capacity <= table->capacity) return;
+
+    table->starts = (uint32_t*)realloc(table->starts, capacity * sizeof(uint32_t));
+    if (!table->starts) {
+        fprintf(stderr, "FATAL ERROR: Failed to resize line table.\n");
+        exit(1);
     }
-    return hash % HASH_TABLE_SIZE;
+    // The tail stays at the end, so the gap takes the new room.
+    memmove(table->starts + capacity - table->tail, table->starts + table->capacity - table->tail, table->tail * sizeof(uint32_t));
+    table->capacity = capacity;
 }
 
-HashMap* create_hash_map() {
-    HashMap* map = (HashMap*)malloc(sizeof(HashMap));
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        map->entries[i] = NULL;
-    }
-    return map;
+// Adds `delta` (modulo 2^32) to `count` offsets.
+static void shift_offsets(uint32_t* offsets, size_t count, uint32_t delta) {
+    if (delta == 0) return;
+    for (size_t i = 0; i < count; i++) offsets[i] += delta;
 }
 
-void hash_insert(HashMap* map, const char* key, TokenType value) {
-    unsigned int index = hash_function(key);
-    HashEntry* entry = (HashEntry*)malloc(sizeof(HashEntry)); 
-    entry->key = strdup(key);
-    entry->value = value;
-    entry->next = NULL;
+// Moves the gap to just before entry `index`, so that entries [0, index)
+// are stored in place. Costs one step per entry the gap passes.
+void line_table_move_gap(LineTable* table, size_t index) {
+    size_t gap = table->size - table->tail;
+    size_t width = table->capacity - table->size;
 
-    if (map->entries[index] == NULL) {
-        map->entries[index] = entry;
+    if (index < gap) {
+        memmove(table->starts + index + width, table->starts + index, (gap - index) * sizeof(uint32_t));
+        shift_offsets(table->starts + index + width, gap - index, 0u - table->tail_delta);
+        table->tail += gap - index;
     } else {
-        entry->next = map->entries[index];
-        map->entries[index] = entry;
+        memmove(table->starts + gap, table->starts + gap + width, (index - gap) * sizeof(uint32_t));
+        shift_offsets(table->starts + gap, index - gap, table->tail_delta);
+        table->tail -= index - gap;
     }
+    if (table->tail == 0) table->tail_delta = 0;
 }
 
-TokenType hash_get(HashMap* map, const char* key, int* found) {
-    unsigned int index = hash_function(key);
-    HashEntry* entry = map->entries[index];
-
-    while (entry) {
-        if (strcmp(entry->key, key) == 0) {
-            *found = 1;
-            return entry->value;
-        }
+void line_table_add(LineTable* table, uint32_t start) {
+    if (table->tail) line_table_move_gap(table, table->size);
+    if (table->size >= table->capacity) {
+        line_table_reserve(table, table->capacity ? table->capacity * 2 : 64);
+    }
+    table->starts[table->size++] = start;
+}
 
-        entry = entry->next;
+// Finds the line containing `offset`: the last line that starts at or before
+// it. Lines are 1-based, columns 0-based.
+void line_table_find(const LineTable* table, uint32_t offset, size_t* ln, size_t* col) {
+    size_t lo = 0, hi = table->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (line_table_start(table, mid) <= offset) lo = mid + 1;
+        else hi = mid;
     }
 
-    *found = 0;
-    return END_OF_FILE;
+    *ln = lo ? lo : 1;
+    *col = lo ? offset - line_table_start(table, lo - 1) : offset;
 }
 
-void free_hash_map(HashMap* map) {
-    for (int i = 0; i < HASH_TABLE_SIZE; i++) {
-        HashEntry* entry = map->entries[i];
-        while (entry) {
-            HashEntry* tmp = entry;
-            entry = entry->next;
-            free(tmp->key);
-            free(tmp);
-        }
+// Number of lines that start before `offset`.
+size_t line_table_below(const LineTable* table, uint32_t offset) {
+    size_t lo = 0, hi = table->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (line_table_start(table, mid) < offset) lo = mid + 1;
+        else hi = mid;
     }
-    free(map);
+    return lo;
 }
 
-SymbolTable* create_symbol_table() {
-    SymbolTable* table = (SymbolTable*)malloc(sizeof(SymbolTable));
-    if (!table) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
-    memset(table->table, 0, sizeof(table->table));
-    return table;
+void free_line_table(LineTable* table) {
+    free(table->starts);
+    *table = create_line_table();
 }
 
-void symbol_insert(SymbolTable* table, const char* type_name) {
-    unsigned int index = hash_function(type_name);
-    TypeEntry* new_entry = (TypeEntry*)malloc(sizeof(TypeEntry));
-    if (!new_entry) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
-    new_entry->name = strdup(type_name);
-    new_entry->next = table->table[index];
-    table->table[index] = new_entry;
+TokenArray create_token_array(size_t capacity) {
+    TokenArray array;
+    array.kinds = NULL;
+    array.offsets = NULL;
+    array.values = NULL;
+    array.capacity = 0;
+    array.size = 0;
+    array.tail = 0;
+    array.tail_delta = 0;
+    array.source = NULL;
+    array.lines = create_line_table();
+
+    token_array_reserve(&array, capacity);
+    return array;
 }
 
-int symbol_lookup(SymbolTable* table, const char* type_name) {
-    unsigned int index = hash_function(type_name);
-    TypeEntry* entry = table->table[index];
+void token_array_reserve(TokenArray* array, size_t capacity) {
+    if (capacity <= array->capacity) return;
 
-    while (entry) {
-        if (strcmp(entry->name, type_name) == 0) {
-            return 1;
-        }
-        entry = entry->next;
+    array->kinds = (uint8_t*)realloc(array->kinds, capacity * sizeof(uint8_t));
+    array->offsets = (uint32_t*)realloc(array->offsets, capacity * sizeof(uint32_t));
+    array->values = (uint32_t*)realloc(array->values, capacity * sizeof(uint32_t));
+    if (!array->kinds || !array->offsets || !array->values) {
+        fprintf(stderr, "FATAL ERROR: Failed to resize token array.\n");
+        exit(1);
     }
-
-    return 0;
+    size_t from = array->capacity - array->tail, to = capacity - array->tail;
+    memmove(array->kinds + to, array->kinds + from, array->tail * sizeof(uint8_t));
+    memmove(array->offsets + to, array->offsets + from, array->tail * sizeof(uint32_t));
+    memmove(array->values + to, array->values + from, array->tail * sizeof(uint32_t));
+    array->capacity = capacity;
 }
 
-void free_symbol_table(SymbolTable* table) {
-    for (int i = 0; i < SYMBOL_TABLE_SIZE; i++) {
-        TypeEntry* entry = table->table[i];
-        while (entry) {
-            TypeEntry* tmp = entry;
-            entry = entry->next;
-            free(tmp->name);
-            free(tmp);
-        }
+// Moves the gap to just before entry `index`; see line_table_move_gap().
+void token_array_move_gap(TokenArray* array, size_t index) {
+    size_t gap = array->size - array->tail;
+    size_t width = array->capacity - array->size;
+
+    if (index < gap) {
+        size_t count = gap - index;
+        memmove(array->kinds + index + width, array->kinds + index, count * sizeof(uint8_t));
+        memmove(array->offsets + index + width, array->offsets + index, count * sizeof(uint32_t));
+        memmove(array->values + index + width, array->values + index, count * sizeof(uint32_t));
+        shift_offsets(array->offsets + index + width, count, 0u - array->tail_delta);
+        array->tail += count;
+    } else {
+        size_t count = index - gap;
+        memmove(array->kinds + gap, array->kinds + gap + width, count * sizeof(uint8_t));
+        memmove(array->offsets + gap, array->offsets + gap + width, count * sizeof(uint32_t));
+        memmove(array->values + gap, array->values + gap + width, count * sizeof(uint32_t));
+        shift_offsets(array->offsets + gap, count, array->tail_delta);
+        array->tail -= count;
     }
-    free(table);
+    if (array->tail == 0) array->tail_delta = 0;
 }
 
-TokenArray create_token_array(int capacity) {
-    TokenArray array;
-    array.elements = (Token*)malloc(sizeof(Token) * capacity);
-    array.capacity = capacity;
-    array.size = 0;
-
-    return array;
+// Index of the first entry in [first, last) that begins at or after
+// `offset`.
+size_t token_array_below(const TokenArray* array, size_t first, size_t last, uint32_t offset) {
+    while (first < last) {
+        size_t mid = first + (last - first) / 2;
+        if (token_array_offset(array, mid) < offset) first = mid + 1;
+        else last = mid;
+    }
+    return first;
 }
 
-void token_array_add(TokenArray* array, Token* token) {
-    if (!array || !token) {
-        fprintf(stderr, "FATAL ERROR: Invalid array or token passed to token_array_add.\n");
+void token_array_add(TokenArray* array, Token token) {
+    if (!array) {
+        fprintf(stderr, "FATAL ERROR: Invalid array passed to token_array_add.\n");
         return;
     }
+    if (array->tail) token_array_move_gap(array, array->size);
     if (array->size >= array->capacity) {
         // Double the capacity if the array is full
-        array->capacity *= 2;
-        array->elements = realloc(array->elements, array->capacity * sizeof(Token));
-        if (!array->elements) {
-            fprintf(stderr, "FATAL ERROR: Failed to resize token array.\n");
-            exit(1);
-        }
+        token_array_reserve(array, array->capacity ? array->capacity * 2 : 16);
     }
-    array->elements[array->size++] = *token;
+
+    array->kinds[array->size] = (uint8_t)token.type;
+    array->offsets[array->size] = token.offset;
+    array->values[array->size] = token.type == IDENTIFIER ? token.atom : token.length;
+    array->size++;
 }
 
-Token* token_array_get(TokenArray* array, int index) {
-    if (!array || index < 0 || index >= array->size) {
+// Expands entry `index`. Spans point into `array->source`, except for
+// identifiers, which use the interned spelling.
+Token token_array_get(const TokenArray* array, size_t index) {
+    if (!array || index >= array->size) {
         fprintf(stderr, "FATAL ERROR: Invalid array or index passed to token_array_get.\n");
-        return NULL;
+        exit(1);
     }
 
-    return &array->elements[index];
-}
+    TokenType type = token_array_kind(array, index);
+    uint32_t offset = token_array_offset(array, index);
+    uint32_t value = array->values[token_array_slot(array, index)];
+    Token token;
 
-void free_token_array(TokenArray* array) {
-    for (int i = 0; i < array->size; i++) {
-        free(&array->elements[i]);
+    switch (type) {
+        case IDENTIFIER:
+            token = create_token(type, atom_name(value), atom_length(value));
+            token.atom = value;
+            break;
+        case STRING: case NUMBER: case ILLEGAL:
+            token = create_token(type, array->source + offset, value);
+            break;
+        case CHAR:
+            token = create_token(type, array->source + offset + 1, value);
+            break;
+        default:
+            token = create_token(type, NULL, 0);
     }
-    free(array);
+    token.offset = offset;
+    return token;
 }
 
-HashMap* map_keywords() {
-    HashMap* map = create_hash_map();
-    hash_insert(map, "if", IF);
-    hash_insert(map, "move", MOVE);
-    hash_insert(map, "else", ELSE);
-    hash_insert(map, "try", TRY);
-    hash_insert(map, "while", WHILE);
-    hash_insert(map, "for", FOR);
-    hash_insert(map, "break", BREAK);
-    hash_insert(map, "continue", CONTINUE);
-    hash_insert(map, "switch", SWITCH);
-    hash_insert(map, "case", CASE);
-    hash_insert(map, "begin", BEGIN);
-    hash_insert(map, "end", END);
-    hash_insert(map, "space", SPACE);
-    hash_insert(map, "static", STATIC);
-    hash_insert(map, "struct", STRUCT);
-    hash_insert(map, "union", UNION);
-    hash_insert(map, "enum", ENUM);
-    hash_insert(map, "tagged", TAGGED);
-    hash_insert(map, "const", CONST);
-    hash_insert(map, "use", USE);
-    hash_insert(map, "def", DEF);
-    hash_insert(map, "new", NEW);
-    hash_insert(map, "return", RETURN);
-    hash_insert(map, "foreach", FOREACH);
-    hash_insert(map, "in", IN);
-    hash_insert(map, "default", DEFAULT);
-    hash_insert(map, "extern", EXTERN);
-    hash_insert(map, "macro", MACRO);
-    hash_insert(map, "final", FINAL);
-    hash_insert(map, "import", IMPORT);
-    hash_insert(map, "nameof", NAMEOF);
-    hash_insert(map, "sizeof", SIZEOF);
-    hash_insert(map, "typeof", TYPEOF);
-    hash_insert(map, "fall", FALL);
-    hash_insert(map, "varargs", VARARGS);
-    hash_insert(map, "vararg", VARARG);
-    hash_insert(map, "finally", FINALLY);
-    hash_insert(map, "expand", EXPAND);
-    hash_insert(map, "and", AND);
-    hash_insert(map, "or", OR);
-    hash_insert(map, "unique", UNIQUE);
-    hash_insert(map, "shared", SHARED);
-
-    return map;
-}
\ No newline at end of file
+void free_token_array(TokenArray* array) {
+    free(array->kinds);
+    free(array->offsets);
+    free(array->values);
+    free_line_table(&array->lines);
+    array->kinds = NULL;
+    array->offsets = NULL;
+    array->values = NULL;
+    array->capacity = 0;
+    array->size = 0;
+    array->tail = 0;
+    array->tail_delta = 0;
+}
@@ -5,19 +5,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 
-#define HASH_TABLE_SIZE 128
-#define SYMBOL_TABLE_SIZE 128
-
-#define MAP(...) ({ \
-    HashMap map = { .size = 0 }; \
-    HashEntry temp[] = {  __VA_ARGS__ }; \
-    for (int i = 0; i < sizeof(temp) / sizeof(temp[0]); i++) { \
-        map.entries[i] = temp[i]; \
-        map.size++; \
-    } \
-    map; \
-})
+#include "intern.h"
 
 typedef enum TokenType {
     // Symbols
@@ -28,7 +18,7 @@ typedef enum TokenType {
     AMPERSAND, AT, 
 
     // Objects
-    IDENTIFIER, STRING, NUMBER, CHAR,
+    IDENTIFIER, STRING, NUMBER, CHAR, ILLEGAL,
 
     // Keywords
     IF, MOVE, ELSE, TRY, WHILE, FOR, BREAK, CONTINUE, SWITCH, CASE, BEGIN, END, SPACE, STATIC, STRUCT, ENUM, UNION, TAGGED,
@@ -38,64 +28,107 @@ typedef enum TokenType {
     END_OF_FILE
 } TokenType;
 
-typedef struct HashEntry {
-    char* key;
-    TokenType value;
-    struct HashEntry* next;
-} HashEntry;
-
-typedef struct HashMap {
-    HashEntry* entries[HASH_TABLE_SIZE];
-} HashMap;
-
-typedef struct TypeEntry {
-    char* name;
-    struct TypeEntry* next;
-} TypeEntry;
-
-typedef struct SymbolTable {
-    TypeEntry* table[SYMBOL_TABLE_SIZE];
-} SymbolTable;
-
+// A token is a span into the shared, immutable source buffer. Tokens with a
+// fixed spelling ("(", "==", "if", ...) carry no span at all: `start` is NULL
+// and their text comes from token_type_spelling(). Identifiers also carry
+// their interned atom, so they compare by integer. `offset` is where the
+// token's text begins in the source (for STRING/CHAR, at the opening quote).
+// ILLEGAL spans text that could not be lexed, up to the end of its line.
+// Line and column are not stored; see LineTable.
 typedef struct Token {
     TokenType type;
-    const char* value;
-    size_t ln;
-    size_t col;
+    Atom atom;
+    const char* start;
+    uint32_t offset;
+    uint32_t length;
 } Token;
 
+#define TOKEN_FMT "%.*s"
+#define TOKEN_ARG(token) (int)token_length(token), token_lexeme(token)
+
+// Offsets at which each line of a source begins, in increasing order; entry
+// i is line i + 1. It is filled while lexing so line and column are only
+// computed (by binary search) when a diagnostic needs them.
+//
+// Like TokenArray, the table is a gap buffer: the last `tail` entries are
+// stored at the end of `starts` with `tail_delta` still to be added to them
+// (modulo 2^32), so an edit moves only the entries between the previous
+// edit and this one. Read entries with line_table_start().
+typedef struct LineTable {
+    uint32_t* starts;
+    size_t size;
+    size_t capacity;
+    size_t tail;
+    uint32_t tail_delta;
+} LineTable;
+
+// Tokens are stored as parallel arrays of 9 bytes per token: the kind, the
+// source offset and a 32-bit value that is the span length, or the atom for
+// IDENTIFIER (whose length atom_length() knows). token_array_get() expands
+// an entry back into a Token. `source` is the buffer the tokens were lexed
+// from; the array also owns that source's line table.
+//
+// The free capacity is a gap after entry `size - tail`; the `tail` entries
+// past it sit at the end of the arrays, and their stored offsets lack
+// `tail_delta`. apply_token_splice() moves the gap to the edit and adds the
+// edit's length change to `tail_delta`, so it never rewrites the rest of
+// the file. A freshly lexed array has no tail, and token_array_add() moves
+// the gap back to the end. Read entries with the accessors below.
 typedef struct TokenArray {
-    Token* elements;
-    int capacity;
-    int size; 
+    uint8_t* kinds;
+    uint32_t* offsets;
+    uint32_t* values;
+    size_t capacity;
+    size_t size;
+    size_t tail;
+    uint32_t tail_delta;
+    const char* source;
+    LineTable lines;
 } TokenArray;
 
-Token* create_token(TokenType type, const char* value, size_t ln, size_t col);
-
-void print_token(Token* token);
-void print_token_type(Token* token);
-char* to_upper(const char* c);
+static inline size_t token_array_slot(const TokenArray* array, size_t index) {
+    return index < array->size - array->tail ? index : index + (array->capacity - array->size);
+}
 
-char* location(Token* token);
+static inline TokenType token_array_kind(const TokenArray* array, size_t index) {
+    return (TokenType)array->kinds[token_array_slot(array, index)];
+}
 
-char* concat(const char* source, size_t start, size_t end);
+static inline uint32_t token_array_offset(const TokenArray* array, size_t index) {
+    if (index < array->size - array->tail) return array->offsets[index];
+    return array->offsets[index + (array->capacity - array->size)] + array->tail_delta;
+}
 
-TokenArray create_token_array(int capacity);
-void token_array_add(TokenArray* array, Token* token);
-void free_token_array(TokenArray* array);
-Token* token_array_get(TokenArray* array, int index);
+static inline uint32_t line_table_start(const LineTable* table, size_t index) {
+    if (index < table->size - table->tail) return table->starts[index];
+    return table->starts[index + (table->capacity - table->size)] + table->tail_delta;
+}
 
-unsigned int hash_function(const char* key);
-HashMap* create_hash_map();
-void hash_insert(HashMap* map, const char* key, TokenType value);
-TokenType hash_get(HashMap* map, const char* key, int* found);
-void free_hash_map(HashMap* map);
+Token create_token(TokenType type, const char* start, size_t length);
+const char* token_type_spelling(TokenType type);
+const char* token_lexeme(const Token* token);
+size_t token_length(const Token* token);
 
-SymbolTable* create_symbol_table();
-void symbol_insert(SymbolTable* table, const char* type_name);
-int symbol_lookup(SymbolTable* table, const char* type_name);
-void free_symbol_table(SymbolTable* table);
+void print_token(Token* token);
+void print_token_type(Token* token);
+char* to_upper(const char* c);
 
-HashMap* map_keywords();
+const char* location(const LineTable* lines, const Token* token);
+
+LineTable create_line_table();
+void line_table_reserve(LineTable* table, size_t capacity);
+void line_table_add(LineTable* table, uint32_t start);
+void line_table_move_gap(LineTable* table, size_t index);
+size_t line_table_below(const LineTable* table, uint32_t offset);
+void line_table_find(const LineTable* table, uint32_t offset, size_t* ln, size_t* col);
+void free_line_table(LineTable* table);
+
+TokenArray create_token_array(size_t capacity);
+void token_array_reserve(TokenArray* array, size_t capacity);
+void token_array_move_gap(TokenArray* array, size_t index);
+size_t token_array_below(const TokenArray* array, size_t first, size_t last, uint32_t offset);
+void token_array_add(TokenArray* array, Token token);
+void free_token_array(TokenArray* array);
+Token token_array_get(const TokenArray* array, size_t index);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include "bytecode.h"
+#include "jit.h"
+
+#include <stdlib.h>
+
+static const char* opcode_names[OP_COUNT] = {
+    [OP_MOVE] = "MOVE",
+    [OP_LOADK] = "LOADK",
+    [OP_LOADINT] = "LOADINT",
+    [OP_LOADNIL] = "LOADNIL",
+    [OP_LOADBOOL] = "LOADBOOL",
+    [OP_GETGLOBAL] = "GETGLOBAL",
+    [OP_SETGLOBAL] = "SETGLOBAL",
+    [OP_ADD] = "ADD",
+    [OP_SUB] = "SUB",
+    [OP_MUL] = "MUL",
+    [OP_DIV] = "DIV",
+    [OP_MOD] = "MOD",
+    [OP_EQ] = "EQ",
+    [OP_NEQ] = "NEQ",
+    [OP_LT] = "LT",
+    [OP_LE] = "LE",
+    [OP_NEG] = "NEG",
+    [OP_NOT] = "NOT",
+    [OP_JUMPIF] = "JUMPIF",
+    [OP_CALL] = "CALL",
+    [OP_GET] = "GET",
+    [OP_RETURN] = "RETURN",
+    [OP_ADDK] = "ADDK",
+    [OP_SUBK] = "SUBK",
+    [OP_MULK] = "MULK",
+    [OP_DIVK] = "DIVK",
+    [OP_MODK] = "MODK",
+    [OP_LT_JUMPIF] = "LT_JUMPIF",
+    [OP_LE_JUMPIF] = "LE_JUMPIF",
+    [OP_CALLK] = "CALLK",
+};
+
+static void* grow_array(void* array, size_t* capacity, size_t width) {
+    size_t grown = *capacity ? *capacity * 2 : 64;
+    array = realloc(array, grown * width);
+    if (!array) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow function.\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = grown;
+    return array;
+}
+
+Function* create_function(const char* name) {
+    Function* function = (Function*)calloc(1, sizeof(Function));
+    if (!function) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    function->name = name;
+    function->arena = create_arena(ARENA_BLOCK_SIZE);
+    return function;
+}
+
+void free_function(Function* function) {
+    free(function->code);
+    free(function->offsets);
+    free(function->constants);
+    free(function->globals);
+    if (function->jit) free_jit_code(function->jit);
+    free_arena(function->arena);
+    free(function);
+}
+
+size_t function_emit(Function* function, Instruction instruction, uint32_t offset) {
+    if (function->size == function->capacity) {
+        size_t capacity = function->capacity;
+        function->code = (Instruction*)grow_array(function->code, &function->capacity, sizeof(Instruction));
+        function->offsets = (uint32_t*)grow_array(function->offsets, &capacity, sizeof(uint32_t));
+    }
+    function->code[function->size] = instruction;
+    function->offsets[function->size] = offset;
+    return function->size++;
+}
+
+size_t function_add_constant(Function* function, Value value) {
+    if (function->constant_count == function->constant_capacity) {
+        function->constants = (Value*)grow_array(function->constants, &function->constant_capacity, sizeof(Value));
+    }
+    function->constants[function->constant_count] = value;
+    return function->constant_count++;
+}
+
+uint32_t function_add_global(Function* function, Atom name) {
+    if (function->global_count == function->global_capacity) {
+        size_t capacity = function->global_capacity;
+        function->globals = (Atom*)grow_array(function->globals, &capacity, sizeof(Atom));
+        function->global_capacity = (uint32_t)capacity;
+    }
+    function->globals[function->global_count] = name;
+    return function->global_count++;
+}
+
+const char* opcode_name(OpCode op) {
+    return op < OP_COUNT ? opcode_names[op] : "UNKNOWN";
+}
+
+// Bx of the instruction at `*pc`, reading the extra word of a wide operand.
+static uint32_t read_bx(const Function* function, size_t* pc) {
+    uint32_t bx = ARG_BX(function->code[*pc]);
+    return bx == BX_WIDE ? function->code[++*pc] : bx;
+}
+
+static void print_branch(const Function* function, size_t* pc) {
+    Instruction word = function->code[++*pc];
+    printf(" if %s to %04zu\n", BRANCH_WHEN(word) ? "true" : "false", (size_t)((int64_t)*pc + 1 + BRANCH_DISTANCE(word)));
+}
+
+void dprint_function(const Function* function) {
+    printf("FUNCTION %s (registers: %u, constants: %zu, globals: %u)\n", function->name,
+        function->register_count, function->constant_count, function->global_count);
+
+    for (size_t pc = 0; pc < function->size; pc++) {
+        Instruction instruction = function->code[pc];
+        OpCode op = OP(instruction);
+        printf("%04zu %-10s ", pc, opcode_name(op));
+
+        switch (op) {
+            case OP_MOVE: case OP_NEG: case OP_NOT:
+                printf("R%u R%u\n", ARG_A(instruction), ARG_B(instruction));
+                break;
+            case OP_LOADK: {
+                uint32_t a = ARG_A(instruction);
+                uint32_t index = read_bx(function, &pc);
+                printf("R%u K%u ; ", a, index);
+                print_value(stdout, function->constants[index]);
+                printf("\n");
+                break;
+            }
+            case OP_LOADINT:
+                printf("R%u %d\n", ARG_A(instruction), ARG_SBX(instruction));
+                break;
+            case OP_LOADNIL: case OP_RETURN:
+                printf("R%u\n", ARG_A(instruction));
+                break;
+            case OP_LOADBOOL:
+                printf("R%u %s\n", ARG_A(instruction), ARG_B(instruction) ? "true" : "false");
+                break;
+            case OP_GETGLOBAL: case OP_SETGLOBAL: {
+                uint32_t a = ARG_A(instruction);
+                uint32_t index = read_bx(function, &pc);
+                printf("R%u G%u ; %s\n", a, index, atom_name(function->globals[index]));
+                break;
+            }
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_EQ: case OP_NEQ: case OP_LT: case OP_LE:
+                printf("R%u R%u R%u\n", ARG_A(instruction), ARG_B(instruction), ARG_C(instruction));
+                break;
+            case OP_JUMPIF:
+                printf("R%u ;", ARG_A(instruction));
+                print_branch(function, &pc);
+                break;
+            case OP_LT_JUMPIF: case OP_LE_JUMPIF:
+                printf("R%u R%u R%u ;", ARG_A(instruction), ARG_B(instruction), ARG_C(instruction));
+                print_branch(function, &pc);
+                break;
+            case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: case OP_MODK:
+                printf("R%u R%u K%u ; ", ARG_A(instruction), ARG_B(instruction), ARG_C(instruction));
+                print_value(stdout, function->constants[ARG_C(instruction)]);
+                printf("\n");
+                break;
+            case OP_CALLK:
+                printf("R%u %u K%u ; ", ARG_A(instruction), ARG_B(instruction), ARG_C(instruction));
+                print_value(stdout, function->constants[ARG_C(instruction)]);
+                printf("\n");
+                break;
+            case OP_CALL:
+                printf("R%u %u\n", ARG_A(instruction), ARG_B(instruction));
+                break;
+            case OP_GET: {
+                uint32_t a = ARG_A(instruction), b = ARG_B(instruction);
+                Atom property = function->code[++pc];
+                printf("R%u R%u .%s\n", a, b, atom_name(property));
+                break;
+            }
+            default:
+                printf("\n");
+                break;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef NUUK_BYTECODE_H
+#define NUUK_BYTECODE_H
+
+#include "value.h"
+#include "E:\THE_LANGUAGE\src\utils\intern.h"
+
+// Instructions are 32-bit words with an 8-bit opcode and operands in one of
+// two layouts:
+//
+//   ABC   | op:8 | A:8 | B:8 | C:8 |
+//   ABx   | op:8 | A:8 |   Bx:16   |    (sBx: Bx minus SBX_BIAS)
+//
+// A, B and C name registers of the running function unless noted. A Bx of
+// BX_WIDE means the real index is in the word that follows the instruction.
+// Conditional branches are followed by a branch word (see BRANCH_WORD) and
+// jump if the truthiness of R[A] is the one the word names.
+typedef uint32_t Instruction;
+
+typedef struct JitCode JitCode;
+
+#define MAX_REGISTERS 256
+#define BX_WIDE 0xffff
+#define SBX_BIAS 0x7fff
+#define BRANCH_BIAS 0x3fffffff
+#define BRANCH_MAX BRANCH_BIAS
+
+typedef enum OpCode {
+    OP_MOVE,        // A B     R[A] = R[B]
+    OP_LOADK,       // A Bx    R[A] = K[Bx]
+    OP_LOADINT,     // A sBx   R[A] = sBx
+    OP_LOADNIL,     // A       R[A] = nil
+    OP_LOADBOOL,    // A B     R[A] = B != 0
+    OP_GETGLOBAL,   // A Bx    R[A] = G[Bx]
+    OP_SETGLOBAL,   // A Bx    G[Bx] = R[A]
+    OP_ADD,         // A B C   R[A] = R[B] + R[C]
+    OP_SUB,         // A B C   R[A] = R[B] - R[C]
+    OP_MUL,         // A B C   R[A] = R[B] * R[C]
+    OP_DIV,         // A B C   R[A] = R[B] / R[C]
+    OP_MOD,         // A B C   R[A] = R[B] % R[C]
+    OP_EQ,          // A B C   R[A] = R[B] == R[C]
+    OP_NEQ,         // A B C   R[A] = R[B] != R[C]
+    OP_LT,          // A B C   R[A] = R[B] < R[C]
+    OP_LE,          // A B C   R[A] = R[B] <= R[C]
+    OP_NEG,         // A B     R[A] = -R[B]
+    OP_NOT,         // A B     R[A] = !R[B]
+    OP_JUMPIF,      // A       branch on R[A]
+    OP_CALL,        // A B     R[A] = R[A](R[A + 1], ..., R[A + B])
+    OP_GET,         // A B     R[A] = R[B].<atom in the next word>
+    OP_RETURN,      // A       return R[A]
+
+    // Superinstructions: each does the work of a pair that opcode profiles
+    // of compiled programs (see VM_COUNT_OPCODES) showed to be common.
+    OP_ADDK,        // A B C   R[A] = R[B] + K[C]          LOADK + ADD
+    OP_SUBK,        // A B C   R[A] = R[B] - K[C]          LOADK + SUB
+    OP_MULK,        // A B C   R[A] = R[B] * K[C]          LOADK + MUL
+    OP_DIVK,        // A B C   R[A] = R[B] / K[C]          LOADK + DIV
+    OP_MODK,        // A B C   R[A] = R[B] % K[C]          LOADK + MOD
+    OP_LT_JUMPIF,   // A B C   R[A] = R[B] < R[C], branch  LT + JUMPIF
+    OP_LE_JUMPIF,   // A B C   R[A] = R[B] <= R[C], branch LE + JUMPIF
+    OP_CALLK,       // A B C   R[A] = K[C](R[A + 1], ..., R[A + B])   LOADK + CALL
+    OP_COUNT
+} OpCode;
+
+#define OP(i) ((OpCode)((i) & 0xff))
+#define ARG_A(i) (((i) >> 8) & 0xff)
+#define ARG_B(i) (((i) >> 16) & 0xff)
+#define ARG_C(i) ((i) >> 24)
+#define ARG_BX(i) ((i) >> 16)
+#define ARG_SBX(i) ((int32_t)ARG_BX(i) - SBX_BIAS)
+
+#define ENCODE_ABC(op, a, b, c) ((Instruction)(op) | (Instruction)(a) << 8 | (Instruction)(b) << 16 | (Instruction)(c) << 24)
+#define ENCODE_ABX(op, a, bx) ((Instruction)(op) | (Instruction)(a) << 8 | (Instruction)(bx) << 16)
+
+// The word after a conditional branch: bit 0 is the truthiness that takes
+// the branch, the rest the distance from the end of the word to the target.
+#define BRANCH_WORD(distance, when) ((Instruction)((distance) + BRANCH_BIAS) << 1 | (Instruction)(when))
+#define BRANCH_DISTANCE(word) ((int32_t)((word) >> 1) - BRANCH_BIAS)
+#define BRANCH_WHEN(word) ((word) & 1)
+
+// Compiled code of one function. `offsets[i]` is the source offset of the
+// expression instruction i was compiled from, for runtime errors. Constants
+// are deduplicated by the compiler; the strings among them live in `arena`.
+// `register_count` is the size of the register file a call needs, and
+// `globals` names the `global_count` global slots of a script, which is the
+// function compiled from the top level of a unit.
+//
+// The rest is the tiering state of the VM (see jit.h): how often the
+// function ran and deoptimized, and its machine code once it is hot.
+typedef struct Function {
+    const char* name;
+    Instruction* code;
+    uint32_t* offsets;
+    size_t size;
+    size_t capacity;
+
+    Value* constants;
+    size_t constant_count;
+    size_t constant_capacity;
+
+    uint32_t register_count;
+    Atom* globals;
+    uint32_t global_count;
+    uint32_t global_capacity;
+
+    Arena* arena;
+
+    uint32_t runs;
+    uint32_t deopts;
+    JitCode* jit;
+    bool jit_disabled;
+} Function;
+
+Function* create_function(const char* name);
+void free_function(Function* function);
+
+// Both return the index of the new entry.
+size_t function_emit(Function* function, Instruction instruction, uint32_t offset);
+size_t function_add_constant(Function* function, Value value);
+uint32_t function_add_global(Function* function, Atom name);
+
+const char* opcode_name(OpCode op);
+// Prints a listing of the function's code to stdout.
+void dprint_function(const Function* function);
+
+#endif
@@ -0,0 +1,684 @@
+#include "compiler.h"
+#include "vm.h"
+
+#include <string.h>
+
+#define NO_REGISTER UINT32_MAX
+
+// Where a variable lives: a global slot of the script or a register.
+// `constant` is set for variables declared `const`.
+typedef struct Slot {
+    uint32_t index;
+    bool global;
+    bool constant;
+} Slot;
+
+// Open-addressing map from constant to its index in the pool, so every
+// distinct constant is stored once however often it is used.
+typedef struct ConstantEntry {
+    Value value;
+    uint32_t hash;
+    uint32_t index;
+    bool used;
+} ConstantEntry;
+
+typedef struct ConstantMap {
+    ConstantEntry* entries;
+    size_t capacity;
+    size_t size;
+} ConstantMap;
+
+// `free_register` is the first register not held by a local or by a
+// temporary of the expression being compiled. `offset` is the source offset
+// recorded for the instructions emitted next.
+typedef struct Compiler {
+    Function* function;
+    bool superinstructions;
+    SymbolTable* symbols;
+    Arena* arena;
+    Diagnostics* diagnostics;
+    ConstantMap constants;
+    uint32_t free_register;
+    uint32_t offset;
+    bool out_of_registers;
+} Compiler;
+
+static void compile_expr(Compiler* self, Expr* expr, uint32_t target);
+static void compile_stmt(Compiler* self, Stmt* stmt);
+
+static void error(Compiler* self, uint32_t offset, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    diagnostics_vadd(self->diagnostics, offset, fmt, args);
+    va_end(args);
+}
+
+// ################################################################
+// # CONSTANTS
+// ################################################################
+
+// Constants are only shared if they are the same value of the same type:
+// 1, 1.0 and '\x01' are three constants. Apart from strings, which are
+// compared by content, that is the case when their bits are the same.
+static uint32_t constant_hash(Value value) {
+    if (IS_STRING(value)) return AS_STRING(value)->hash;
+    return (uint32_t)((value * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+static bool same_constant(Value lhs, Value rhs) {
+    if (IS_STRING(lhs) && IS_STRING(rhs)) return values_equal(lhs, rhs);
+    return lhs == rhs;
+}
+
+static ConstantEntry* find_constant(ConstantMap* map, Value value, uint32_t hash) {
+    size_t mask = map->capacity - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        ConstantEntry* entry = &map->entries[index];
+        if (!entry->used || (entry->hash == hash && same_constant(entry->value, value))) return entry;
+    }
+}
+
+static void grow_constants(ConstantMap* map) {
+    ConstantEntry* old = map->entries;
+    size_t old_capacity = map->capacity;
+
+    map->capacity = old_capacity ? old_capacity * 2 : 64;
+    map->entries = (ConstantEntry*)calloc(map->capacity, sizeof(ConstantEntry));
+    if (!map->entries) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow constant pool.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].used) *find_constant(map, old[i].value, old[i].hash) = old[i];
+    }
+    free(old);
+}
+
+static uint32_t make_constant(Compiler* self, Value value) {
+    ConstantMap* map = &self->constants;
+    if ((map->size + 1) * 4 > map->capacity * 3) grow_constants(map);
+
+    uint32_t hash = constant_hash(value);
+    ConstantEntry* entry = find_constant(map, value, hash);
+    if (!entry->used) {
+        entry->value = value;
+        entry->hash = hash;
+        entry->index = (uint32_t)function_add_constant(self->function, value);
+        entry->used = true;
+        map->size++;
+    }
+    return entry->index;
+}
+
+// ################################################################
+// # EMITTING
+// ################################################################
+
+static void emit(Compiler* self, Instruction instruction) {
+    function_emit(self->function, instruction, self->offset);
+}
+
+static void emit_abc(Compiler* self, OpCode op, uint32_t a, uint32_t b, uint32_t c) {
+    emit(self, ENCODE_ABC(op, a, b, c));
+}
+
+// Indices from BX_WIDE up go into an extra word.
+static void emit_abx(Compiler* self, OpCode op, uint32_t a, uint32_t bx) {
+    if (bx < BX_WIDE) {
+        emit(self, ENCODE_ABX(op, a, bx));
+        return;
+    }
+    emit(self, ENCODE_ABX(op, a, BX_WIDE));
+    emit(self, bx);
+}
+
+// Emits the branch word of the conditional branch just emitted, taken if
+// the truthiness is `when`. patch_branch() sets its target.
+static size_t emit_branch(Compiler* self, bool when) {
+    emit(self, BRANCH_WORD(0, when));
+    return self->function->size - 1;
+}
+
+// Points the branch word at `word` to the next instruction to be emitted.
+static void patch_branch(Compiler* self, size_t word) {
+    size_t distance = self->function->size - word - 1;
+    if (distance > BRANCH_MAX) {
+        error(self, self->function->offsets[word], "Too much code to jump over.");
+        return;
+    }
+    Instruction* code = self->function->code;
+    code[word] = BRANCH_WORD((int32_t)distance, BRANCH_WHEN(code[word]));
+}
+
+static uint32_t reserve_register(Compiler* self) {
+    if (self->free_register == MAX_REGISTERS) {
+        if (!self->out_of_registers) {
+            error(self, self->offset, "Too many variables and temporaries in one function (at most %d).", MAX_REGISTERS);
+            self->out_of_registers = true;
+        }
+        // The script is never run, so any register will do.
+        return MAX_REGISTERS - 1;
+    }
+    uint32_t reg = self->free_register++;
+    if (self->free_register > self->function->register_count) self->function->register_count = self->free_register;
+    return reg;
+}
+
+// ################################################################
+// # EXPRESSIONS
+// ################################################################
+
+static const Slot* resolve(Compiler* self, const Token* name) {
+    const Symbol* symbol = symbol_lookup(self->symbols, name->atom, SYMBOL_VARIABLE);
+    return symbol ? (const Slot*)symbol->value : NULL;
+}
+
+// Whether evaluating `expr` assigns to the local in register `reg`.
+static bool assigns_register(Compiler* self, Expr* expr, uint32_t reg) {
+    switch (expr->type) {
+        case EXPR_BINARY:
+            return assigns_register(self, ((Binary*)expr)->lhs, reg) || assigns_register(self, ((Binary*)expr)->rhs, reg);
+        case EXPR_GROUPING: return assigns_register(self, ((Grouping*)expr)->expr, reg);
+        case EXPR_LOGICAL:
+            return assigns_register(self, ((Logical*)expr)->lhs, reg) || assigns_register(self, ((Logical*)expr)->rhs, reg);
+        case EXPR_UNARY: return assigns_register(self, ((Unary*)expr)->rhs, reg);
+        case EXPR_LITERAL: case EXPR_VARIABLE: return false;
+        case EXPR_ASSIGN: {
+            Assign* assign = (Assign*)expr;
+            const Slot* slot = resolve(self, &assign->name);
+            return (slot && !slot->global && slot->index == reg) || assigns_register(self, assign->value, reg);
+        }
+        case EXPR_GET: return assigns_register(self, ((Get*)expr)->expr, reg);
+        case EXPR_CALL: {
+            Call* call = (Call*)expr;
+            if (assigns_register(self, call->callee, reg)) return true;
+            for (int i = 0; i < call->args.size; i++) {
+                if (assigns_register(self, call->args.elements[i], reg)) return true;
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+// A register holding the value of `expr`: the variable's own register for
+// a local, a new temporary otherwise. `later`, if not NULL, is evaluated
+// before the value is used; if it assigns to the local, the local is copied
+// so that operands still see the values they had from left to right.
+static uint32_t compile_operand(Compiler* self, Expr* expr, Expr* later) {
+    if (expr->type == EXPR_VARIABLE) {
+        const Slot* slot = resolve(self, &((Variable*)expr)->name);
+        if (slot && !slot->global && !(later && assigns_register(self, later, slot->index))) return slot->index;
+    }
+    uint32_t reg = reserve_register(self);
+    compile_expr(self, expr, reg);
+    return reg;
+}
+
+static void compile_literal(Compiler* self, Literal* literal, uint32_t target) {
+    switch (literal->kind) {
+        case LITERAL_INT: {
+            int64_t value = literal->as.integer;
+            if (!int_fits(value)) {
+                error(self, literal->offset, "Integer literal out of range (ints are 48-bit at run time).");
+                value = 0;
+            }
+            if (value >= -SBX_BIAS && value <= 0xffff - SBX_BIAS) {
+                emit(self, ENCODE_ABX(OP_LOADINT, target, (uint32_t)(value + SBX_BIAS)));
+            } else {
+                emit_abx(self, OP_LOADK, target, make_constant(self, INT_VAL(value)));
+            }
+            break;
+        }
+        case LITERAL_FLOAT:
+            emit_abx(self, OP_LOADK, target, make_constant(self, FLOAT_VAL(literal->as.number)));
+            break;
+        case LITERAL_BOOL:
+            emit_abc(self, OP_LOADBOOL, target, literal->as.boolean, 0);
+            break;
+        case LITERAL_CHAR:
+            emit_abx(self, OP_LOADK, target, make_constant(self, CHAR_VAL(literal->as.character)));
+            break;
+        case LITERAL_STRING: {
+            // The text still has its quotes.
+            ObjString* string = copy_string(self->function->arena, literal->value + 1, literal->length - 2);
+            emit_abx(self, OP_LOADK, target, make_constant(self, OBJ_VAL(string)));
+            break;
+        }
+        case LITERAL_ERROR:
+            emit_abc(self, OP_LOADNIL, target, 0, 0);
+            break;
+    }
+}
+
+static void compile_variable(Compiler* self, Variable* variable, uint32_t target) {
+    self->offset = variable->name.offset;
+    const Slot* slot = resolve(self, &variable->name);
+    if (slot) {
+        if (slot->global) emit_abx(self, OP_GETGLOBAL, target, slot->index);
+        else if (slot->index != target) emit_abc(self, OP_MOVE, target, slot->index, 0);
+        return;
+    }
+
+    const ObjNative* native = lookup_native(variable->name.atom);
+    if (native) {
+        emit_abx(self, OP_LOADK, target, make_constant(self, OBJ_VAL(native)));
+        return;
+    }
+    error(self, variable->name.offset, "Undefined variable '" TOKEN_FMT "'.", TOKEN_ARG(&variable->name));
+}
+
+// The opcode of a binary operator. `swap` is set if the operands go in the
+// other order, since a > b is b < a. Returns false for '::'.
+static bool binary_opcode(TokenType type, OpCode* op, bool* swap) {
+    *swap = false;
+    switch (type) {
+        case PLUS: *op = OP_ADD; return true;
+        case MINUS: *op = OP_SUB; return true;
+        case STAR: *op = OP_MUL; return true;
+        case SLASH: *op = OP_DIV; return true;
+        case MOD: *op = OP_MOD; return true;
+        case EQ: *op = OP_EQ; return true;
+        case NEQ: *op = OP_NEQ; return true;
+        case LT: *op = OP_LT; return true;
+        case LTE: *op = OP_LE; return true;
+        case GT: *op = OP_LT; *swap = true; return true;
+        case GTE: *op = OP_LE; *swap = true; return true;
+        default: return false;
+    }
+}
+
+// ################################################################
+// # SUPERINSTRUCTIONS
+// ################################################################
+
+// The constant of a number literal, if it is in the first 256 constants and
+// so fits the C operand of a superinstruction.
+static bool small_constant(Compiler* self, const Expr* expr, uint32_t* index) {
+    if (expr->type != EXPR_LITERAL) return false;
+    const Literal* literal = (const Literal*)expr;
+    Value value;
+    switch (literal->kind) {
+        case LITERAL_INT:
+            // compile_literal() reports ints out of range.
+            if (!int_fits(literal->as.integer)) return false;
+            value = INT_VAL(literal->as.integer);
+            break;
+        case LITERAL_FLOAT: value = FLOAT_VAL(literal->as.number); break;
+        case LITERAL_CHAR: value = CHAR_VAL(literal->as.character); break;
+        default: return false;
+    }
+    *index = make_constant(self, value);
+    return *index <= UINT8_MAX;
+}
+
+// `x op k` for a number literal k: ADDK, ..., MODK instead of loading k
+// into a register first.
+static bool fuse_arithmetic(Compiler* self, Binary* binary, OpCode op, uint32_t target) {
+    uint32_t constant;
+    if (!self->superinstructions || op > OP_MOD || !small_constant(self, binary->rhs, &constant)) return false;
+
+    uint32_t saved = self->free_register;
+    uint32_t lhs = compile_operand(self, binary->lhs, NULL);
+    self->offset = binary->op.offset;
+    // The K forms are in the same order as OP_ADD ... OP_MOD.
+    emit_abc(self, (OpCode)(OP_ADDK + (op - OP_ADD)), target, lhs, constant);
+    self->free_register = saved;
+    return true;
+}
+
+// A comparison that decides an 'and' or 'or': LT_JUMPIF and LE_JUMPIF
+// store the comparison and branch on it in one instruction.
+static bool fuse_compare_branch(Compiler* self, Expr* condition, uint32_t target, bool when, size_t* branch) {
+    while (condition->type == EXPR_GROUPING) condition = ((Grouping*)condition)->expr;
+    if (!self->superinstructions || condition->type != EXPR_BINARY) return false;
+
+    Binary* binary = (Binary*)condition;
+    OpCode op;
+    bool swap;
+    if (!binary_opcode(binary->op.type, &op, &swap) || (op != OP_LT && op != OP_LE)) return false;
+
+    uint32_t saved = self->free_register;
+    uint32_t lhs = compile_operand(self, binary->lhs, binary->rhs);
+    uint32_t rhs = compile_operand(self, binary->rhs, NULL);
+    self->offset = binary->op.offset;
+    op = op == OP_LT ? OP_LT_JUMPIF : OP_LE_JUMPIF;
+    if (swap) emit_abc(self, op, target, rhs, lhs);
+    else emit_abc(self, op, target, lhs, rhs);
+    *branch = emit_branch(self, when);
+    self->free_register = saved;
+    return true;
+}
+
+// A call of a native by name: CALLK takes the callee from the constants
+// instead of loading it into the base register.
+static bool fuse_native_call(Compiler* self, Call* call, uint32_t base) {
+    if (!self->superinstructions || call->callee->type != EXPR_VARIABLE) return false;
+    Variable* callee = (Variable*)call->callee;
+    if (resolve(self, &callee->name)) return false;
+    const ObjNative* native = lookup_native(callee->name.atom);
+    if (!native) return false;
+
+    uint32_t constant = make_constant(self, OBJ_VAL(native));
+    if (constant > UINT8_MAX) return false;
+
+    for (int i = 0; i < call->args.size; i++) {
+        compile_expr(self, call->args.elements[i], reserve_register(self));
+    }
+    self->offset = callee->name.offset;
+    emit_abc(self, OP_CALLK, base, (uint32_t)call->args.size, constant);
+    return true;
+}
+
+// ################################################################
+// # OPERATORS
+// ################################################################
+
+static void compile_binary(Compiler* self, Binary* binary, uint32_t target) {
+    OpCode op;
+    bool swap;
+    if (!binary_opcode(binary->op.type, &op, &swap)) {
+        error(self, binary->op.offset, "Operator '%s' cannot be compiled yet.", token_type_spelling(binary->op.type));
+        return;
+    }
+    if (fuse_arithmetic(self, binary, op, target)) return;
+
+    uint32_t saved = self->free_register;
+    uint32_t lhs = compile_operand(self, binary->lhs, binary->rhs);
+    uint32_t rhs = compile_operand(self, binary->rhs, NULL);
+    self->offset = binary->op.offset;
+    if (swap) emit_abc(self, op, target, rhs, lhs);
+    else emit_abc(self, op, target, lhs, rhs);
+    self->free_register = saved;
+}
+
+// `a and b` is a if a is falsey and b otherwise; `a or b` is a if a is
+// truthy and b otherwise. Either way b is only evaluated if it is the result.
+static void compile_logical(Compiler* self, Logical* logical, uint32_t target) {
+    // 'and' is decided by a falsey left side, 'or' by a truthy one.
+    bool when = logical->op.type == OR;
+    size_t branch;
+    if (!fuse_compare_branch(self, logical->lhs, target, when, &branch)) {
+        compile_expr(self, logical->lhs, target);
+        self->offset = logical->op.offset;
+        emit_abc(self, OP_JUMPIF, target, 0, 0);
+        branch = emit_branch(self, when);
+    }
+    compile_expr(self, logical->rhs, target);
+    patch_branch(self, branch);
+}
+
+static void compile_unary(Compiler* self, Unary* unary, uint32_t target) {
+    OpCode op;
+    switch (unary->op.type) {
+        case MINUS: op = OP_NEG; break;
+        case BANG: op = OP_NOT; break;
+        default:
+            error(self, unary->op.offset, "Operator '%s' cannot be compiled yet.", token_type_spelling(unary->op.type));
+            return;
+    }
+
+    uint32_t saved = self->free_register;
+    uint32_t operand = compile_operand(self, unary->rhs, NULL);
+    self->offset = unary->op.offset;
+    emit_abc(self, op, target, operand, 0);
+    self->free_register = saved;
+}
+
+static OpCode compound_op(TokenType type) {
+    switch (type) {
+        case PLUS_EQ: return OP_ADD;
+        case MINUS_EQ: return OP_SUB;
+        case STAR_EQ: return OP_MUL;
+        case SLASH_EQ: return OP_DIV;
+        default: return OP_MOVE;
+    }
+}
+
+// Whether compiling `expr` into a register writes that register only with
+// its last instruction, after every operand has been read. 'and', 'or',
+// calls and assignments store into their target along the way.
+static bool writes_target_last(const Expr* expr) {
+    switch (expr->type) {
+        case EXPR_GROUPING: return writes_target_last(((const Grouping*)expr)->expr);
+        case EXPR_BINARY: case EXPR_LITERAL: case EXPR_UNARY: case EXPR_VARIABLE: case EXPR_GET: return true;
+        default: return false;
+    }
+}
+
+// With `target` set to NO_REGISTER the assigned value is not needed, which
+// saves the copy for assignments used as statements.
+static void compile_assign(Compiler* self, Assign* assign, uint32_t target) {
+    self->offset = assign->name.offset;
+    const Slot* slot = resolve(self, &assign->name);
+    if (!slot) {
+        error(self, assign->name.offset, "Undefined variable '" TOKEN_FMT "'.", TOKEN_ARG(&assign->name));
+        return;
+    }
+    if (slot->constant) {
+        error(self, assign->name.offset, "Cannot assign to constant '" TOKEN_FMT "'.", TOKEN_ARG(&assign->name));
+        return;
+    }
+
+    OpCode op = compound_op(assign->op.type);
+    uint32_t saved = self->free_register;
+
+    if (!slot->global) {
+        if (op == OP_MOVE && writes_target_last(assign->value)) {
+            compile_expr(self, assign->value, slot->index);
+        } else if (op == OP_MOVE) {
+            // The value may set its target before it is done reading the
+            // variable, so it is built in a temporary.
+            uint32_t value = reserve_register(self);
+            compile_expr(self, assign->value, value);
+            self->offset = assign->op.offset;
+            emit_abc(self, OP_MOVE, slot->index, value, 0);
+        } else {
+            // `x += (x = 5)` adds to the old x, as it does for a global.
+            uint32_t old = slot->index;
+            if (assigns_register(self, assign->value, slot->index)) {
+                old = reserve_register(self);
+                emit_abc(self, OP_MOVE, old, slot->index, 0);
+            }
+            uint32_t value = compile_operand(self, assign->value, NULL);
+            self->offset = assign->op.offset;
+            emit_abc(self, op, slot->index, old, value);
+        }
+        if (target != NO_REGISTER && target != slot->index) emit_abc(self, OP_MOVE, target, slot->index, 0);
+        self->free_register = saved;
+        return;
+    }
+
+    uint32_t reg = target != NO_REGISTER ? target : reserve_register(self);
+    if (op == OP_MOVE) {
+        compile_expr(self, assign->value, reg);
+    } else {
+        emit_abx(self, OP_GETGLOBAL, reg, slot->index);
+        uint32_t value = compile_operand(self, assign->value, NULL);
+        self->offset = assign->op.offset;
+        emit_abc(self, op, reg, reg, value);
+    }
+    emit_abx(self, OP_SETGLOBAL, reg, slot->index);
+    self->free_register = saved;
+}
+
+static void compile_get(Compiler* self, Get* get, uint32_t target) {
+    uint32_t saved = self->free_register;
+    uint32_t object = compile_operand(self, get->expr, NULL);
+    self->offset = get->property.offset;
+    emit_abc(self, OP_GET, target, object, 0);
+    emit(self, get->property.atom);
+    self->free_register = saved;
+}
+
+// The callee and its arguments go into consecutive registers, where the
+// result replaces the callee. If nothing is above `target` the call is made
+// right there; otherwise it starts at a fresh register.
+static void compile_call(Compiler* self, Call* call, uint32_t target) {
+    uint32_t saved = self->free_register;
+    uint32_t base = target + 1 == self->free_register ? target : reserve_register(self);
+    if (fuse_native_call(self, call, base)) {
+        if (target != base) emit_abc(self, OP_MOVE, target, base, 0);
+        self->free_register = saved;
+        return;
+    }
+
+    compile_expr(self, call->callee, base);
+    uint32_t offset = self->offset;
+
+    for (int i = 0; i < call->args.size; i++) {
+        compile_expr(self, call->args.elements[i], reserve_register(self));
+    }
+    self->offset = offset;
+    emit_abc(self, OP_CALL, base, (uint32_t)call->args.size, 0);
+    if (target != base) emit_abc(self, OP_MOVE, target, base, 0);
+    self->free_register = saved;
+}
+
+static void compile_expr(Compiler* self, Expr* expr, uint32_t target) {
+    switch (expr->type) {
+        case EXPR_BINARY: compile_binary(self, (Binary*)expr, target); break;
+        case EXPR_GROUPING: compile_expr(self, ((Grouping*)expr)->expr, target); break;
+        case EXPR_LITERAL: compile_literal(self, (Literal*)expr, target); break;
+        case EXPR_LOGICAL: compile_logical(self, (Logical*)expr, target); break;
+        case EXPR_UNARY: compile_unary(self, (Unary*)expr, target); break;
+        case EXPR_VARIABLE: compile_variable(self, (Variable*)expr, target); break;
+        case EXPR_ASSIGN: compile_assign(self, (Assign*)expr, target); break;
+        case EXPR_GET: compile_get(self, (Get*)expr, target); break;
+        case EXPR_CALL: compile_call(self, (Call*)expr, target); break;
+    }
+}
+
+// ################################################################
+// # STATEMENTS
+// ################################################################
+
+// The value of a variable declared without one: zero of its builtin type,
+// nil for everything else.
+static void compile_default(Compiler* self, const Datatype* type, uint32_t target) {
+    const char* name = type->type == TYPEID_BASIC ? atom_name(((const BasicType*)type)->name) : "";
+    if (strcmp(name, "float") == 0 || strcmp(name, "double") == 0) {
+        emit_abx(self, OP_LOADK, target, make_constant(self, FLOAT_VAL(0.0)));
+    } else if (strcmp(name, "bool") == 0) {
+        emit_abc(self, OP_LOADBOOL, target, 0, 0);
+    } else if (strcmp(name, "char") == 0) {
+        emit_abx(self, OP_LOADK, target, make_constant(self, CHAR_VAL('\0')));
+    } else if (strcmp(name, "int") == 0 || strcmp(name, "uint") == 0 || strcmp(name, "usize") == 0 || strcmp(name, "isize") == 0) {
+        emit(self, ENCODE_ABX(OP_LOADINT, target, SBX_BIAS));
+    } else {
+        emit_abc(self, OP_LOADNIL, target, 0, 0);
+    }
+}
+
+// The variable is declared after its initializer is compiled, so a name in
+// the initializer still refers to the outer variable.
+static void compile_variable_decl(Compiler* self, VariableDecl* var) {
+    self->offset = var->name.offset;
+    Slot* slot = (Slot*)arena_alloc(self->arena, sizeof(Slot));
+    slot->constant = var->mutability;
+    slot->global = self->symbols->depth == 0;
+
+    uint32_t reg = reserve_register(self);
+    if (var->value) compile_expr(self, var->value, reg);
+    else compile_default(self, var->type, reg);
+
+    if (slot->global) {
+        slot->index = function_add_global(self->function, var->name.atom);
+        self->offset = var->name.offset;
+        emit_abx(self, OP_SETGLOBAL, reg, slot->index);
+        // Only the temporary goes away.
+        self->free_register = reg;
+    } else {
+        slot->index = reg;
+    }
+    symbol_declare(self->symbols, var->name.atom, SYMBOL_VARIABLE, slot);
+}
+
+static void compile_block(Compiler* self, Block* block) {
+    uint32_t saved = self->free_register;
+    symbol_push_scope(self->symbols);
+    for (int i = 0; i < block->body->size; i++) {
+        compile_stmt(self, block->body->elements[i]);
+    }
+    symbol_pop_scope(self->symbols);
+    self->free_register = saved;
+}
+
+// Where the source of `expr` begins, for errors about the statement that
+// holds it.
+static uint32_t expr_offset(Compiler* self, Expr* expr) {
+    switch (expr->type) {
+        case EXPR_BINARY: return expr_offset(self, ((Binary*)expr)->lhs);
+        case EXPR_GROUPING: return expr_offset(self, ((Grouping*)expr)->expr);
+        case EXPR_LOGICAL: return expr_offset(self, ((Logical*)expr)->lhs);
+        case EXPR_UNARY: return ((Unary*)expr)->op.offset;
+        case EXPR_VARIABLE: return ((Variable*)expr)->name.offset;
+        case EXPR_ASSIGN: return ((Assign*)expr)->name.offset;
+        case EXPR_GET: return expr_offset(self, ((Get*)expr)->expr);
+        case EXPR_CALL: return expr_offset(self, ((Call*)expr)->callee);
+        case EXPR_LITERAL: return ((Literal*)expr)->offset;
+    }
+    return self->offset;
+}
+
+static void compile_stmt(Compiler* self, Stmt* stmt) {
+    uint32_t saved = self->free_register;
+
+    switch (stmt->type) {
+        case STMT_EXPRESSION: {
+            Expr* expr = ((Expression*)stmt)->expr;
+            if (expr->type == EXPR_ASSIGN) compile_assign(self, (Assign*)expr, NO_REGISTER);
+            else compile_expr(self, expr, reserve_register(self));
+            break;
+        }
+        case STMT_BLOCK:
+            compile_block(self, (Block*)stmt);
+            break;
+        case STMT_RETURN: {
+            uint32_t value = compile_operand(self, ((Return*)stmt)->value, NULL);
+            emit_abc(self, OP_RETURN, value, 0, 0);
+            break;
+        }
+        case STMT_VAR:
+            compile_variable_decl(self, (VariableDecl*)stmt);
+            // The variable's register, if it has one, stays taken.
+            return;
+        case STMT_IMPORT:
+            break;
+        case STMT_EXPAND:
+            error(self, expr_offset(self, ((Expand*)stmt)->value), "'expand' statements cannot be compiled yet.");
+            break;
+        case STMT_USE:
+            error(self, expr_offset(self, ((Use*)stmt)->value), "'use' statements cannot be compiled yet.");
+            break;
+    }
+    self->free_register = saved;
+}
+
+Function* compile_unit(const CompilationUnit* unit, Diagnostics* diagnostics, bool superinstructions) {
+    Compiler compiler = { 0 };
+    compiler.function = create_function("<script>");
+    compiler.superinstructions = superinstructions;
+    compiler.symbols = create_symbol_table(NULL);
+    compiler.arena = create_arena(ARENA_BLOCK_SIZE);
+    compiler.diagnostics = diagnostics;
+
+    size_t errors = diagnostics->size;
+    for (int i = 0; i < unit->stmts.size; i++) {
+        compile_stmt(&compiler, unit->stmts.elements[i]);
+    }
+    // Falling off the end returns nil.
+    uint32_t reg = reserve_register(&compiler);
+    emit_abc(&compiler, OP_LOADNIL, reg, 0, 0);
+    emit_abc(&compiler, OP_RETURN, reg, 0, 0);
+
+    free(compiler.constants.entries);
+    free_arena(compiler.arena);
+    free_symbol_table(compiler.symbols);
+
+    if (diagnostics->size > errors) {
+        free_function(compiler.function);
+        return NULL;
+    }
+    return compiler.function;
+}
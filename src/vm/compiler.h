@@ -0,0 +1,27 @@
+#ifndef NUUK_COMPILER_H
+#define NUUK_COMPILER_H
+
+#include "bytecode.h"
+#include "E:\THE_LANGUAGE\src\parser\parser.h"
+
+// Compiles the top-level statements of `unit`, which must have parsed
+// without errors, into a script function.
+//
+// Variables declared at the top level become global slots of the script;
+// variables declared in a block live in registers, which are released again
+// at the end of the block, as are the temporaries of each statement. Every
+// name is resolved at compile time, so no instruction looks a variable up by
+// name. Names that are not declared fall back to the natives of vm.h.
+//
+// Constructs that have no runtime meaning yet ('::', the pointer operators,
+// expand and use) and semantic errors (undefined names, assignments to
+// constants, more than MAX_REGISTERS live registers) are added to
+// `diagnostics`, and NULL is returned if there were any. Import statements
+// compile to nothing: the modules they name are loaded by the module graph.
+//
+// With `superinstructions` set, common instruction pairs are emitted as one
+// fused instruction (see bytecode.h); without, the same program is compiled
+// to base instructions only, e.g. to measure what fusing gains.
+Function* compile_unit(const CompilationUnit* unit, Diagnostics* diagnostics, bool superinstructions);
+
+#endif
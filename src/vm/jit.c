@@ -0,0 +1,1278 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include "jit.h"
+#include "vm.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// The machine code of a function is one System V function. It returns what
+// jit_enter() returns.
+typedef size_t (*JitEntry)(VM* vm, Value* registers, Value* globals, Value* result);
+
+struct JitCode {
+    void* memory;
+    size_t size;
+    JitEntry entry;
+};
+
+bool jit_available() {
+#ifdef JIT_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef JIT_SUPPORTED
+
+// ################################################################
+// # ASSEMBLER
+// ################################################################
+
+typedef enum Reg {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+} Reg;
+
+// The machine code keeps these in callee-saved registers, so the calls to
+// natives and helpers do not disturb them.
+#define REGISTERS RBX
+#define GLOBALS R12
+#define VM_REG R14
+#define RESULT R15
+#define INT_TAG RBP
+#define FALSE_REG R13
+
+typedef enum Cond {
+    CC_O = 0x0,
+    CC_B = 0x2,
+    CC_AE = 0x3,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_A = 0x7,
+    CC_P = 0xa,
+    CC_NP = 0xb,
+    CC_L = 0xc,
+    CC_LE = 0xe,
+} Cond;
+
+// Code that runs when guards hold goes to HOT. Slow paths and deopt stubs
+// go to COLD, which is placed after it, so the hot code stays dense.
+typedef enum Section {
+    HOT,
+    COLD,
+} Section;
+
+typedef struct Buffer {
+    uint8_t* bytes;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+typedef struct Label {
+    Section section;
+    size_t offset;
+    bool bound;
+} Label;
+
+// The rel32 at `at` in `section` jumps to `label`.
+typedef struct Fixup {
+    Section section;
+    size_t at;
+    uint32_t label;
+} Fixup;
+
+#define NO_LABEL UINT32_MAX
+#define NO_REGISTER UINT32_MAX
+
+// What the machine code knows about the value of a register or global where
+// an instruction starts. Every run starts with all of them nil, the only
+// values that come from outside are the results of calls and property gets,
+// and jumps only go forward. So one pass over the code in order finds the
+// type each one has on every path that is still in machine code; a path
+// whose guard failed has deoptimized. KNOWN_NONE is where no path has
+// arrived yet.
+typedef enum Known {
+    KNOWN_NONE,
+    KNOWN_INT,
+    KNOWN_FLOAT,
+    KNOWN_BOOL,
+    KNOWN_ANY,
+} Known;
+
+// Labels 0 to function->size - 1 are the instructions of the function.
+typedef struct Assembler {
+    const Function* function;
+    Buffer sections[2];
+    Section section;
+
+    Label* labels;
+    size_t label_count;
+    size_t label_capacity;
+    Fixup* fixups;
+    size_t fixup_count;
+    size_t fixup_capacity;
+
+    uint32_t* deopt_labels;
+    bool* targets;
+    // What is known about each register and then each global where the
+    // instruction being compiled starts, and for each jump target, what the
+    // jumps to it bring along.
+    uint8_t* known;
+    uint8_t** incoming;
+    size_t known_size;
+    uint32_t fail_label;
+    uint32_t exit_label;
+    size_t pc;
+    // The register of the function whose value RAX holds, if any, and
+    // whether RAX holds it as an int shifted left by 16 (see load_shifted).
+    uint32_t cached;
+    bool shifted;
+    // The register whose float xmm0 also holds, if any.
+    uint32_t float_cached;
+    bool ok;
+} Assembler;
+
+static void* grow(void* array, size_t* capacity, size_t width) {
+    size_t grown = *capacity ? *capacity * 2 : 256;
+    array = realloc(array, grown * width);
+    if (!array) {
+        fprintf(stderr, "FATAL ERROR: Failed to grow machine code.\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = grown;
+    return array;
+}
+
+static void emit_byte(Assembler* self, uint8_t byte) {
+    Buffer* buffer = &self->sections[self->section];
+    if (buffer->size == buffer->capacity) buffer->bytes = (uint8_t*)grow(buffer->bytes, &buffer->capacity, 1);
+    buffer->bytes[buffer->size++] = byte;
+}
+
+static void emit_u32(Assembler* self, uint32_t value) {
+    for (int i = 0; i < 4; i++) emit_byte(self, (uint8_t)(value >> (i * 8)));
+}
+
+static void emit_u64(Assembler* self, uint64_t value) {
+    for (int i = 0; i < 8; i++) emit_byte(self, (uint8_t)(value >> (i * 8)));
+}
+
+static uint32_t new_label(Assembler* self) {
+    if (self->label_count == self->label_capacity) {
+        self->labels = (Label*)grow(self->labels, &self->label_capacity, sizeof(Label));
+    }
+    self->labels[self->label_count] = (Label){ HOT, 0, false };
+    return (uint32_t)self->label_count++;
+}
+
+static void bind(Assembler* self, uint32_t label) {
+    self->labels[label] = (Label){ self->section, self->sections[self->section].size, true };
+}
+
+static void emit_rel32(Assembler* self, uint32_t label) {
+    if (self->fixup_count == self->fixup_capacity) {
+        self->fixups = (Fixup*)grow(self->fixups, &self->fixup_capacity, sizeof(Fixup));
+    }
+    self->fixups[self->fixup_count++] = (Fixup){ self->section, self->sections[self->section].size, label };
+    emit_u32(self, 0);
+}
+
+// The REX prefix for a ModRM with `reg` and `rm`, left out when empty.
+static void emit_rex(Assembler* self, bool wide, int reg, int rm) {
+    uint8_t rex = (uint8_t)(0x40 | (wide ? 8 : 0) | (reg & 8) >> 1 | (rm & 8) >> 3);
+    if (rex != 0x40) emit_byte(self, rex);
+}
+
+static void emit_modrm_reg(Assembler* self, int reg, int rm) {
+    emit_byte(self, (uint8_t)(0xc0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+// [base + disp] with the shortest displacement.
+static void emit_modrm_mem(Assembler* self, int reg, Reg base, int32_t disp) {
+    bool short_disp = disp >= -128 && disp <= 127;
+    emit_byte(self, (uint8_t)((short_disp ? 0x40 : 0x80) | (reg & 7) << 3 | (base & 7)));
+    if ((base & 7) == RSP) emit_byte(self, 0x24);
+    if (short_disp) emit_byte(self, (uint8_t)disp);
+    else emit_u32(self, (uint32_t)disp);
+}
+
+// op r/m64, r64 on two registers.
+#define X_MOV 0x89
+#define X_ADD 0x01
+#define X_SUB 0x29
+#define X_CMP 0x39
+#define X_XOR 0x31
+#define X_OR 0x09
+#define X_TEST 0x85
+
+static void emit_rr(Assembler* self, uint8_t opcode, Reg dst, Reg src) {
+    emit_rex(self, true, src, dst);
+    emit_byte(self, opcode);
+    emit_modrm_reg(self, src, dst);
+}
+
+static void emit_load(Assembler* self, Reg dst, Reg base, int32_t disp) {
+    emit_rex(self, true, dst, base);
+    emit_byte(self, 0x8b);
+    emit_modrm_mem(self, dst, base, disp);
+}
+
+static void emit_store(Assembler* self, Reg base, int32_t disp, Reg src) {
+    emit_rex(self, true, src, base);
+    emit_byte(self, 0x89);
+    emit_modrm_mem(self, src, base, disp);
+}
+
+static void emit_lea(Assembler* self, Reg dst, Reg base, int32_t disp) {
+    emit_rex(self, true, dst, base);
+    emit_byte(self, 0x8d);
+    emit_modrm_mem(self, dst, base, disp);
+}
+
+// mov qword [base + disp], imm32 (sign-extended)
+static void emit_store_imm32(Assembler* self, Reg base, int32_t disp, int32_t imm) {
+    emit_rex(self, true, 0, base);
+    emit_byte(self, 0xc7);
+    emit_modrm_mem(self, 0, base, disp);
+    emit_u32(self, (uint32_t)imm);
+}
+
+static void emit_mov_imm(Assembler* self, Reg dst, uint64_t imm) {
+    if (imm <= UINT32_MAX) {
+        emit_rex(self, false, 0, dst);
+        emit_byte(self, (uint8_t)(0xb8 + (dst & 7)));
+        emit_u32(self, (uint32_t)imm);
+    } else if ((int64_t)imm >= INT32_MIN && (int64_t)imm <= INT32_MAX) {
+        emit_rex(self, true, 0, dst);
+        emit_byte(self, 0xc7);
+        emit_modrm_reg(self, 0, dst);
+        emit_u32(self, (uint32_t)imm);
+    } else {
+        emit_rex(self, true, 0, dst);
+        emit_byte(self, (uint8_t)(0xb8 + (dst & 7)));
+        emit_u64(self, imm);
+    }
+}
+
+// The /digit of the group opcodes.
+#define X_SHL 4
+#define X_SHR 5
+#define X_SAR 7
+#define X_NEG 3
+#define X_IMUL 5
+#define X_IDIV 7
+
+static void emit_shift(Assembler* self, int kind, Reg reg, uint8_t count) {
+    emit_rex(self, true, 0, reg);
+    emit_byte(self, 0xc1);
+    emit_modrm_reg(self, kind, reg);
+    emit_byte(self, count);
+}
+
+// add or sub r64, imm32 (sign-extended)
+#define X_ADD_IMM 0
+#define X_SUB_IMM 5
+
+static void emit_alu_imm32(Assembler* self, int kind, Reg reg, int32_t imm) {
+    emit_rex(self, true, 0, reg);
+    emit_byte(self, 0x81);
+    emit_modrm_reg(self, kind, reg);
+    emit_u32(self, (uint32_t)imm);
+}
+
+// cmp r64, imm8 (sign-extended)
+static void emit_cmp_imm8(Assembler* self, Reg reg, int8_t imm) {
+    emit_rex(self, true, 0, reg);
+    emit_byte(self, 0x83);
+    emit_modrm_reg(self, 7, reg);
+    emit_byte(self, (uint8_t)imm);
+}
+
+// or r64, imm8 (sign-extended)
+static void emit_or_imm8(Assembler* self, Reg reg, int8_t imm) {
+    emit_rex(self, true, 0, reg);
+    emit_byte(self, 0x83);
+    emit_modrm_reg(self, 1, reg);
+    emit_byte(self, (uint8_t)imm);
+}
+
+static void emit_imul(Assembler* self, Reg dst, Reg src) {
+    emit_rex(self, true, dst, src);
+    emit_byte(self, 0x0f);
+    emit_byte(self, 0xaf);
+    emit_modrm_reg(self, dst, src);
+}
+
+// imul dst, src, imm32
+static void emit_imul_imm32(Assembler* self, Reg dst, Reg src, int32_t imm) {
+    emit_rex(self, true, dst, src);
+    emit_byte(self, 0x69);
+    emit_modrm_reg(self, dst, src);
+    emit_u32(self, (uint32_t)imm);
+}
+
+static void emit_unary(Assembler* self, int kind, Reg reg) {
+    emit_rex(self, true, 0, reg);
+    emit_byte(self, 0xf7);
+    emit_modrm_reg(self, kind, reg);
+}
+
+// AL = cc, then EAX = AL.
+static void emit_setcc(Assembler* self, Cond cc) {
+    emit_byte(self, 0x0f);
+    emit_byte(self, (uint8_t)(0x90 | cc));
+    emit_byte(self, 0xc0);
+}
+
+static void emit_movzx_al(Assembler* self) {
+    emit_byte(self, 0x0f);
+    emit_byte(self, 0xb6);
+    emit_byte(self, 0xc0);
+}
+
+// An SSE2 instruction on xmm registers, or between one and a 64-bit
+// register when `wide`.
+#define X_ADDSD 0x58
+#define X_MULSD 0x59
+#define X_SUBSD 0x5c
+#define X_DIVSD 0x5e
+
+static void emit_sse(Assembler* self, uint8_t prefix, uint8_t opcode, int reg, int rm, bool wide) {
+    emit_byte(self, prefix);
+    emit_rex(self, wide, reg, rm);
+    emit_byte(self, 0x0f);
+    emit_byte(self, opcode);
+    emit_modrm_reg(self, reg, rm);
+}
+
+static void emit_jump(Assembler* self, uint32_t label) {
+    emit_byte(self, 0xe9);
+    emit_rel32(self, label);
+}
+
+static void emit_branch(Assembler* self, Cond cc, uint32_t label) {
+    emit_byte(self, 0x0f);
+    emit_byte(self, (uint8_t)(0x80 | cc));
+    emit_rel32(self, label);
+}
+
+static void emit_call(Assembler* self, uint64_t address) {
+    self->cached = NO_REGISTER;
+    self->float_cached = NO_REGISTER;
+    emit_mov_imm(self, RAX, address);
+    emit_byte(self, 0xff);
+    emit_modrm_reg(self, 2, RAX);
+}
+
+// ################################################################
+// # TYPES
+// ################################################################
+
+static Known known(Assembler* self, size_t index) {
+    return index < self->known_size ? (Known)self->known[index] : KNOWN_ANY;
+}
+
+static void set_known(Assembler* self, size_t index, Known type) {
+    if (index < self->known_size) self->known[index] = (uint8_t)type;
+}
+
+static size_t global_known(Assembler* self, uint32_t index) {
+    return self->function->register_count + (size_t)index;
+}
+
+static Known constant_known(Value value) {
+    if (IS_INT(value)) return KNOWN_INT;
+    return IS_FLOAT(value) ? KNOWN_FLOAT : KNOWN_ANY;
+}
+
+static Known join(Known a, Known b) {
+    if (a == KNOWN_NONE) return b;
+    if (b == KNOWN_NONE) return a;
+    return a == b ? a : KNOWN_ANY;
+}
+
+// The code jumps to `target` with what is known now.
+static void leave_to(Assembler* self, size_t target) {
+    uint8_t** incoming = &self->incoming[target];
+    if (!*incoming) {
+        *incoming = (uint8_t*)calloc(self->known_size ? self->known_size : 1, 1);
+        if (!*incoming) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    for (size_t i = 0; i < self->known_size; i++) {
+        (*incoming)[i] = (uint8_t)join((Known)(*incoming)[i], (Known)self->known[i]);
+    }
+}
+
+// After a jump or a return, the next instruction is only reached by jumps.
+static void forget_all(Assembler* self) {
+    memset(self->known, KNOWN_NONE, self->known_size);
+}
+
+static void arrive_at(Assembler* self, size_t pc) {
+    uint8_t* incoming = self->incoming[pc];
+    if (!incoming) return;
+    for (size_t i = 0; i < self->known_size; i++) {
+        self->known[i] = (uint8_t)join((Known)self->known[i], (Known)incoming[i]);
+    }
+}
+
+// ################################################################
+// # VALUES
+// ################################################################
+
+static int32_t slot(uint32_t index) {
+    return (int32_t)(index * sizeof(Value));
+}
+
+// Loading a register into RAX reuses the value RAX already holds, and then
+// forgets it, as the instruction is about to change RAX. Results that are
+// stored from RAX become its value again, which saves the load in the next
+// instruction.
+static void load(Assembler* self, Reg dst, uint32_t r) {
+    bool cached = self->cached == r, shifted = cached && self->shifted;
+    if (dst == RAX) self->cached = NO_REGISTER;
+    if (!cached) emit_load(self, dst, REGISTERS, slot(r));
+    else if (dst != RAX) emit_rr(self, X_MOV, dst, RAX);
+    if (shifted) {
+        emit_shift(self, X_SHR, dst, 16);
+        emit_rr(self, X_OR, dst, INT_TAG);
+    }
+}
+
+// Loads a register that holds an int shifted left by 16, which drops its
+// tag: the form ints are added, subtracted, multiplied and compared in.
+static void load_shifted(Assembler* self, Reg dst, uint32_t r) {
+    bool cached = self->cached == r, shifted = cached && self->shifted;
+    if (dst == RAX) self->cached = NO_REGISTER;
+    if (!cached) emit_load(self, dst, REGISTERS, slot(r));
+    else if (dst != RAX) emit_rr(self, X_MOV, dst, RAX);
+    if (!shifted) emit_shift(self, X_SHL, dst, 16);
+}
+
+static void store(Assembler* self, uint32_t r, Reg src) {
+    emit_store(self, REGISTERS, slot(r), src);
+    if (self->float_cached == r) self->float_cached = NO_REGISTER;
+    if (src == RAX) {
+        self->cached = r;
+        self->shifted = false;
+    } else if (self->cached == r) {
+        self->cached = NO_REGISTER;
+    }
+}
+
+// Stores the int RAX holds shifted left by 16, boxing a copy, and leaves
+// RAX as it is for the next instruction, which saves tagging the int and
+// untagging it again. Cold code cannot join a path that does this.
+static void store_shifted(Assembler* self, uint32_t r) {
+    emit_rr(self, X_MOV, RDX, RAX);
+    emit_shift(self, X_SHR, RDX, 16);
+    emit_rr(self, X_OR, RDX, INT_TAG);
+    emit_store(self, REGISTERS, slot(r), RDX);
+    if (self->float_cached == r) self->float_cached = NO_REGISTER;
+    self->cached = r;
+    self->shifted = true;
+}
+
+// Cold code starts from nothing known. Every cold path jumps back to where
+// the hot one left RAX as it is after the hot path.
+static uint32_t enter_cold(Assembler* self) {
+    uint32_t cached = self->cached;
+    self->section = COLD;
+    self->cached = NO_REGISTER;
+    self->float_cached = NO_REGISTER;
+    return cached;
+}
+
+// Cold code may change xmm0 before it jumps back.
+static void leave_cold(Assembler* self, uint32_t cached) {
+    self->section = HOT;
+    self->cached = cached;
+    self->shifted = false;
+    self->float_cached = NO_REGISTER;
+}
+
+// The deopt stub of the instruction being compiled; the stubs are emitted
+// once the whole function is.
+static uint32_t deopt_label(Assembler* self) {
+    if (self->deopt_labels[self->pc] == NO_LABEL) self->deopt_labels[self->pc] = new_label(self);
+    return self->deopt_labels[self->pc];
+}
+
+// Jumps to `label` unless `reg` holds an int. The checks below clobber RDX
+// and leave the register they check alone.
+static void guard_int(Assembler* self, Reg reg, uint32_t label) {
+    emit_rr(self, X_MOV, RDX, reg);
+    emit_shift(self, X_SAR, RDX, 48);
+    emit_cmp_imm8(self, RDX, (int8_t)(VALUE_TAG_INT >> 48));
+    emit_branch(self, CC_NE, label);
+}
+
+static void untag_int(Assembler* self, Reg reg) {
+    emit_shift(self, X_SHL, reg, 16);
+    emit_shift(self, X_SAR, reg, 16);
+}
+
+// RAX = INT_VAL(RAX) for an int known to fit in 48 bits.
+static void tag_int(Assembler* self) {
+    emit_shift(self, X_SHL, RAX, 16);
+    emit_shift(self, X_SHR, RAX, 16);
+    emit_rr(self, X_OR, RAX, INT_TAG);
+}
+
+// RAX = INT_VAL(RAX), deoptimizing if it does not fit in 48 bits.
+static void box_int(Assembler* self, uint32_t deopt) {
+    emit_rr(self, X_MOV, RDX, RAX);
+    untag_int(self, RDX);
+    emit_rr(self, X_CMP, RDX, RAX);
+    emit_branch(self, CC_NE, deopt);
+    tag_int(self);
+}
+
+// xmm = the int or float in `reg`, whose type is `type`; anything else
+// deoptimizes.
+static void to_double(Assembler* self, Reg reg, int xmm, Known type, uint32_t deopt) {
+    if (xmm == 0) self->float_cached = NO_REGISTER;
+    if (type == KNOWN_FLOAT) {
+        emit_sse(self, 0x66, 0x6e, xmm, reg, true);    // movq xmm, reg
+        return;
+    }
+    if (type == KNOWN_INT) {
+        untag_int(self, reg);
+        emit_sse(self, 0xf2, 0x2a, xmm, reg, true);    // cvtsi2sd
+        return;
+    }
+    uint32_t is_float = new_label(self), next = new_label(self);
+    emit_rr(self, X_MOV, RDX, reg);
+    emit_shift(self, X_SAR, RDX, 50);
+    emit_cmp_imm8(self, RDX, -1);
+    emit_branch(self, CC_NE, is_float);
+    guard_int(self, reg, deopt);
+    untag_int(self, reg);
+    emit_sse(self, 0xf2, 0x2a, xmm, reg, true);    // cvtsi2sd
+    emit_jump(self, next);
+    bind(self, is_float);
+    emit_sse(self, 0x66, 0x6e, xmm, reg, true);    // movq xmm, reg
+    bind(self, next);
+}
+
+// xmm = R[r] as a double, for the int or float of type `type` it holds,
+// using RAX for xmm0 and RCX otherwise.
+static void load_double(Assembler* self, int xmm, uint32_t r, Known type, uint32_t deopt) {
+    Reg reg = xmm ? RCX : RAX;
+    if (self->float_cached == r) {
+        if (xmm) emit_sse(self, 0x66, 0x28, xmm, 0, false);    // movapd xmm, xmm0
+        return;
+    }
+    if (type != KNOWN_INT) {
+        load(self, reg, r);
+        to_double(self, reg, xmm, type, deopt);
+        return;
+    }
+    if (xmm == 0) self->float_cached = NO_REGISTER;
+    load_shifted(self, reg, r);
+    emit_shift(self, X_SAR, reg, 16);
+    emit_sse(self, 0xf2, 0x2a, xmm, reg, true);    // cvtsi2sd
+}
+
+// xmm1 = an int or float constant as a double.
+static void double_constant(Assembler* self, Value constant) {
+    emit_mov_imm(self, RCX, IS_FLOAT(constant) ? constant : FLOAT_VAL((double)AS_INT(constant)));
+    emit_sse(self, 0x66, 0x6e, 1, RCX, true);      // movq xmm1, rcx
+}
+
+// RAX = FLOAT_VAL(xmm0), which makes NaNs canonical.
+static void box_float(Assembler* self) {
+    uint32_t done = new_label(self);
+    emit_sse(self, 0x66, 0x7e, 0, RAX, true);      // movq rax, xmm0
+    emit_sse(self, 0x66, 0x2e, 0, 0, false);       // ucomisd xmm0, xmm0
+    emit_branch(self, CC_NP, done);
+    emit_mov_imm(self, RAX, VALUE_CANONICAL_NAN);
+    bind(self, done);
+}
+
+// RAX = BOOL_VAL(AL)
+static void box_bool(Assembler* self) {
+    emit_movzx_al(self);
+    emit_rr(self, X_OR, RAX, FALSE_REG);
+}
+
+// Jumps to the target of the branch word after the instruction if the
+// truthiness of RAX | 2 is the one the word names: nil and false both
+// become false there.
+static void compile_branch(Assembler* self, size_t* pc) {
+    Instruction word = self->function->code[++*pc];
+    size_t target = (size_t)((int64_t)*pc + 1 + BRANCH_DISTANCE(word));
+    emit_rr(self, X_CMP, RAX, FALSE_REG);
+    emit_branch(self, BRANCH_WHEN(word) ? CC_NE : CC_E, (uint32_t)target);
+    leave_to(self, target);
+}
+
+// ################################################################
+// # INSTRUCTIONS
+// ################################################################
+
+// RDX = n / `divisor`, truncated, without an idiv, for a divisor > 1 and
+// the int n shifted left by 16 in RAX; RCX keeps it. A power of two 2^k is
+// a shift by k + 16, after adding 2^(k + 16) - 1 to a negative dividend.
+// Otherwise, with l = ceil(log2 d), p = 62 + l and M = 2^p / d + 1 < 2^63,
+// the high word of the signed n * M shifted right by l - 2 is floor(n / d)
+// for |n| <= 2^47 (see Granlund and Montgomery, "Division by Invariant
+// Integers using Multiplication"), and adding the sign bit of n rounds it
+// towards zero. The 16 bits n is shifted by add to that shift.
+static void divide_by_constant(Assembler* self, int64_t divisor) {
+    emit_rr(self, X_MOV, RCX, RAX);
+    if (!(divisor & (divisor - 1))) {
+        int log = 63 - __builtin_clzll((uint64_t)divisor) + 16;
+        emit_rr(self, X_MOV, RDX, RAX);
+        emit_shift(self, X_SAR, RDX, 63);
+        emit_shift(self, X_SHR, RDX, (uint8_t)(64 - log));
+        emit_rr(self, X_ADD, RDX, RAX);
+        emit_shift(self, X_SAR, RDX, (uint8_t)log);
+        return;
+    }
+    int log = 64 - __builtin_clzll((uint64_t)divisor - 1);
+    uint64_t magic = (uint64_t)(((unsigned __int128)1 << (62 + log)) / (uint64_t)divisor) + 1;
+    emit_mov_imm(self, RDX, magic);
+    emit_unary(self, X_IMUL, RDX);                 // RDX:RAX = n * M << 16
+    emit_shift(self, X_SAR, RDX, (uint8_t)(log - 2 + 16));
+    emit_rr(self, X_MOV, RAX, RCX);
+    emit_shift(self, X_SHR, RAX, 63);
+    emit_rr(self, X_ADD, RDX, RAX);
+}
+
+// R[A] = R[B] op R[C] (or K[C]) on floats, either of which may be an int;
+// `lhs` and `rhs` are their types. The result stays in xmm0 for the next
+// instruction.
+static void compile_float_arithmetic(Assembler* self, OpCode op, Instruction i, Known lhs, Known rhs,
+                                     const Value* constant, uint32_t deopt) {
+    static const uint8_t opcodes[] = { X_ADDSD, X_SUBSD, X_MULSD, X_DIVSD };
+    if (constant) double_constant(self, *constant);
+    else load_double(self, 1, ARG_C(i), rhs, deopt);
+    load_double(self, 0, ARG_B(i), lhs, deopt);
+    bool nonzero = constant && (IS_FLOAT(*constant) ? AS_FLOAT(*constant) != 0.0 : AS_INT(*constant) != 0);
+    if (op == OP_DIV && !nonzero) {
+        // Division by zero is an error the interpreter reports.
+        emit_sse(self, 0x66, 0x57, 2, 2, false);   // xorpd xmm2, xmm2
+        emit_sse(self, 0x66, 0x2e, 1, 2, false);   // ucomisd xmm1, xmm2
+        emit_branch(self, CC_E, deopt);
+    }
+    emit_sse(self, 0xf2, opcodes[op - OP_ADD], 0, 1, false);
+    box_float(self);
+    store(self, ARG_A(i), RAX);
+    self->float_cached = ARG_A(i);
+}
+
+// The type of the result of an arithmetic instruction, on the paths that
+// stay in machine code: MOD only takes ints, and any float operand makes
+// the result a float.
+static Known arithmetic_known(OpCode op, Known lhs, Known rhs) {
+    if (op == OP_MOD || (lhs == KNOWN_INT && rhs == KNOWN_INT)) return KNOWN_INT;
+    if (lhs == KNOWN_FLOAT || rhs == KNOWN_FLOAT) return KNOWN_FLOAT;
+    return KNOWN_ANY;
+}
+
+// R[A] = R[B] op R[C], or R[B] op K[C] for the K forms, which pass the
+// constant. Operands known to be ints or floats are used without guards.
+// Otherwise ints are computed inline, floats in cold code, and everything
+// else deoptimizes; so do overflow and division by zero.
+static void compile_arithmetic(Assembler* self, OpCode op, Instruction i, const Value* constant) {
+    uint32_t deopt = deopt_label(self);
+    Known lhs = known(self, ARG_B(i));
+    Known rhs = constant ? constant_known(*constant) : known(self, ARG_C(i));
+    Known result = arithmetic_known(op, lhs, rhs);
+    if (constant && !IS_INT(*constant) && (op == OP_MOD || !IS_FLOAT(*constant))) {
+        emit_jump(self, deopt);
+        set_known(self, ARG_A(i), result);
+        return;
+    }
+    if (result == KNOWN_FLOAT && op != OP_MOD) {
+        compile_float_arithmetic(self, op, i, lhs, rhs, constant, deopt);
+        set_known(self, ARG_A(i), result);
+        return;
+    }
+
+    // The int path works on ints shifted left by 16, where they lose their
+    // tag and a result that leaves the 48 bits of an int overflows 64 bits.
+    // Only ints can be taken modulo, so MOD has no float path.
+    bool guarded = lhs != KNOWN_INT || rhs != KNOWN_INT;
+    uint32_t slow = op == OP_MOD ? deopt : new_label(self);
+    if (guarded) {
+        if (!constant) load(self, RCX, ARG_C(i));
+        load(self, RAX, ARG_B(i));
+        if (lhs != KNOWN_INT) guard_int(self, RAX, slow);
+        if (rhs != KNOWN_INT) guard_int(self, RCX, slow);
+        emit_shift(self, X_SHL, RAX, 16);
+        if (!constant) emit_shift(self, X_SHL, RCX, 16);
+    } else {
+        if (!constant) load_shifted(self, RCX, ARG_C(i));
+        load_shifted(self, RAX, ARG_B(i));
+    }
+    int64_t k = constant ? AS_INT(*constant) : 0;
+
+    switch (op) {
+        case OP_ADD: case OP_SUB:
+        case OP_MUL:
+            if (op == OP_MUL) {
+                if (constant) emit_mov_imm(self, RCX, (uint64_t)k);
+                else emit_shift(self, X_SAR, RCX, 16);
+                emit_imul(self, RAX, RCX);
+            } else if (constant && k >= -0x8000 && k < 0x8000) {
+                emit_alu_imm32(self, op == OP_ADD ? X_ADD_IMM : X_SUB_IMM, RAX, (int32_t)(k * 0x10000));
+            } else {
+                if (constant) emit_mov_imm(self, RCX, (uint64_t)k << 16);
+                emit_rr(self, op == OP_ADD ? X_ADD : X_SUB, RAX, RCX);
+            }
+            emit_branch(self, CC_O, deopt);
+            break;
+        case OP_DIV: case OP_MOD:
+            if (constant && k > 1) {
+                // Neither result can leave the range of an int.
+                divide_by_constant(self, k);
+                if (op == OP_MOD) {
+                    if (k < 0x8000) {
+                        emit_imul_imm32(self, RDX, RDX, (int32_t)(k * 0x10000));
+                    } else {
+                        emit_mov_imm(self, R9, (uint64_t)k << 16);
+                        emit_imul(self, RDX, R9);
+                    }
+                    emit_rr(self, X_SUB, RCX, RDX);
+                    emit_rr(self, X_MOV, RAX, RCX);
+                } else {
+                    emit_rr(self, X_MOV, RAX, RDX);
+                    emit_shift(self, X_SHL, RAX, 16);
+                }
+                break;
+            }
+            emit_shift(self, X_SAR, RAX, 16);
+            if (constant) emit_mov_imm(self, RCX, (uint64_t)k);
+            else emit_shift(self, X_SAR, RCX, 16);
+            if (!constant || k == 0) {
+                emit_rr(self, X_TEST, RCX, RCX);
+                emit_branch(self, CC_E, deopt);
+            }
+            emit_byte(self, 0x48);                 // cqo
+            emit_byte(self, 0x99);
+            emit_unary(self, X_IDIV, RCX);
+            if (op == OP_MOD) emit_rr(self, X_MOV, RAX, RDX);
+            // Only the quotient of the least int by -1 does not fit.
+            emit_rr(self, X_MOV, RDX, RAX);
+            emit_shift(self, X_SHL, RAX, 16);
+            emit_rr(self, X_MOV, RCX, RAX);
+            emit_shift(self, X_SAR, RCX, 16);
+            emit_rr(self, X_CMP, RCX, RDX);
+            emit_branch(self, CC_NE, deopt);
+            break;
+        default: break;
+    }
+    set_known(self, ARG_A(i), result);
+    if (op == OP_MOD || !guarded) {
+        store_shifted(self, ARG_A(i));
+        return;
+    }
+    emit_shift(self, X_SHR, RAX, 16);
+    emit_rr(self, X_OR, RAX, INT_TAG);
+    store(self, ARG_A(i), RAX);
+
+    // The guards failed: the operands are loaded again.
+    uint32_t done = new_label(self);
+    uint32_t cached = enter_cold(self);
+    bind(self, slow);
+    compile_float_arithmetic(self, op, i, lhs, rhs, constant, deopt);
+    emit_jump(self, done);
+    leave_cold(self, cached);
+    bind(self, done);
+}
+
+// AL = xmm0 < xmm1 (or <=). ucomisd leaves "above" clear for NaNs, so
+// they compare false.
+static void compare_floats(Assembler* self, bool or_equal) {
+    emit_sse(self, 0x66, 0x2e, 1, 0, false);       // ucomisd xmm1, xmm0
+    emit_setcc(self, or_equal ? CC_AE : CC_A);
+}
+
+// R[A] = R[B] < R[C] (or <=), followed by the branch of the fused forms.
+static void compile_compare(Assembler* self, Instruction i, bool or_equal, size_t* branch_pc) {
+    uint32_t deopt = deopt_label(self);
+    uint32_t slow = new_label(self), join = new_label(self);
+    Known lhs = known(self, ARG_B(i)), rhs = known(self, ARG_C(i));
+    bool floats = lhs == KNOWN_FLOAT || rhs == KNOWN_FLOAT;
+    bool ints = lhs == KNOWN_INT && rhs == KNOWN_INT;
+    if (ints) {
+        // With the tag shifted out, ints compare as 64-bit ints.
+        load_shifted(self, RCX, ARG_C(i));
+        load_shifted(self, RAX, ARG_B(i));
+        emit_rr(self, X_CMP, RAX, RCX);
+        emit_setcc(self, or_equal ? CC_LE : CC_L);
+    } else if (floats) {
+        load_double(self, 1, ARG_C(i), rhs, deopt);
+        load_double(self, 0, ARG_B(i), lhs, deopt);
+        compare_floats(self, or_equal);
+    } else {
+        load(self, RCX, ARG_C(i));
+        load(self, RAX, ARG_B(i));
+        if (lhs != KNOWN_INT) guard_int(self, RAX, slow);
+        if (rhs != KNOWN_INT) guard_int(self, RCX, slow);
+        emit_shift(self, X_SHL, RAX, 16);
+        emit_shift(self, X_SHL, RCX, 16);
+        emit_rr(self, X_CMP, RAX, RCX);
+        emit_setcc(self, or_equal ? CC_LE : CC_L);
+    }
+    bind(self, join);
+    box_bool(self);
+    store(self, ARG_A(i), RAX);
+    set_known(self, ARG_A(i), KNOWN_BOOL);
+    if (branch_pc) compile_branch(self, branch_pc);
+    if (floats || ints) return;
+
+    uint32_t cached = enter_cold(self);
+    bind(self, slow);
+    to_double(self, RAX, 0, lhs, deopt);
+    to_double(self, RCX, 1, rhs, deopt);
+    compare_floats(self, or_equal);
+    emit_jump(self, join);
+    leave_cold(self, cached);
+}
+
+// R[A] = R[B] == R[C] (or !=). Only ints are compared inline.
+static void compile_equal(Assembler* self, Instruction i, bool negated) {
+    uint32_t slow = new_label(self), join = new_label(self);
+    Known lhs = known(self, ARG_B(i)), rhs = known(self, ARG_C(i));
+    bool ints = lhs == KNOWN_INT && rhs == KNOWN_INT;
+    if (ints) {
+        load_shifted(self, RCX, ARG_C(i));
+        load_shifted(self, RAX, ARG_B(i));
+    } else {
+        load(self, RCX, ARG_C(i));
+        load(self, RAX, ARG_B(i));
+        if (lhs != KNOWN_INT) guard_int(self, RAX, slow);
+        if (rhs != KNOWN_INT) guard_int(self, RCX, slow);
+    }
+    emit_rr(self, X_CMP, RAX, RCX);
+    emit_setcc(self, CC_E);
+    bind(self, join);
+    if (negated) {
+        emit_byte(self, 0x34);                     // xor al, 1
+        emit_byte(self, 0x01);
+    }
+    box_bool(self);
+    store(self, ARG_A(i), RAX);
+    set_known(self, ARG_A(i), KNOWN_BOOL);
+    if (ints) return;
+
+    uint32_t cached = enter_cold(self);
+    bind(self, slow);
+    emit_rr(self, X_MOV, RDI, RAX);
+    emit_rr(self, X_MOV, RSI, RCX);
+    emit_call(self, (uint64_t)(uintptr_t)values_equal);
+    emit_jump(self, join);
+    leave_cold(self, cached);
+}
+
+// RAX = -RAX for a float in RAX. NaNs are left to the interpreter, which
+// keeps them canonical.
+static void negate_float(Assembler* self, uint32_t deopt) {
+    self->float_cached = NO_REGISTER;
+    emit_sse(self, 0x66, 0x6e, 0, RAX, true);      // movq xmm0, rax
+    emit_sse(self, 0x66, 0x2e, 0, 0, false);       // ucomisd xmm0, xmm0
+    emit_branch(self, CC_P, deopt);
+    emit_rex(self, true, 0, RAX);                  // btc rax, 63
+    emit_byte(self, 0x0f);
+    emit_byte(self, 0xba);
+    emit_modrm_reg(self, 7, RAX);
+    emit_byte(self, 63);
+}
+
+static void compile_negate(Assembler* self, Instruction i) {
+    uint32_t deopt = deopt_label(self);
+    uint32_t slow = new_label(self), done = new_label(self);
+    Known type = known(self, ARG_B(i));
+    if (type == KNOWN_INT) {
+        load_shifted(self, RAX, ARG_B(i));
+        emit_unary(self, X_NEG, RAX);
+        emit_branch(self, CC_O, deopt);
+        set_known(self, ARG_A(i), KNOWN_INT);
+        store_shifted(self, ARG_A(i));
+        return;
+    }
+    load(self, RAX, ARG_B(i));
+    if (type == KNOWN_FLOAT) {
+        negate_float(self, deopt);
+        store(self, ARG_A(i), RAX);
+        set_known(self, ARG_A(i), KNOWN_FLOAT);
+        return;
+    }
+    guard_int(self, RAX, slow);
+    untag_int(self, RAX);
+    emit_unary(self, X_NEG, RAX);
+    box_int(self, deopt);
+    store(self, ARG_A(i), RAX);
+    bind(self, done);
+    set_known(self, ARG_A(i), KNOWN_ANY);
+
+    // Floats flip their sign bit; everything else deoptimizes.
+    uint32_t cached = enter_cold(self);
+    bind(self, slow);
+    emit_rr(self, X_MOV, RDX, RAX);
+    emit_shift(self, X_SAR, RDX, 50);
+    emit_cmp_imm8(self, RDX, -1);
+    emit_branch(self, CC_E, deopt);
+    negate_float(self, deopt);
+    store(self, ARG_A(i), RAX);
+    emit_jump(self, done);
+    leave_cold(self, cached);
+}
+
+// Calls vm_call_value() with R[A] as the base, failing if it does.
+static void compile_call(Assembler* self, Instruction i, const Value* callee) {
+    emit_store_imm32(self, VM_REG, (int32_t)offsetof(VM, pc), (int32_t)self->pc);
+    emit_rr(self, X_MOV, RDI, VM_REG);
+    if (callee) emit_mov_imm(self, RSI, *callee);
+    else load(self, RSI, ARG_A(i));
+    emit_lea(self, RDX, REGISTERS, slot(ARG_A(i)));
+    emit_mov_imm(self, RCX, ARG_B(i));
+    emit_call(self, (uint64_t)(uintptr_t)vm_call_value);
+    emit_byte(self, 0x84);                         // test al, al
+    emit_byte(self, 0xc0);
+    emit_branch(self, CC_E, self->fail_label);
+    set_known(self, ARG_A(i), KNOWN_ANY);
+}
+
+static uint32_t read_bx(Assembler* self, size_t* pc) {
+    uint32_t bx = ARG_BX(self->function->code[*pc]);
+    return bx == BX_WIDE ? self->function->code[++*pc] : bx;
+}
+
+static void compile_global(Assembler* self, Instruction i, size_t* pc, bool set) {
+    uint32_t index = read_bx(self, pc);
+    if (index > INT32_MAX / sizeof(Value)) {
+        self->ok = false;
+        return;
+    }
+    if (set) {
+        load(self, RAX, ARG_A(i));
+        emit_store(self, GLOBALS, slot(index), RAX);
+        self->cached = ARG_A(i);
+        self->shifted = false;
+        set_known(self, global_known(self, index), known(self, ARG_A(i)));
+    } else {
+        emit_load(self, RAX, GLOBALS, slot(index));
+        store(self, ARG_A(i), RAX);
+        set_known(self, ARG_A(i), known(self, global_known(self, index)));
+    }
+}
+
+static void compile_instruction(Assembler* self, size_t* pc) {
+    const Function* function = self->function;
+    Instruction i = function->code[*pc];
+
+    switch (OP(i)) {
+        case OP_MOVE:
+            load(self, RAX, ARG_B(i));
+            store(self, ARG_A(i), RAX);
+            set_known(self, ARG_A(i), known(self, ARG_B(i)));
+            break;
+        case OP_LOADK: {
+            Value constant = function->constants[read_bx(self, pc)];
+            emit_mov_imm(self, RAX, constant);
+            store(self, ARG_A(i), RAX);
+            set_known(self, ARG_A(i), constant_known(constant));
+            break;
+        }
+        case OP_LOADINT:
+            emit_mov_imm(self, RAX, INT_VAL(ARG_SBX(i)));
+            store(self, ARG_A(i), RAX);
+            set_known(self, ARG_A(i), KNOWN_INT);
+            break;
+        case OP_LOADNIL:
+            emit_mov_imm(self, RAX, NIL_VAL);
+            store(self, ARG_A(i), RAX);
+            set_known(self, ARG_A(i), KNOWN_ANY);
+            break;
+        case OP_LOADBOOL:
+            emit_mov_imm(self, RAX, BOOL_VAL(ARG_B(i) != 0));
+            store(self, ARG_A(i), RAX);
+            set_known(self, ARG_A(i), KNOWN_BOOL);
+            break;
+        case OP_GETGLOBAL: compile_global(self, i, pc, false); break;
+        case OP_SETGLOBAL: compile_global(self, i, pc, true); break;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            compile_arithmetic(self, OP(i), i, NULL);
+            break;
+        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: case OP_MODK:
+            compile_arithmetic(self, (OpCode)(OP_ADD + (OP(i) - OP_ADDK)), i, &function->constants[ARG_C(i)]);
+            break;
+        case OP_EQ: compile_equal(self, i, false); break;
+        case OP_NEQ: compile_equal(self, i, true); break;
+        case OP_LT: compile_compare(self, i, false, NULL); break;
+        case OP_LE: compile_compare(self, i, true, NULL); break;
+        case OP_LT_JUMPIF: compile_compare(self, i, false, pc); break;
+        case OP_LE_JUMPIF: compile_compare(self, i, true, pc); break;
+        case OP_NEG: compile_negate(self, i); break;
+        case OP_NOT:
+            load(self, RAX, ARG_B(i));
+            emit_or_imm8(self, RAX, 2);
+            emit_rr(self, X_CMP, RAX, FALSE_REG);
+            emit_setcc(self, CC_E);
+            box_bool(self);
+            store(self, ARG_A(i), RAX);
+            set_known(self, ARG_A(i), KNOWN_BOOL);
+            break;
+        case OP_JUMPIF:
+            load(self, RAX, ARG_A(i));
+            emit_or_imm8(self, RAX, 2);
+            compile_branch(self, pc);
+            break;
+        case OP_CALL: compile_call(self, i, NULL); break;
+        case OP_CALLK: compile_call(self, i, &function->constants[ARG_C(i)]); break;
+        case OP_GET: {
+            Atom property = function->code[++*pc];
+            emit_store_imm32(self, VM_REG, (int32_t)offsetof(VM, pc), (int32_t)self->pc);
+            emit_rr(self, X_MOV, RDI, VM_REG);
+            load(self, RSI, ARG_B(i));
+            emit_mov_imm(self, RDX, property);
+            emit_lea(self, RCX, REGISTERS, slot(ARG_A(i)));
+            emit_call(self, (uint64_t)(uintptr_t)vm_get_property);
+            emit_byte(self, 0x84);                 // test al, al
+            emit_byte(self, 0xc0);
+            emit_branch(self, CC_E, self->fail_label);
+            set_known(self, ARG_A(i), KNOWN_ANY);
+            break;
+        }
+        case OP_RETURN:
+            load(self, RAX, ARG_A(i));
+            emit_store(self, RESULT, 0, RAX);
+            emit_mov_imm(self, RAX, JIT_RETURNED);
+            emit_jump(self, self->exit_label);
+            forget_all(self);
+            break;
+        default:
+            self->ok = false;
+            break;
+    }
+}
+
+// ################################################################
+// # COMPILER
+// ################################################################
+
+static const uint8_t prologue[] = {
+    0x53,                           // push rbx
+    0x55,                           // push rbp
+    0x41, 0x54,                     // push r12
+    0x41, 0x55,                     // push r13
+    0x41, 0x56,                     // push r14
+    0x41, 0x57,                     // push r15
+    0x48, 0x83, 0xec, 0x08,         // sub rsp, 8 (keeps calls 16-byte aligned)
+    0x49, 0x89, 0xfe,               // mov r14, rdi
+    0x48, 0x89, 0xf3,               // mov rbx, rsi
+    0x49, 0x89, 0xd4,               // mov r12, rdx
+    0x49, 0x89, 0xcf,               // mov r15, rcx
+};
+
+static const uint8_t epilogue[] = {
+    0x48, 0x83, 0xc4, 0x08,         // add rsp, 8
+    0x41, 0x5f,                     // pop r15
+    0x41, 0x5e,                     // pop r14
+    0x41, 0x5d,                     // pop r13
+    0x41, 0x5c,                     // pop r12
+    0x5d,                           // pop rbp
+    0x5b,                           // pop rbx
+    0xc3,                           // ret
+};
+
+static void emit_bytes(Assembler* self, const uint8_t* bytes, size_t count) {
+    for (size_t i = 0; i < count; i++) emit_byte(self, bytes[i]);
+}
+
+// Marks the instructions jumps land on: RAX can hold anything there.
+static void find_targets(Assembler* self) {
+    const Function* function = self->function;
+    for (size_t pc = 0; pc < function->size; pc++) {
+        Instruction i = function->code[pc];
+        int64_t target = -1;
+        switch (OP(i)) {
+            case OP_JUMPIF: case OP_LT_JUMPIF: case OP_LE_JUMPIF:
+                pc++;
+                target = (int64_t)pc + 1 + BRANCH_DISTANCE(function->code[pc]);
+                break;
+            case OP_LOADK: case OP_GETGLOBAL: case OP_SETGLOBAL:
+                if (ARG_BX(i) == BX_WIDE) pc++;
+                break;
+            case OP_GET:
+                pc++;
+                break;
+            default: break;
+        }
+        if (target < 0) continue;
+        if ((size_t)target >= function->size) self->ok = false;
+        else self->targets[target] = true;
+        // Types are found in one pass, which a backward branch would
+        // outrun. The compiler only branches forward while there are no
+        // loops, so such code is simply not compiled.
+        if ((size_t)target <= pc) self->ok = false;
+    }
+}
+
+static void free_assembler(Assembler* self) {
+    free(self->sections[HOT].bytes);
+    free(self->sections[COLD].bytes);
+    free(self->labels);
+    free(self->fixups);
+    free(self->deopt_labels);
+    free(self->targets);
+    for (size_t pc = 0; pc < self->function->size; pc++) free(self->incoming[pc]);
+    free(self->incoming);
+    free(self->known);
+}
+
+// Copies both sections to fresh pages, patches the jumps between them and
+// makes the pages executable.
+static JitCode* link_code(Assembler* self) {
+    size_t hot = self->sections[HOT].size;
+    size_t size = hot + self->sections[COLD].size;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t mapped = (size + (size_t)page - 1) / (size_t)page * (size_t)page;
+
+    uint8_t* memory = (uint8_t*)mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return NULL;
+    memcpy(memory, self->sections[HOT].bytes, hot);
+    memcpy(memory + hot, self->sections[COLD].bytes, self->sections[COLD].size);
+
+    for (size_t i = 0; i < self->fixup_count; i++) {
+        Fixup* fixup = &self->fixups[i];
+        Label* label = &self->labels[fixup->label];
+        if (!label->bound) {
+            munmap(memory, mapped);
+            return NULL;
+        }
+        size_t at = (fixup->section == HOT ? 0 : hot) + fixup->at;
+        size_t target = (label->section == HOT ? 0 : hot) + label->offset;
+        int32_t distance = (int32_t)((int64_t)target - (int64_t)(at + 4));
+        memcpy(memory + at, &distance, sizeof(distance));
+    }
+
+    if (mprotect(memory, mapped, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, mapped);
+        return NULL;
+    }
+
+    JitCode* code = (JitCode*)malloc(sizeof(JitCode));
+    if (!code) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    code->memory = memory;
+    code->size = mapped;
+    code->entry = (JitEntry)(uintptr_t)memory;
+    return code;
+}
+
+JitCode* jit_compile(const Function* function) {
+    // Every path through the code must end at a RETURN, as the compiler's
+    // always do.
+    if (function->size == 0 || function->size > JIT_MAX_SIZE || OP(function->code[function->size - 1]) != OP_RETURN) return NULL;
+
+    Assembler self;
+    memset(&self, 0, sizeof(self));
+    self.function = function;
+    self.ok = true;
+    self.cached = NO_REGISTER;
+    self.float_cached = NO_REGISTER;
+    self.deopt_labels = (uint32_t*)malloc(function->size * sizeof(uint32_t));
+    self.targets = (bool*)calloc(function->size, sizeof(bool));
+    self.incoming = (uint8_t**)calloc(function->size, sizeof(uint8_t*));
+    // Registers and globals all start out nil.
+    self.known_size = (size_t)function->register_count + function->global_count;
+    self.known = (uint8_t*)malloc(self.known_size ? self.known_size : 1);
+    if (!self.deopt_labels || !self.targets || !self.incoming || !self.known) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t pc = 0; pc < function->size; pc++) {
+        self.deopt_labels[pc] = NO_LABEL;
+        new_label(&self);
+    }
+    self.fail_label = new_label(&self);
+    self.exit_label = new_label(&self);
+    memset(self.known, KNOWN_ANY, self.known_size);
+    find_targets(&self);
+
+    emit_bytes(&self, prologue, sizeof(prologue));
+    emit_mov_imm(&self, INT_TAG, VALUE_TAG_INT);
+    emit_mov_imm(&self, FALSE_REG, FALSE_VAL);
+
+    for (size_t pc = 0; pc < function->size && self.ok; pc++) {
+        self.pc = pc;
+        if (self.targets[pc]) {
+            self.cached = NO_REGISTER;
+            self.float_cached = NO_REGISTER;
+            arrive_at(&self, pc);
+        }
+        bind(&self, (uint32_t)pc);
+        compile_instruction(&self, &pc);
+    }
+
+    bind(&self, self.exit_label);
+    emit_bytes(&self, epilogue, sizeof(epilogue));
+
+    self.section = COLD;
+    for (size_t pc = 0; pc < function->size; pc++) {
+        if (self.deopt_labels[pc] == NO_LABEL) continue;
+        bind(&self, self.deopt_labels[pc]);
+        emit_mov_imm(&self, RAX, pc);
+        emit_jump(&self, self.exit_label);
+    }
+    bind(&self, self.fail_label);
+    emit_mov_imm(&self, RAX, JIT_FAILED);
+    emit_jump(&self, self.exit_label);
+
+    JitCode* code = self.ok ? link_code(&self) : NULL;
+    free_assembler(&self);
+    return code;
+}
+
+void free_jit_code(JitCode* code) {
+    munmap(code->memory, code->size);
+    free(code);
+}
+
+size_t jit_enter(const JitCode* code, VM* vm, Value* result) {
+    Value value;
+    size_t exit = code->entry(vm, vm->registers, vm->globals, &value);
+    if (exit == JIT_RETURNED && result) *result = value;
+    return exit;
+}
+
+#else
+
+JitCode* jit_compile(const Function* function) {
+    (void)function;
+    return NULL;
+}
+
+void free_jit_code(JitCode* code) {
+    (void)code;
+}
+
+size_t jit_enter(const JitCode* code, VM* vm, Value* result) {
+    (void)code;
+    (void)vm;
+    (void)result;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef NUUK_JIT_H
+#define NUUK_JIT_H
+
+#include "bytecode.h"
+
+// A baseline JIT: it translates a function's bytecode to x86-64 machine
+// code one instruction at a time. Registers and globals stay in the VM's
+// arrays, so the machine code and the interpreter can hand a running
+// function to each other at any instruction; between instructions, the
+// last result is also kept in a machine register for the next one.
+//
+// Arithmetic and comparisons are compiled for int and float operands only.
+// When a type guard fails, or when the instruction would overflow, divide
+// by zero or otherwise fail, the code deoptimizes: it returns the pc of the
+// instruction, and the interpreter redoes it from there and runs the rest
+// of the function, reporting any error itself. As it compiles, the JIT
+// follows which registers and globals can only hold an int, a float or a
+// bool where each instruction starts, and leaves out their guards.
+//
+// Code is built in writable memory, which is then made executable and never
+// writable again (W^X). The JIT is only available on x86-64 Linux; elsewhere
+// jit_compile() always fails and the VM keeps interpreting.
+
+// vm_run() compiles a script the JIT_HOT_RUNS-th time it runs it, so code
+// that runs once never pays for compilation, and stops using the machine
+// code of a script that deoptimized JIT_MAX_DEOPTS times.
+#define JIT_HOT_RUNS 2
+#define JIT_MAX_DEOPTS 4
+
+// Scripts have no loops, so each instruction of a long one runs once per run
+// either way; its machine code, about a hundred bytes per instruction, would
+// only trade dispatch for instruction cache misses. Longer functions are not
+// compiled.
+#define JIT_MAX_SIZE 16384
+
+// What jit_enter() returns when the function returned or failed with a
+// runtime error; every other value is the pc to deoptimize at.
+#define JIT_RETURNED SIZE_MAX
+#define JIT_FAILED (SIZE_MAX - 1)
+
+typedef struct JitCode JitCode;
+
+bool jit_available();
+
+// Returns NULL if the function cannot be compiled.
+JitCode* jit_compile(const Function* function);
+void free_jit_code(JitCode* code);
+
+// Runs the machine code of `vm->function` on the VM's registers and globals.
+// `*result` is only set when JIT_RETURNED is returned.
+size_t jit_enter(const JitCode* code, VM* vm, Value* result);
+
+#endif
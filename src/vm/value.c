@@ -0,0 +1,98 @@
+#include "value.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t string_hash(const char* chars, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t)chars[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static ObjString* allocate_string(Arena* arena, size_t length) {
+    if (length > UINT32_MAX) {
+        fprintf(stderr, "FATAL ERROR: String too long.\n");
+        exit(EXIT_FAILURE);
+    }
+    ObjString* string = (ObjString*)arena_alloc(arena, sizeof(ObjString) + length + 1);
+    string->obj.type = OBJ_STRING;
+    string->length = (uint32_t)length;
+    string->chars[length] = '\0';
+    return string;
+}
+
+ObjString* copy_string(Arena* arena, const char* chars, size_t length) {
+    ObjString* string = allocate_string(arena, length);
+    memcpy(string->chars, chars, length);
+    string->hash = string_hash(string->chars, length);
+    return string;
+}
+
+ObjString* concat_strings(Arena* arena, const ObjString* lhs, const ObjString* rhs) {
+    ObjString* string = allocate_string(arena, (size_t)lhs->length + rhs->length);
+    memcpy(string->chars, lhs->chars, lhs->length);
+    memcpy(string->chars + lhs->length, rhs->chars, rhs->length);
+    string->hash = string_hash(string->chars, string->length);
+    return string;
+}
+
+bool values_equal(Value lhs, Value rhs) {
+    if (is_number(lhs) && is_number(rhs)) {
+        if (IS_FLOAT(lhs) || IS_FLOAT(rhs)) return as_number(lhs) == as_number(rhs);
+        return as_integer(lhs) == as_integer(rhs);
+    }
+    // Everything else is only equal to itself, except strings with the same
+    // content.
+    if (lhs == rhs) return true;
+    if (!IS_STRING(lhs) || !IS_STRING(rhs)) return false;
+    ObjString* a = AS_STRING(lhs);
+    ObjString* b = AS_STRING(rhs);
+    return a->length == b->length && a->hash == b->hash && memcmp(a->chars, b->chars, a->length) == 0;
+}
+
+const char* value_type_name(Value value) {
+    switch (value_type(value)) {
+        case VAL_NIL: return "nil";
+        case VAL_BOOL: return "bool";
+        case VAL_INT: return "int";
+        case VAL_FLOAT: return "float";
+        case VAL_CHAR: return "char";
+        case VAL_OBJ:
+            switch (AS_OBJ(value)->type) {
+                case OBJ_STRING: return "string";
+                case OBJ_NATIVE: return "function";
+            }
+    }
+    return "unknown";
+}
+
+static void print_float(FILE* out, double number) {
+    // The shortest of %.15g and %.17g that reads back as the same float.
+    char text[40];
+    snprintf(text, sizeof(text), "%.15g", number);
+    if (strtod(text, NULL) != number) snprintf(text, sizeof(text), "%.17g", number);
+    if (!strpbrk(text, ".en")) strcat(text, ".0");
+    fputs(text, out);
+}
+
+void print_value(FILE* out, Value value) {
+    switch (value_type(value)) {
+        case VAL_NIL: fputs("nil", out); break;
+        case VAL_BOOL: fputs(AS_BOOL(value) ? "true" : "false", out); break;
+        case VAL_INT: fprintf(out, "%" PRId64, AS_INT(value)); break;
+        case VAL_FLOAT: print_float(out, AS_FLOAT(value)); break;
+        case VAL_CHAR: fputc(AS_CHAR(value), out); break;
+        case VAL_OBJ:
+            if (IS_STRING(value)) {
+                fwrite(AS_STRING(value)->chars, 1, AS_STRING(value)->length, out);
+            } else {
+                fprintf(out, "<native %s>", AS_NATIVE(value)->name);
+            }
+            break;
+    }
+}
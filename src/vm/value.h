@@ -0,0 +1,171 @@
+#ifndef NUUK_VALUE_H
+#define NUUK_VALUE_H
+
+#include "E:\THE_LANGUAGE\src\utils\arena.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct VM VM;
+
+typedef enum ValueType {
+    VAL_NIL,
+    VAL_BOOL,
+    VAL_INT,
+    VAL_FLOAT,
+    VAL_CHAR,
+    VAL_OBJ,
+} ValueType;
+
+typedef enum ObjType {
+    OBJ_STRING,
+    OBJ_NATIVE,
+} ObjType;
+
+typedef struct Obj {
+    ObjType type;
+} Obj;
+
+// A runtime value in one 64-bit word (NaN-boxing). A double is stored as
+// itself. Everything else lives in the negative quiet NaNs that start with
+// the 14 bits 0xfffc, which no arithmetic produces; FLOAT_VAL() folds every
+// NaN into one canonical NaN outside that space. Bits 48-49 are the tag and
+// the low 48 bits the payload:
+//
+//   0xfffc  int      48-bit two's complement
+//   0xfffd  object   pointer (48-bit address space)
+//   0xfffe  char     the char in the low byte
+//   0xffff  nil, false and true
+//
+// So ints are 48-bit: arithmetic that leaves VALUE_INT_MIN..VALUE_INT_MAX
+// overflows instead of allocating. Floats cover both `float` and `double`.
+// Code outside value.{h,c} only goes through the macros below.
+typedef uint64_t Value;
+
+#define VALUE_BOX ((uint64_t)0xfffc000000000000)
+#define VALUE_TAG_INT ((uint64_t)0xfffc000000000000)
+#define VALUE_TAG_OBJ ((uint64_t)0xfffd000000000000)
+#define VALUE_TAG_CHAR ((uint64_t)0xfffe000000000000)
+#define VALUE_TAG_SPECIAL ((uint64_t)0xffff000000000000)
+#define VALUE_TAG_MASK ((uint64_t)0xffff000000000000)
+#define VALUE_PAYLOAD ((uint64_t)0x0000ffffffffffff)
+#define VALUE_CANONICAL_NAN ((uint64_t)0x7ff8000000000000)
+
+#define VALUE_INT_MIN (-((int64_t)1 << 47))
+#define VALUE_INT_MAX (((int64_t)1 << 47) - 1)
+
+// Strings are immutable and allocated from an arena: string constants from
+// the arena of their Function, strings built at run time from the VM's.
+typedef struct ObjString {
+    Obj obj;
+    uint32_t length;
+    uint32_t hash;
+    char chars[];
+} ObjString;
+
+// A builtin function. It reads `argc` arguments from `args`, stores its
+// result in `*result` and returns false after reporting a runtime error
+// through vm_error().
+typedef bool (*NativeFn)(VM* vm, int argc, const Value* args, Value* result);
+
+// `arity` is -1 for functions that take any number of arguments.
+typedef struct ObjNative {
+    Obj obj;
+    const char* name;
+    int arity;
+    NativeFn function;
+} ObjNative;
+
+#define NIL_VAL (VALUE_TAG_SPECIAL | 0)
+#define FALSE_VAL (VALUE_TAG_SPECIAL | 2)
+#define TRUE_VAL (VALUE_TAG_SPECIAL | 3)
+#define BOOL_VAL(value) ((value) ? TRUE_VAL : FALSE_VAL)
+#define INT_VAL(value) (VALUE_TAG_INT | ((uint64_t)(int64_t)(value) & VALUE_PAYLOAD))
+#define FLOAT_VAL(value) float_value(value)
+#define CHAR_VAL(value) (VALUE_TAG_CHAR | (uint64_t)(unsigned char)(value))
+#define OBJ_VAL(object) (VALUE_TAG_OBJ | (uint64_t)(uintptr_t)(object))
+
+#define IS_NIL(value) ((value) == NIL_VAL)
+#define IS_BOOL(value) (((value) | 1) == TRUE_VAL)
+#define IS_INT(value) (((value) & VALUE_TAG_MASK) == VALUE_TAG_INT)
+#define IS_FLOAT(value) (((value) & VALUE_BOX) != VALUE_BOX)
+#define IS_CHAR(value) (((value) & VALUE_TAG_MASK) == VALUE_TAG_CHAR)
+#define IS_OBJ(value) (((value) & VALUE_TAG_MASK) == VALUE_TAG_OBJ)
+#define IS_STRING(value) is_obj_type(value, OBJ_STRING)
+#define IS_NATIVE(value) is_obj_type(value, OBJ_NATIVE)
+
+#define AS_BOOL(value) ((value) == TRUE_VAL)
+// Shifting the payload to the top and back sign-extends it.
+#define AS_INT(value) ((int64_t)((value) << 16) >> 16)
+#define AS_FLOAT(value) float_of(value)
+#define AS_CHAR(value) ((char)((value) & 0xff))
+#define AS_OBJ(value) ((Obj*)(uintptr_t)((value) & VALUE_PAYLOAD))
+#define AS_STRING(value) ((ObjString*)AS_OBJ(value))
+#define AS_NATIVE(value) ((ObjNative*)AS_OBJ(value))
+
+_Static_assert(sizeof(Value) == 8, "a Value is one machine word");
+_Static_assert(sizeof(double) == sizeof(Value), "doubles are stored unboxed");
+
+static inline Value float_value(double number) {
+    Value value;
+    memcpy(&value, &number, sizeof(value));
+    return number != number ? VALUE_CANONICAL_NAN : value;
+}
+
+static inline double float_of(Value value) {
+    double number;
+    memcpy(&number, &value, sizeof(number));
+    return number;
+}
+
+static inline bool int_fits(int64_t value) {
+    return value >= VALUE_INT_MIN && value <= VALUE_INT_MAX;
+}
+
+static inline ValueType value_type(Value value) {
+    if (IS_FLOAT(value)) return VAL_FLOAT;
+    switch (value & VALUE_TAG_MASK) {
+        case VALUE_TAG_INT: return VAL_INT;
+        case VALUE_TAG_OBJ: return VAL_OBJ;
+        case VALUE_TAG_CHAR: return VAL_CHAR;
+        default: return IS_NIL(value) ? VAL_NIL : VAL_BOOL;
+    }
+}
+
+static inline bool is_obj_type(Value value, ObjType type) {
+    return IS_OBJ(value) && AS_OBJ(value)->type == type;
+}
+
+// Only nil and false are falsey.
+static inline bool is_falsey(Value value) {
+    return value == NIL_VAL || value == FALSE_VAL;
+}
+
+// Ints and chars are integers, and together with floats they are numbers.
+static inline bool is_integer(Value value) {
+    return IS_INT(value) || IS_CHAR(value);
+}
+
+static inline bool is_number(Value value) {
+    return is_integer(value) || IS_FLOAT(value);
+}
+
+static inline int64_t as_integer(Value value) {
+    return IS_CHAR(value) ? (unsigned char)AS_CHAR(value) : AS_INT(value);
+}
+
+static inline double as_number(Value value) {
+    return IS_FLOAT(value) ? AS_FLOAT(value) : (double)as_integer(value);
+}
+
+ObjString* copy_string(Arena* arena, const char* chars, size_t length);
+ObjString* concat_strings(Arena* arena, const ObjString* lhs, const ObjString* rhs);
+
+// Numbers compare by value across int, char and float; strings by content.
+bool values_equal(Value lhs, Value rhs);
+const char* value_type_name(Value value);
+void print_value(FILE* out, Value value);
+
+#endif
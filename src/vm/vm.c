@@ -0,0 +1,545 @@
+#include "vm.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ################################################################
+// # NATIVES
+// ################################################################
+
+// Prints its arguments separated by spaces and ends the line.
+static bool native_print(VM* vm, int argc, const Value* args, Value* result) {
+    (void)vm;
+    for (int i = 0; i < argc; i++) {
+        if (i > 0) fputc(' ', stdout);
+        print_value(stdout, args[i]);
+    }
+    fputc('\n', stdout);
+    *result = NIL_VAL;
+    return true;
+}
+
+// Processor time in seconds, for timing scripts.
+static bool native_clock(VM* vm, int argc, const Value* args, Value* result) {
+    (void)vm;
+    (void)argc;
+    (void)args;
+    *result = FLOAT_VAL((double)clock() / CLOCKS_PER_SEC);
+    return true;
+}
+
+static bool expect_numbers(VM* vm, const char* name, int argc, const Value* args) {
+    for (int i = 0; i < argc; i++) {
+        if (!is_number(args[i])) {
+            vm_error(vm, "%s() expects numbers, got %s.", name, value_type_name(args[i]));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool native_abs(VM* vm, int argc, const Value* args, Value* result) {
+    if (!expect_numbers(vm, "abs", argc, args)) return false;
+    if (IS_FLOAT(args[0])) {
+        *result = FLOAT_VAL(AS_FLOAT(args[0]) < 0 ? -AS_FLOAT(args[0]) : AS_FLOAT(args[0]));
+        return true;
+    }
+    int64_t value = as_integer(args[0]);
+    if (!int_fits(-value)) {
+        vm_error(vm, "Integer overflow.");
+        return false;
+    }
+    *result = INT_VAL(value < 0 ? -value : value);
+    return true;
+}
+
+// min() and max() keep the type of the argument they pick.
+static bool native_min(VM* vm, int argc, const Value* args, Value* result) {
+    if (!expect_numbers(vm, "min", argc, args)) return false;
+    *result = as_number(args[1]) < as_number(args[0]) ? args[1] : args[0];
+    return true;
+}
+
+static bool native_max(VM* vm, int argc, const Value* args, Value* result) {
+    if (!expect_numbers(vm, "max", argc, args)) return false;
+    *result = as_number(args[1]) > as_number(args[0]) ? args[1] : args[0];
+    return true;
+}
+
+static const ObjNative natives[] = {
+    { { OBJ_NATIVE }, "print", -1, native_print },
+    { { OBJ_NATIVE }, "clock", 0, native_clock },
+    { { OBJ_NATIVE }, "abs", 1, native_abs },
+    { { OBJ_NATIVE }, "min", 2, native_min },
+    { { OBJ_NATIVE }, "max", 2, native_max },
+};
+
+const ObjNative* lookup_native(Atom name) {
+    const char* spelling = atom_name(name);
+    for (size_t i = 0; i < sizeof(natives) / sizeof(natives[0]); i++) {
+        if (strcmp(natives[i].name, spelling) == 0) return &natives[i];
+    }
+    return NULL;
+}
+
+// ################################################################
+// # VM
+// ################################################################
+
+VM* create_vm() {
+    VM* vm = (VM*)calloc(1, sizeof(VM));
+    if (!vm) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    vm->arena = create_arena(ARENA_BLOCK_SIZE);
+    vm->errors = create_diagnostics();
+    vm->jit = jit_available();
+    return vm;
+}
+
+void free_vm(VM* vm) {
+    free(vm->registers);
+    free(vm->globals);
+    free_arena(vm->arena);
+    free_diagnostics(&vm->errors);
+    free(vm);
+}
+
+void vm_error(VM* vm, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    diagnostics_vadd(&vm->errors, vm->function->offsets[vm->pc], fmt, args);
+    va_end(args);
+}
+
+// Grows `*values` to at least `count` slots and sets them all to nil.
+static void reset_values(Value** values, size_t* capacity, size_t count) {
+    if (count > *capacity) {
+        free(*values);
+        *values = (Value*)malloc(count * sizeof(Value));
+        if (!*values) {
+            fprintf(stderr, "FATAL ERROR: Failed to allocate registers.\n");
+            exit(EXIT_FAILURE);
+        }
+        *capacity = count;
+    }
+    for (size_t i = 0; i < count; i++) (*values)[i] = NIL_VAL;
+}
+
+static const char* arithmetic_symbol(OpCode op) {
+    switch (op) {
+        case OP_ADD: return "+";
+        case OP_SUB: return "-";
+        case OP_MUL: return "*";
+        case OP_DIV: return "/";
+        case OP_MOD: return "%";
+        case OP_LT: return "<";
+        case OP_LE: return "<=";
+        default: return "?";
+    }
+}
+
+static bool type_error(VM* vm, OpCode op, Value lhs, Value rhs) {
+    vm_error(vm, "Unsupported operand types for '%s': %s and %s.", arithmetic_symbol(op),
+        value_type_name(lhs), value_type_name(rhs));
+    return false;
+}
+
+// Ints and chars give an int unless the result leaves the 48 bits of an int
+// (see value.h); a float operand makes it a float operation. '+' also concatenates strings.
+static bool arithmetic(VM* vm, OpCode op, Value lhs, Value rhs, Value* result) {
+    if (is_integer(lhs) && is_integer(rhs)) {
+        int64_t a = as_integer(lhs), b = as_integer(rhs), value = 0;
+        bool overflow = false;
+        switch (op) {
+            case OP_ADD: overflow = __builtin_add_overflow(a, b, &value); break;
+            case OP_SUB: overflow = __builtin_sub_overflow(a, b, &value); break;
+            case OP_MUL: overflow = __builtin_mul_overflow(a, b, &value); break;
+            case OP_DIV: case OP_MOD:
+                if (b == 0) {
+                    vm_error(vm, "Division by zero.");
+                    return false;
+                }
+                value = op == OP_DIV ? a / b : a % b;
+                break;
+            default: break;
+        }
+        if (overflow || !int_fits(value)) {
+            vm_error(vm, "Integer overflow.");
+            return false;
+        }
+        *result = INT_VAL(value);
+        return true;
+    }
+
+    if (is_number(lhs) && is_number(rhs) && op != OP_MOD) {
+        double a = as_number(lhs), b = as_number(rhs);
+        switch (op) {
+            case OP_ADD: *result = FLOAT_VAL(a + b); break;
+            case OP_SUB: *result = FLOAT_VAL(a - b); break;
+            case OP_MUL: *result = FLOAT_VAL(a * b); break;
+            case OP_DIV:
+                if (b == 0.0) {
+                    vm_error(vm, "Division by zero.");
+                    return false;
+                }
+                *result = FLOAT_VAL(a / b);
+                break;
+            default: break;
+        }
+        return true;
+    }
+
+    if (op == OP_ADD && IS_STRING(lhs) && IS_STRING(rhs)) {
+        *result = OBJ_VAL(concat_strings(vm->arena, AS_STRING(lhs), AS_STRING(rhs)));
+        return true;
+    }
+    return type_error(vm, op, lhs, rhs);
+}
+
+static bool compare(VM* vm, OpCode op, Value lhs, Value rhs, Value* result) {
+    if (!is_number(lhs) || !is_number(rhs)) return type_error(vm, op, lhs, rhs);
+
+    bool less, equal;
+    if (IS_FLOAT(lhs) || IS_FLOAT(rhs)) {
+        double a = as_number(lhs), b = as_number(rhs);
+        less = a < b;
+        equal = a == b;
+    } else {
+        int64_t a = as_integer(lhs), b = as_integer(rhs);
+        less = a < b;
+        equal = a == b;
+    }
+    *result = BOOL_VAL(op == OP_LT ? less : less || equal);
+    return true;
+}
+
+static bool negate(VM* vm, Value operand, Value* result) {
+    if (IS_FLOAT(operand)) {
+        *result = FLOAT_VAL(-AS_FLOAT(operand));
+        return true;
+    }
+    if (!is_integer(operand)) {
+        vm_error(vm, "Unsupported operand type for '-': %s.", value_type_name(operand));
+        return false;
+    }
+    if (!int_fits(-as_integer(operand))) {
+        vm_error(vm, "Integer overflow.");
+        return false;
+    }
+    *result = INT_VAL(-as_integer(operand));
+    return true;
+}
+
+bool vm_get_property(VM* vm, Value object, Atom property, Value* result) {
+    if (IS_STRING(object) && strcmp(atom_name(property), "length") == 0) {
+        *result = INT_VAL(AS_STRING(object)->length);
+        return true;
+    }
+    vm_error(vm, "Undefined property '%s' on %s.", atom_name(property), value_type_name(object));
+    return false;
+}
+
+static bool call_native(VM* vm, const ObjNative* native, Value* base, int argc) {
+    if (native->arity >= 0 && native->arity != argc) {
+        vm_error(vm, "%s() takes %d argument(s) but got %d.", native->name, native->arity, argc);
+        return false;
+    }
+    return native->function(vm, argc, base + 1, base);
+}
+
+bool vm_call_value(VM* vm, Value callee, Value* base, int argc) {
+    if (!IS_NATIVE(callee)) {
+        vm_error(vm, "Can only call functions, got %s.", value_type_name(callee));
+        return false;
+    }
+    return call_native(vm, AS_NATIVE(callee), base, argc);
+}
+
+// Computed gotos (a GCC extension) jump straight from one instruction's
+// handler to the next one's, which gives every handler its own indirect
+// branch to predict; other compilers, or -DNUUK_SWITCH_DISPATCH, get the
+// same handlers as a switch in a loop.
+#if defined(__GNUC__) && !defined(NUUK_SWITCH_DISPATCH)
+#define VM_COMPUTED_GOTO
+#endif
+
+const char* vm_dispatch_name() {
+#ifdef VM_COMPUTED_GOTO
+    return "computed-goto";
+#else
+    return "switch";
+#endif
+}
+
+#ifdef VM_COUNT_OPCODES
+#define COUNT_OPCODE(op) do { \
+        vm->op_counts[op]++; \
+        if (previous < OP_COUNT) vm->pair_counts[previous][op]++; \
+        previous = (op); \
+    } while (0)
+#else
+#define COUNT_OPCODE(op) ((void)0)
+#endif
+
+// Runs `vm->function` from instruction `start` on.
+static bool interpret(VM* vm, size_t start, Value* result) {
+    Value* registers = vm->registers;
+    Value* globals = vm->globals;
+    const Value* constants = vm->function->constants;
+    const Instruction* code = vm->function->code;
+    const Instruction* ip = code + start;
+    Instruction i;
+#ifdef VM_COUNT_OPCODES
+    OpCode previous = OP_COUNT;
+#endif
+
+// Runtime errors are reported at the instruction that was fetched last.
+#define SAVE_PC() (vm->pc = (size_t)(ip - code) - 1)
+#define READ_BX(i) (ARG_BX(i) == BX_WIDE ? *ip++ : ARG_BX(i))
+#define FETCH() do { i = *ip++; COUNT_OPCODE(OP(i)); } while (0)
+// Reads the branch word of a conditional branch and takes the branch if
+// `truthy` is the truthiness it is taken on.
+#define BRANCH(truthy) do { \
+        Instruction word = *ip++; \
+        if ((truthy) == (bool)BRANCH_WHEN(word)) ip += BRANCH_DISTANCE(word); \
+    } while (0)
+
+#ifdef VM_COMPUTED_GOTO
+    // Every byte gets a handler, so a bad opcode cannot jump to NULL; the
+    // opcodes then override their entries of the range.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+    static const void* const handlers[256] = {
+        [0 ... 255] = &&handle_unknown,
+        [OP_MOVE] = &&handle_OP_MOVE,
+        [OP_LOADK] = &&handle_OP_LOADK,
+        [OP_LOADINT] = &&handle_OP_LOADINT,
+        [OP_LOADNIL] = &&handle_OP_LOADNIL,
+        [OP_LOADBOOL] = &&handle_OP_LOADBOOL,
+        [OP_GETGLOBAL] = &&handle_OP_GETGLOBAL,
+        [OP_SETGLOBAL] = &&handle_OP_SETGLOBAL,
+        [OP_ADD] = &&handle_OP_ADD,
+        [OP_SUB] = &&handle_OP_SUB,
+        [OP_MUL] = &&handle_OP_MUL,
+        [OP_DIV] = &&handle_OP_DIV,
+        [OP_MOD] = &&handle_OP_MOD,
+        [OP_EQ] = &&handle_OP_EQ,
+        [OP_NEQ] = &&handle_OP_NEQ,
+        [OP_LT] = &&handle_OP_LT,
+        [OP_LE] = &&handle_OP_LE,
+        [OP_NEG] = &&handle_OP_NEG,
+        [OP_NOT] = &&handle_OP_NOT,
+        [OP_JUMPIF] = &&handle_OP_JUMPIF,
+        [OP_CALL] = &&handle_OP_CALL,
+        [OP_GET] = &&handle_OP_GET,
+        [OP_RETURN] = &&handle_OP_RETURN,
+        [OP_ADDK] = &&handle_OP_ADDK,
+        [OP_SUBK] = &&handle_OP_SUBK,
+        [OP_MULK] = &&handle_OP_MULK,
+        [OP_DIVK] = &&handle_OP_DIVK,
+        [OP_MODK] = &&handle_OP_MODK,
+        [OP_LT_JUMPIF] = &&handle_OP_LT_JUMPIF,
+        [OP_LE_JUMPIF] = &&handle_OP_LE_JUMPIF,
+        [OP_CALLK] = &&handle_OP_CALLK,
+    };
+#pragma GCC diagnostic pop
+#define CASE(op) case op: handle_##op
+#define NEXT() do { FETCH(); goto *handlers[OP(i)]; } while (0)
+#else
+#define CASE(op) case op
+#define NEXT() continue
+#endif
+
+    for (;;) {
+        FETCH();
+        switch (OP(i)) {
+            CASE(OP_MOVE):
+                registers[ARG_A(i)] = registers[ARG_B(i)];
+                NEXT();
+            CASE(OP_LOADK):
+                registers[ARG_A(i)] = constants[READ_BX(i)];
+                NEXT();
+            CASE(OP_LOADINT):
+                registers[ARG_A(i)] = INT_VAL(ARG_SBX(i));
+                NEXT();
+            CASE(OP_LOADNIL):
+                registers[ARG_A(i)] = NIL_VAL;
+                NEXT();
+            CASE(OP_LOADBOOL):
+                registers[ARG_A(i)] = BOOL_VAL(ARG_B(i) != 0);
+                NEXT();
+            CASE(OP_GETGLOBAL):
+                registers[ARG_A(i)] = globals[READ_BX(i)];
+                NEXT();
+            CASE(OP_SETGLOBAL):
+                globals[READ_BX(i)] = registers[ARG_A(i)];
+                NEXT();
+            CASE(OP_ADD): {
+                Value lhs = registers[ARG_B(i)], rhs = registers[ARG_C(i)];
+                // Plain int addition is by far the most common case; two 48-bit ints
+                // cannot overflow the 64-bit sum.
+                if (IS_INT(lhs) && IS_INT(rhs) && int_fits(AS_INT(lhs) + AS_INT(rhs))) {
+                    registers[ARG_A(i)] = INT_VAL(AS_INT(lhs) + AS_INT(rhs));
+                    NEXT();
+                }
+                SAVE_PC();
+                if (!arithmetic(vm, OP_ADD, lhs, rhs, &registers[ARG_A(i)])) return false;
+                NEXT();
+            }
+            CASE(OP_SUB):
+            CASE(OP_MUL):
+            CASE(OP_DIV):
+            CASE(OP_MOD):
+                SAVE_PC();
+                if (!arithmetic(vm, OP(i), registers[ARG_B(i)], registers[ARG_C(i)], &registers[ARG_A(i)])) return false;
+                NEXT();
+            CASE(OP_EQ):
+                registers[ARG_A(i)] = BOOL_VAL(values_equal(registers[ARG_B(i)], registers[ARG_C(i)]));
+                NEXT();
+            CASE(OP_NEQ):
+                registers[ARG_A(i)] = BOOL_VAL(!values_equal(registers[ARG_B(i)], registers[ARG_C(i)]));
+                NEXT();
+            CASE(OP_LT):
+            CASE(OP_LE):
+                SAVE_PC();
+                if (!compare(vm, OP(i), registers[ARG_B(i)], registers[ARG_C(i)], &registers[ARG_A(i)])) return false;
+                NEXT();
+            CASE(OP_NEG):
+                SAVE_PC();
+                if (!negate(vm, registers[ARG_B(i)], &registers[ARG_A(i)])) return false;
+                NEXT();
+            CASE(OP_NOT):
+                registers[ARG_A(i)] = BOOL_VAL(is_falsey(registers[ARG_B(i)]));
+                NEXT();
+            CASE(OP_JUMPIF):
+                BRANCH(!is_falsey(registers[ARG_A(i)]));
+                NEXT();
+            CASE(OP_CALL):
+                SAVE_PC();
+                if (!vm_call_value(vm, registers[ARG_A(i)], &registers[ARG_A(i)], (int)ARG_B(i))) return false;
+                NEXT();
+            CASE(OP_GET): {
+                SAVE_PC();
+                Atom property = *ip++;
+                if (!vm_get_property(vm, registers[ARG_B(i)], property, &registers[ARG_A(i)])) return false;
+                NEXT();
+            }
+            CASE(OP_RETURN):
+                if (result) *result = registers[ARG_A(i)];
+                return true;
+            CASE(OP_ADDK): {
+                Value lhs = registers[ARG_B(i)], rhs = constants[ARG_C(i)];
+                if (IS_INT(lhs) && IS_INT(rhs) && int_fits(AS_INT(lhs) + AS_INT(rhs))) {
+                    registers[ARG_A(i)] = INT_VAL(AS_INT(lhs) + AS_INT(rhs));
+                    NEXT();
+                }
+                SAVE_PC();
+                if (!arithmetic(vm, OP_ADD, lhs, rhs, &registers[ARG_A(i)])) return false;
+                NEXT();
+            }
+            CASE(OP_SUBK):
+            CASE(OP_MULK):
+            CASE(OP_DIVK):
+            CASE(OP_MODK):
+                SAVE_PC();
+                // The K forms are in the same order as OP_ADD ... OP_MOD.
+                if (!arithmetic(vm, (OpCode)(OP_ADD + (OP(i) - OP_ADDK)), registers[ARG_B(i)], constants[ARG_C(i)], &registers[ARG_A(i)])) return false;
+                NEXT();
+            CASE(OP_LT_JUMPIF):
+            CASE(OP_LE_JUMPIF):
+                SAVE_PC();
+                if (!compare(vm, OP(i) == OP_LT_JUMPIF ? OP_LT : OP_LE, registers[ARG_B(i)], registers[ARG_C(i)], &registers[ARG_A(i)])) return false;
+                BRANCH(AS_BOOL(registers[ARG_A(i)]));
+                NEXT();
+            CASE(OP_CALLK):
+                SAVE_PC();
+                if (!call_native(vm, AS_NATIVE(constants[ARG_C(i)]), &registers[ARG_A(i)], (int)ARG_B(i))) return false;
+                NEXT();
+            default:
+#ifdef VM_COMPUTED_GOTO
+            handle_unknown:
+#endif
+                SAVE_PC();
+                vm_error(vm, "Unknown opcode %d.", (int)OP(i));
+                return false;
+        }
+    }
+
+#undef SAVE_PC
+#undef READ_BX
+#undef FETCH
+#undef BRANCH
+#undef CASE
+#undef NEXT
+}
+
+bool vm_run(VM* vm, Function* script, Value* result) {
+    vm->function = script;
+    reset_values(&vm->registers, &vm->register_capacity, script->register_count);
+    reset_values(&vm->globals, &vm->global_capacity, script->global_count);
+    if (!vm->jit || script->jit_disabled) return interpret(vm, 0, result);
+
+    if (!script->jit && ++script->runs >= JIT_HOT_RUNS) {
+        script->jit = jit_compile(script);
+        script->jit_disabled = !script->jit;
+    }
+    if (!script->jit) return interpret(vm, 0, result);
+
+    size_t exit = jit_enter(script->jit, vm, result);
+    if (exit == JIT_RETURNED) return true;
+    if (exit == JIT_FAILED) return false;
+
+    // A guard failed: the interpreter takes over at that instruction, and
+    // code that keeps failing its guards is not worth running.
+    if (++script->deopts >= JIT_MAX_DEOPTS) {
+        free_jit_code(script->jit);
+        script->jit = NULL;
+        script->jit_disabled = true;
+    }
+    return interpret(vm, exit, result);
+}
+
+#ifdef VM_COUNT_OPCODES
+typedef struct OpcodePair {
+    OpCode first;
+    OpCode second;
+    uint64_t count;
+} OpcodePair;
+
+static int compare_pairs(const void* lhs, const void* rhs) {
+    uint64_t a = ((const OpcodePair*)lhs)->count, b = ((const OpcodePair*)rhs)->count;
+    return a < b ? 1 : a > b ? -1 : 0;
+}
+#endif
+
+void vm_print_profile(const VM* vm, FILE* out) {
+#ifdef VM_COUNT_OPCODES
+    fprintf(out, "OPCODES\n");
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (vm->op_counts[op]) fprintf(out, "  %-12s %llu\n", opcode_name((OpCode)op), (unsigned long long)vm->op_counts[op]);
+    }
+
+    // The most frequent pairs are the candidates for superinstructions.
+    OpcodePair pairs[OP_COUNT * OP_COUNT];
+    size_t count = 0;
+    for (int a = 0; a < OP_COUNT; a++) {
+        for (int b = 0; b < OP_COUNT; b++) {
+            if (vm->pair_counts[a][b]) pairs[count++] = (OpcodePair){ (OpCode)a, (OpCode)b, vm->pair_counts[a][b] };
+        }
+    }
+    qsort(pairs, count, sizeof(OpcodePair), compare_pairs);
+
+    fprintf(out, "PAIRS\n");
+    for (size_t i = 0; i < count && i < VM_PROFILE_PAIRS; i++) {
+        fprintf(out, "  %-12s %-12s %llu\n", opcode_name(pairs[i].first), opcode_name(pairs[i].second),
+            (unsigned long long)pairs[i].count);
+    }
+#else
+    (void)vm;
+    fprintf(out, "Opcode counters are only kept in debug builds.\n");
+#endif
+}
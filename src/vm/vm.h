@@ -0,0 +1,68 @@
+#ifndef NUUK_VM_H
+#define NUUK_VM_H
+
+#include "bytecode.h"
+#include "jit.h"
+#include "E:\THE_LANGUAGE\src\utils\diagnostics.h"
+
+// Debug builds count how often each opcode and each pair of consecutive
+// opcodes executes, which is how candidates for superinstructions are
+// found; vm_print_profile() prints the counts.
+#ifndef NDEBUG
+#define VM_COUNT_OPCODES
+#define VM_PROFILE_PAIRS 16
+#endif
+
+// Runs compiled scripts. `registers` is the register file of the running
+// function and `globals` the global slots of the script. Strings made at run
+// time are allocated from `arena` and live as long as the VM.
+//
+// Runtime errors stop the script and are added to `errors` at the source
+// offset of the failing instruction.
+//
+// With `jit` set, which create_vm() does where the JIT is available, hot
+// scripts run as machine code (see jit.h).
+typedef struct VM {
+    Value* registers;
+    size_t register_capacity;
+    Value* globals;
+    size_t global_capacity;
+    Arena* arena;
+    Diagnostics errors;
+    bool jit;
+
+    const Function* function;
+    size_t pc;
+
+#ifdef VM_COUNT_OPCODES
+    uint64_t op_counts[OP_COUNT];
+    uint64_t pair_counts[OP_COUNT][OP_COUNT];
+#endif
+} VM;
+
+VM* create_vm();
+void free_vm(VM* vm);
+
+// Runs `script` from the start, with all globals nil. Returns false after a
+// runtime error; otherwise `*result`, if given, is the returned value.
+// Updates the tiering state of `script`.
+bool vm_run(VM* vm, Function* script, Value* result);
+
+// The counters of all scripts the VM ran, most frequent pairs first.
+void vm_print_profile(const VM* vm, FILE* out);
+// "computed-goto" or "switch", the dispatch the VM was built with.
+const char* vm_dispatch_name();
+
+// Reports a runtime error at the instruction being executed.
+void vm_error(VM* vm, const char* fmt, ...);
+
+// What CALL and GET do, for the interpreter and the machine code alike:
+// `callee` is called with the `argc` values after `base` and its result
+// stored in `*base`. Both report errors at `vm->pc` and then return false.
+bool vm_call_value(VM* vm, Value callee, Value* base, int argc);
+bool vm_get_property(VM* vm, Value object, Atom property, Value* result);
+
+// The builtin function called `name`, or NULL if there is none.
+const ObjNative* lookup_native(Atom name);
+
+#endif